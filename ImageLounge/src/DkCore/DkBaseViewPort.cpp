@@ -29,11 +29,12 @@
 #include "DkActionManager.h"
 #include "DkSettings.h"
 #include "DkUtils.h"
+#include "DkTiledImage.h"
+#include "DkMovie.h"
 
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QCoreApplication>
 #include <QTimer>
-#include <QMovie>
 #include <QShortcut>
 #include <QDebug>
 #include <QTimer>
@@ -68,6 +69,7 @@ DkBaseViewPort::DkBaseViewPort(QWidget *parent) : QGraphicsView(parent) {
 	mZoomTimer->setSingleShot(true);
 	connect(mZoomTimer, SIGNAL(timeout()), this, SLOT(stopBlockZooming()));
 	connect(&mImgStorage, SIGNAL(imageUpdated()), this, SLOT(update()));
+	connect(&DkTileCache::instance(), SIGNAL(tileLoaded()), this, SLOT(update()));
 
 	mPattern.setTexture(QPixmap(":/nomacs/img/tp-pattern.png"));
 
@@ -573,13 +575,31 @@ void DkBaseViewPort::draw(QPainter & painter, double opacity) {
 	else if (mMovie && mMovie->isValid())
 		painter.drawPixmap(mImgViewRect, mMovie->currentPixmap(), mMovie->frameRect());
 	else
-		painter.drawImage(mImgViewRect, imgQt, imgQt.rect());
+		drawImage(painter, imgQt);
 
 	painter.setOpacity(oldOp);
 
 	//qDebug() << "view rect: " << imgStorage.getImage().size()*imgMatrix.m11()*worldMatrix.m11() << " img rect: " << imgQt.size();
 }
 
+/**
+ * Draws the image to the image view rect.
+ * Large images are drawn tile by tile - just the visible tiles are painted.
+ * @param painter the viewport's painter
+ * @param img the image (ignored if the storage has tiles)
+ **/ 
+void DkBaseViewPort::drawImage(QPainter & painter, const QImage& img) {
+
+	QSharedPointer<DkTilePyramid> tiles = mImgStorage.tiles();
+
+	if (tiles) {
+		QRectF visibleRect = mWorldMatrix.inverted().mapRect(QRectF(mViewportRect));
+		tiles->draw(painter, mImgViewRect, visibleRect);
+	}
+	else
+		painter.drawImage(mImgViewRect, img, img.rect());
+}
+
 bool DkBaseViewPort::imageInside() const {
 
 	return mWorldMatrix.m11() <= 1.0f || mViewportRect.contains(mWorldMatrix.mapRect(mImgViewRect));
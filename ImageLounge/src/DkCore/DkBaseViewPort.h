@@ -52,6 +52,9 @@ class QSvgRenderer;
 
 namespace nmc {
 
+// nomacs defines
+class DkMovie;
+
 class DllCoreExport DkBaseViewPort : public QGraphicsView {
 	Q_OBJECT
 
@@ -191,7 +194,7 @@ protected:
 	Qt::KeyboardModifier mCtrlMod;
 
 	DkImageStorage mImgStorage;
-	QSharedPointer<QMovie> mMovie;
+	QSharedPointer<DkMovie> mMovie;
 	QSharedPointer<QSvgRenderer> mSvg;
 	QBrush mPattern;
 
@@ -217,6 +220,7 @@ protected:
 
 	// functions
 	virtual void draw(QPainter & painter, double opacity = 1.0);
+	void drawImage(QPainter & painter, const QImage& img);
 	virtual void updateImageMatrix();
 	virtual QTransform getScaledImageMatrix() const;
 	virtual QTransform getScaledImageMatrix(const QSize& size) const;
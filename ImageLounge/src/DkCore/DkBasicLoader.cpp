@@ -34,6 +34,9 @@
 #include "DkTimer.h"
 #include "DkMath.h"
 #include "DkUtils.h"	// just needed for qInfo() #ifdef
+#include "DkFormatRegistry.h"
+#include "DkRawCache.h"
+#include "DkThreadPools.h"
 
 #pragma warning(push, 0)        
 #include <QObject>
@@ -43,6 +46,15 @@
 #include <QImageWriter>
 #include <QNetworkReply>
 #include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThread>
+#include <QSaveFile>
+#include <QScopedPointer>
 #include <QNetworkProxyFactory>
 #include <QPixmap>
 #include <QIcon>
@@ -50,6 +62,11 @@
 
 #include <qmath.h>
 #include <assert.h>
+#include <limits>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
 
 // quazip
 #ifdef WITH_QUAZIP
@@ -126,6 +143,395 @@ int DkEditImage::size() const {
 	return qRound(DkImage::getBufferSizeFloat(mImg.size(), mImg.depth()));
 }
 
+// DkFileBuffer --------------------------------------------------------------------
+/**
+ * Loads the file to a buffer.
+ * If map is true, files larger than mapThreshold are mapped - the mapping is released
+ * with the last reference to the buffer. We do not map files on windows,
+ * since it locks them (the user could not delete the file).
+ * @param filePath the file's path
+ * @param map if true, large files are mapped - only for files that are not modified while the buffer lives (see DkFileBuffer)
+ * @param token files are read in chunks - reading stops if the token is canceled
+ * @return QSharedPointer<QByteArray> the buffer (empty if the file could not be read or reading was canceled)
+ **/ 
+QSharedPointer<QByteArray> DkFileBuffer::load(const QString& filePath, bool map, QSharedPointer<DkCancelToken> token) {
+
+	QScopedPointer<QFile> file(new QFile(filePath));
+
+	if (!file->open(QIODevice::ReadOnly))
+		return QSharedPointer<QByteArray>(new QByteArray());
+
+#ifdef Q_OS_UNIX
+	qint64 size = file->size();
+
+	if (map && size >= mapThreshold && size <= std::numeric_limits<int>::max()) {
+
+		uchar* data = file->map(0, size);
+
+		if (data) {
+			// decoders consume the buffer front to back - read ahead
+			madvise(data, (size_t)size, MADV_SEQUENTIAL);
+			madvise(data, (size_t)size, MADV_WILLNEED);
+
+			QFile* mappedFile = file.take();
+
+			{
+				QMutexLocker locker(&mappedMutex());
+				mappedBuffers().insert((const char*)data);
+			}
+
+			return QSharedPointer<QByteArray>(
+				new QByteArray(QByteArray::fromRawData((const char*)data, (int)size)), 
+				[mappedFile, data](QByteArray* ba) {
+					{
+						QMutexLocker locker(&mappedMutex());
+						mappedBuffers().remove((const char*)data);
+					}
+					delete ba;
+					delete mappedFile;	// unmaps the file
+				});
+		}
+	}
+#endif
+
+	// large files on slow disks take seconds - stop if nobody needs them anymore
+	const qint64 chunkSize = 4*1024*1024;
+	QSharedPointer<QByteArray> ba(new QByteArray());
+	ba->reserve((int)qMin(file->size(), (qint64)std::numeric_limits<int>::max()));
+
+	while (!file->atEnd()) {
+
+		if (token && token->isCanceled())
+			return QSharedPointer<QByteArray>(new QByteArray());
+
+		QByteArray chunk = file->read(chunkSize);
+
+		if (chunk.isEmpty())
+			break;
+
+		ba->append(chunk);
+	}
+
+	return ba;
+}
+
+/**
+ * Returns true if the buffer maps a file (see load).
+ * @param ba the buffer
+ * @return bool true if the buffer is mapped
+ **/ 
+bool DkFileBuffer::isMapped(const QSharedPointer<QByteArray>& ba) {
+
+	if (!ba || ba->isEmpty())
+		return false;
+
+	QMutexLocker locker(&mappedMutex());
+	return mappedBuffers().contains(ba->constData());
+}
+
+/**
+ * Writes the buffer to a file.
+ * The file is overwritten in place, so hardlinks, permissions and
+ * extended attributes are kept. Note that readers which map the file
+ * see the new bytes while they are written and fault (SIGBUS) if the
+ * file shrinks. Hence, nomacs does not map the files it displays.
+ * @param filePath the file's path
+ * @param ba the data to be written
+ * @return qint64 the number of bytes written or -1 on errors
+ **/ 
+qint64 DkFileBuffer::write(const QString& filePath, const QByteArray& ba) {
+
+	QFile file(filePath);
+
+	if (!file.open(QIODevice::ReadWrite))
+		return -1;
+
+	qint64 bytesWritten = file.write(ba.constData(), ba.size());
+
+	if (bytesWritten != ba.size() || !file.resize(ba.size()))
+		return -1;
+
+	return bytesWritten;
+}
+
+QMutex& DkFileBuffer::mappedMutex() {
+
+	static QMutex mutex;
+	return mutex;
+}
+
+QSet<const char*>& DkFileBuffer::mappedBuffers() {
+
+	static QSet<const char*> buffers;
+	return buffers;
+}
+
+// DkTiffIndex --------------------------------------------------------------------
+DkTiffIndex::DkTiffIndex() {
+
+	mCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QDir::separator() + "tiff";
+}
+
+DkTiffIndex& DkTiffIndex::instance() {
+
+	static DkTiffIndex inst;
+	return inst;
+}
+
+/**
+ * Returns the directory offsets of a TIFF file.
+ * @param filePath the TIFF file
+ * @return QVector<quint64> one offset per page or an empty vector if the file is not indexed
+ **/ 
+QVector<quint64> DkTiffIndex::find(const QString& filePath) {
+
+	QString k = key(filePath);
+
+	QMutexLocker locker(&mMutex);
+
+	if (mIndices.contains(k)) {
+		touch(k);
+		return mIndices.value(k);
+	}
+
+	// try the disk cache
+	QFile file(entryPath(k));
+	QVector<quint64> offsets;
+
+	if (file.open(QIODevice::ReadOnly)) {
+		QDataStream ds(&file);
+		ds >> offsets;
+
+		if (ds.status() != QDataStream::Ok)
+			offsets.clear();
+	}
+
+	if (!offsets.empty()) {
+		mIndices.insert(k, offsets);
+		touch(k);
+	}
+
+	return offsets;
+}
+
+/**
+ * Adds the directory offsets of a TIFF file.
+ * Only multi-page files are written to disk.
+ * @param filePath the TIFF file
+ * @param offsets one offset per page
+ **/ 
+void DkTiffIndex::insert(const QString& filePath, const QVector<quint64>& offsets) {
+
+	if (offsets.empty())
+		return;
+
+	QString k = key(filePath);
+
+	QMutexLocker locker(&mMutex);
+	mIndices.insert(k, offsets);
+	touch(k);
+
+	if (offsets.size() <= 1)
+		return;
+
+	QDir().mkpath(mCacheDir);
+	QSaveFile file(entryPath(k));
+
+	if (file.open(QIODevice::WriteOnly)) {
+		QDataStream ds(&file);
+		ds << offsets;
+		file.commit();
+	}
+}
+
+QString DkTiffIndex::key(const QString& filePath) const {
+
+	QFileInfo fi(filePath);
+
+	return QString("%1|%2|%3")
+		.arg(fi.absoluteFilePath())
+		.arg(fi.size())
+		.arg(fi.lastModified().toMSecsSinceEpoch());
+}
+
+QString DkTiffIndex::entryPath(const QString& key) const {
+
+	QString hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+	return mCacheDir + QDir::separator() + hash + ".idx";
+}
+
+void DkTiffIndex::touch(const QString& key) {
+
+	mRecent.removeOne(key);
+	mRecent.append(key);
+
+	while (mRecent.size() > mMaxEntries)
+		mIndices.remove(mRecent.takeFirst());
+}
+
+#ifdef WITH_LIBRAW
+/**
+ * LibRaw progress callback - a non-zero return value cancels LibRaw.
+ * LibRaw calls it between processing stages only, hence a stage
+ * that is running (e.g. unpacking) is not interrupted.
+ * @param data the load's DkCancelToken
+ **/ 
+static int rawProgress(void* data, enum LibRaw_progress, int, int) {
+
+	DkCancelToken* token = static_cast<DkCancelToken*>(data);
+	return token && token->isCanceled() ? 1 : 0;
+}
+
+/**
+ * Number of stripes for developing RAW images in parallel.
+ * A stripe has ~64 rows - hence it fits into the L2 cache.
+ **/ 
+static double rawStripes(int rows) {
+	return qMax(1.0, rows / 64.0);
+}
+
+/**
+ * Normalizes LibRaw's image according to the black point and the dynamic range.
+ * Bayer images are written to a 16 bit single channel mat, 
+ * others (filters == 0) to a 16 bit RGB mat.
+ **/ 
+class DkRawNormalize : public cv::ParallelLoopBody {
+
+public:
+	DkRawNormalize(LibRaw& raw, cv::Mat& dst) : mRaw(raw), mDst(dst) {
+
+		//dynamic range is defined by maximum - black
+		mBlack = (float)raw.imgdata.color.black;
+		mScale = 65535.0f / (float)(raw.imgdata.color.maximum - raw.imgdata.color.black);
+	};
+
+	void operator()(const cv::Range& r) const override {
+
+		const int cols = mDst.cols;
+		const bool bayer = mDst.channels() == 1;
+
+		for (int row = r.start; row < r.end; row++) {
+
+			const unsigned short (*src)[4] = mRaw.imgdata.image + (size_t)cols*row;
+			unsigned short* ptr = mDst.ptr<unsigned short>(row);
+
+			if (bayer) {
+				for (int col = 0; col < cols; col++)
+					ptr[col] = cv::saturate_cast<unsigned short>((src[col][mRaw.COLOR(row, col)] - mBlack) * mScale);
+			}
+			else {
+				for (int col = 0; col < cols; col++, ptr += 3) {
+					ptr[0] = cv::saturate_cast<unsigned short>((src[col][0] - mBlack) * mScale);
+					ptr[1] = cv::saturate_cast<unsigned short>((src[col][1] - mBlack) * mScale);
+					ptr[2] = cv::saturate_cast<unsigned short>((src[col][2] - mBlack) * mScale);
+				}
+			}
+		}
+	};
+
+protected:
+	LibRaw& mRaw;
+	cv::Mat& mDst;
+	float mBlack;
+	float mScale;
+};
+
+/**
+ * Bins 2x2 Bayer cells to one RGB pixel (the greens are averaged).
+ * This halves the image size and skips demosaicing.
+ **/ 
+class DkRawBin : public cv::ParallelLoopBody {
+
+public:
+	DkRawBin(LibRaw& raw, cv::Mat& dst) : mRaw(raw), mDst(dst) {
+
+		mBlack = (float)raw.imgdata.color.black;
+		mScale = 65535.0f / (float)(raw.imgdata.color.maximum - raw.imgdata.color.black);
+	};
+
+	void operator()(const cv::Range& r) const override {
+
+		const int rawCols = mRaw.imgdata.sizes.width;
+
+		for (int row = r.start; row < r.end; row++) {
+
+			unsigned short* ptr = mDst.ptr<unsigned short>(row);
+
+			for (int col = 0; col < mDst.cols; col++, ptr += 3) {
+
+				float sum[3] = {0.0f, 0.0f, 0.0f};
+				int num[3] = {0, 0, 0};
+
+				for (int dy = 0; dy < 2; dy++) {
+					for (int dx = 0; dx < 2; dx++) {
+						int rr = 2*row + dy;
+						int rc = 2*col + dx;
+						int color = mRaw.COLOR(rr, rc);
+						int ch = color == 3 ? 1 : color;	// second green
+
+						sum[ch] += mRaw.imgdata.image[(size_t)rr*rawCols + rc][color];
+						num[ch]++;
+					}
+				}
+
+				for (int ch = 0; ch < 3; ch++)
+					ptr[ch] = num[ch] ? cv::saturate_cast<unsigned short>((sum[ch] / num[ch] - mBlack) * mScale) : 0;
+			}
+		}
+	};
+
+protected:
+	LibRaw& mRaw;
+	cv::Mat& mDst;
+	float mBlack;
+	float mScale;
+};
+
+/**
+ * Applies white balance, color correction and gamma in a single pass.
+ * The branch-free matrix product is vectorized by the compiler, the
+ * gamma look-up table converts to 8 bit.
+ **/ 
+class DkRawDevelop : public cv::ParallelLoopBody {
+
+public:
+	DkRawDevelop(const cv::Mat& src, cv::Mat& dst, const float corrMat[3][3], const uchar* gammaLut) : mSrc(src), mDst(dst), mLut(gammaLut) {
+
+		for (int i = 0; i < 3; i++) for (int j = 0; j < 3; j++) mCorr[i][j] = corrMat[i][j];
+	};
+
+	void operator()(const cv::Range& r) const override {
+
+		const int cols = mSrc.cols;
+		std::vector<int> corr(cols * 3);
+
+		for (int row = r.start; row < r.end; row++) {
+
+			const unsigned short* src = mSrc.ptr<unsigned short>(row);
+			uchar* dst = mDst.ptr<uchar>(row);
+
+			for (int col = 0; col < cols; col++) {
+				float cr = src[3*col], cg = src[3*col+1], cb = src[3*col+2];
+
+				for (int c = 0; c < 3; c++) {
+					int v = cvRound(mCorr[c][0] * cr + mCorr[c][1] * cg + mCorr[c][2] * cb);
+					corr[3*col+c] = v < 0 ? 0 : v > 65535 ? 65535 : v;	//clipping
+				}
+			}
+
+			for (int idx = 0; idx < cols * 3; idx++)
+				dst[idx] = mLut[corr[idx]];
+		}
+	};
+
+protected:
+	const cv::Mat& mSrc;
+	cv::Mat& mDst;
+	const uchar* mLut;
+	float mCorr[3][3];
+};
+#endif
+
 // Basic loader and image edit class --------------------------------------------------------------------
 DkBasicLoader::DkBasicLoader(int mode) {
 	
@@ -145,10 +551,13 @@ bool DkBasicLoader::loadGeneral(const QString& filePath, bool loadMetaData, bool
 }
 /**
  * This function loads the images.
+ * If the token is canceled (e.g. the user skipped the image), the loaders
+ * stop at their next check and no image is set.
  * @param file the image file that should be loaded.
+ * @param token the load's cancellation token (may be NULL)
  * @return bool true if the image could be loaded.
  **/ 
-bool DkBasicLoader::loadGeneral(const QString& filePath, QSharedPointer<QByteArray> ba, bool loadMetaData, bool fast) {
+bool DkBasicLoader::loadGeneral(const QString& filePath, QSharedPointer<QByteArray> ba, bool loadMetaData, bool fast, QSharedPointer<DkCancelToken> token) {
 
 	DkTimer dt;
 	bool imgLoaded = false;
@@ -165,6 +574,15 @@ bool DkBasicLoader::loadGeneral(const QString& filePath, QSharedPointer<QByteArr
 	QString newSuffix = fInfo.suffix();
 
 	release();
+	mCancelToken = token;
+
+	if (isCanceled())
+		return false;
+
+	// read the file once - metadata and decoders share the buffer
+	// psd files are not buffered since we just need a small part of them
+	if ((!ba || ba->isEmpty()) && !mPageIdxDirty && fInfo.exists() && !newSuffix.contains("psd", Qt::CaseInsensitive))
+		ba = DkFileBuffer::load(mFile);
 
 	if (mPageIdxDirty)
 		imgLoaded = loadPage();
@@ -197,7 +615,7 @@ bool DkBasicLoader::loadGeneral(const QString& filePath, QSharedPointer<QByteArr
 		qDebug() << "metaData is NULL!";
 	}
 
-	QList<QByteArray> qtFormats = QImageReader::supportedImageFormats();
+	const DkFormatRegistry& formats = DkFormatRegistry::instance();
 	QString suf = fInfo.suffix().toLower();
 
 	QImage img;
@@ -220,21 +638,29 @@ bool DkBasicLoader::loadGeneral(const QString& filePath, QSharedPointer<QByteArr
 		}
 	}
 
+	// dispatch to the decoder that matches the file header
+	// the chain below is just a fallback for unknown (or broken) files
+	DkImageFormat format;
+	bool formatLoaded = false;
+
+	if (!imgLoaded && !isCanceled()) {
+		format = DkFormatRegistry::instance().detect(DkFormatRegistry::readHeader(mFile, ba), suf);
+		imgLoaded = formatLoaded = loadFormat(format, img, ba, fast);
+	}
+
 	// default Qt loader
 	// here we just try those formats that are officially supported
-	if (!imgLoaded && qtFormats.contains(suf.toStdString().c_str())) {
+	if (!imgLoaded && !isCanceled() && formats.isQtFormat(suf.toLatin1()) && 
+		!(format.loader() == qt_loader && format.qtFormat() == suf.toLatin1())) {
 
 		// if image has Indexed8 + alpha channel -> we crash... sorry for that
-		if (!ba || ba->isEmpty())
-			imgLoaded = img.load(mFile, suf.toStdString().c_str());
-		else
-			imgLoaded = img.loadFromData(*ba.data(), suf.toStdString().c_str());	// toStdString() in order get 1 byte per char
+		imgLoaded = loadQtImage(mFile, img, ba, suf.toStdString().c_str());	// toStdString() in order get 1 byte per char
 
 		if (imgLoaded) mLoader = qt_loader;
 	}
 
 	// PSD loader
-	if (!imgLoaded) {
+	if (!imgLoaded && !isCanceled() && format.loader() != psd_loader) {
 
 		imgLoaded = loadPSDFile(mFile, img, ba);
 		if (imgLoaded) mLoader = psd_loader;
@@ -250,7 +676,7 @@ bool DkBasicLoader::loadGeneral(const QString& filePath, QSharedPointer<QByteArr
 #endif
 
 	// RAW loader
-	if (!imgLoaded && !qtFormats.contains(suf.toStdString().c_str())) {
+	if (!imgLoaded && !isCanceled() && format.loader() != raw_loader && !formats.isQtFormat(suf.toLatin1())) {
 		
 		// TODO: sometimes (e.g. _DSC6289.tif) strange opencv errors are thrown - catch them!
 		// load raw files
@@ -259,13 +685,17 @@ bool DkBasicLoader::loadGeneral(const QString& filePath, QSharedPointer<QByteArr
 	}
 
 	// default Qt loader
-	if (!imgLoaded && !newSuffix.contains(QRegExp("(roh)", Qt::CaseInsensitive))) {
+	if (!imgLoaded && !isCanceled() && !newSuffix.contains(QRegExp("(roh)", Qt::CaseInsensitive))) {
 
 		// if we first load files to buffers, we can additionally load images with wrong extensions (rainer bugfix : )
 		// TODO: add warning here
-		QByteArray lba;
-		loadFileToBuffer(mFile, lba);
-		imgLoaded = img.loadFromData(lba);
+		if (ba && !ba->isEmpty())
+			imgLoaded = img.loadFromData(*ba);
+		else {
+			QByteArray lba;
+			loadFileToBuffer(mFile, lba);
+			imgLoaded = img.loadFromData(lba);
+		}
 		
 		if (imgLoaded) mLoader = qt_loader;
 	}  
@@ -292,6 +722,15 @@ bool DkBasicLoader::loadGeneral(const QString& filePath, QSharedPointer<QByteArr
 	//	if (imgLoaded) loader = hdr_loader;
 	//} 
 
+	// the image was skipped while loading - partial results are not needed
+	if (isCanceled()) {
+		qInfo() << filePath << "canceled after" << dt;
+		return false;
+	}
+
+	if (!mPageIdxDirty)
+		DkFormatRegistry::instance().addTiming(format.name(), imgLoaded, format.isValid() && imgLoaded && !formatLoaded, dt.elapsed());
+
 	// tiff things
 	if (imgLoaded && !mPageIdxDirty)
 		indexPages(mFile);
@@ -303,9 +742,13 @@ bool DkBasicLoader::loadGeneral(const QString& filePath, QSharedPointer<QByteArr
 			mMetaData->setQtValues(img);
 			int orientation = mMetaData->getOrientationDegree();
 
-			if (orientation != -1 && !mMetaData->isTiff() && !DkSettingsManager::param().metaData().ignoreExifOrientation)
+			if (orientation != -1 && !mMetaData->isTiff() && !DkSettingsManager::param().metaData().ignoreExifOrientation) {
 				img = rotate(img, orientation);
 
+				if (mDownscaled && (orientation == 90 || orientation == -90))
+					mOriginalSize.transpose();
+			}
+
 		} catch(...) {}	// ignore if we cannot read the metadata
 	}
 	else if (!mMetaData) {
@@ -320,6 +763,122 @@ bool DkBasicLoader::loadGeneral(const QString& filePath, QSharedPointer<QByteArr
 	return imgLoaded;
 }
 
+/**
+ * Loads the image with the decoder of the format.
+ * @param format the format detected by DkFormatRegistry
+ * @param img the loaded image
+ * @param ba the file buffer
+ * @param fast if true, RAW files are loaded fast
+ * @return bool true if the image was loaded
+ **/ 
+bool DkBasicLoader::loadFormat(const DkImageFormat& format, QImage& img, QSharedPointer<QByteArray> ba, bool fast) {
+
+	bool imgLoaded = false;
+
+	switch (format.loader()) {
+	case qt_loader:
+#ifdef WITH_LIBTIFF
+		// large tiffs (scans, GIS, microscopy) are decoded in parallel
+		if (format.name() == "tif" && !fast && 
+			(ba && !ba->isEmpty() ? ba->size() : QFileInfo(mFile).size()) >= DkFileBuffer::mapThreshold)
+			imgLoaded = loadTiffPage(1, img, true, ba);
+#endif
+		if (!imgLoaded && !isCanceled() && DkFormatRegistry::instance().isQtFormat(format.qtFormat()))
+			imgLoaded = loadQtImage(mFile, img, ba, format.qtFormat());
+		break;
+	case psd_loader:
+		imgLoaded = loadPSDFile(mFile, img, ba);
+		break;
+	case raw_loader:
+		imgLoaded = loadRawFile(mFile, img, ba, fast);
+		break;
+	default:
+		break;
+	}
+
+	if (imgLoaded) 
+		mLoader = format.loader();
+
+	return imgLoaded;
+}
+
+/**
+ * Loads an image with Qt's image readers.
+ * If a display size is set and the decoder supports it (e.g. jpg),
+ * the image is decoded at the display size.
+ * @param filePath the image's file path (used if ba is empty)
+ * @param img the loaded image
+ * @param ba the file buffer
+ * @param format the image format
+ * @return bool true if the image was loaded
+ **/ 
+bool DkBasicLoader::loadQtImage(const QString& filePath, QImage& img, QSharedPointer<QByteArray> ba, const QByteArray& format) {
+
+	QBuffer buffer;
+	QImageReader reader;
+	reader.setFormat(format);
+
+	if (!ba || ba->isEmpty())
+		reader.setFileName(filePath);
+	else {
+		buffer.setData(*ba);
+		buffer.open(QIODevice::ReadOnly);
+		reader.setDevice(&buffer);
+	}
+
+	QSize scaledSize = displayDecodeSize(reader);
+
+	if (scaledSize.isValid()) {
+		mOriginalSize = reader.size();
+		reader.setScaledSize(scaledSize);
+	}
+
+	img = reader.read();
+
+	if (!img.isNull() && scaledSize.isValid()) {
+		mDownscaled = true;
+		qDebug() << "[DkBasicLoader] decoded" << mOriginalSize << "at" << img.size();
+	}
+
+	return !img.isNull();
+}
+
+/**
+ * Returns the size an image should be decoded at.
+ * That is the smallest size that covers the display size.
+ * We only downscale if it saves at least half of the lines - otherwise
+ * zooming in (which needs all pixels) would decode the image twice.
+ * @param reader the image reader
+ * @return QSize the decode size or an invalid size if all pixels should be decoded
+ **/ 
+QSize DkBasicLoader::displayDecodeSize(QImageReader& reader) const {
+
+	if (!mDisplaySize.isValid() || mPageIdxDirty || !reader.supportsOption(QImageIOHandler::ScaledSize))
+		return QSize();
+
+	QSize size = reader.size();
+	QSize displaySize = mDisplaySize;
+
+	if (!size.isValid())
+		return QSize();
+
+	// the image is rotated after loading
+	try {
+		int orientation = mMetaData ? mMetaData->getOrientationDegree() : 0;
+
+		if ((orientation == 90 || orientation == -90) && !mMetaData->isTiff() && !DkSettingsManager::param().metaData().ignoreExifOrientation)
+			displaySize.transpose();
+	}
+	catch (...) {}
+
+	QSize scaledSize = size.scaled(displaySize, Qt::KeepAspectRatio);
+
+	if (scaledSize.isEmpty() || scaledSize.width() > size.width()/2)
+		return QSize();
+
+	return scaledSize;
+}
+
 /**
  * Loads special RAW files that are generated by the Hamamatsu camera.
  * @param fileName the filename of the file to be loaded.
@@ -394,7 +953,7 @@ bool DkBasicLoader::loadRohFile(const QString& filePath, QImage& img, QSharedPoi
  * @param ba the file loaded into a bytearray.
  * @return bool true if the file could be loaded.
  **/ 
-bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPointer<QByteArray> ba, bool fast) const {
+bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPointer<QByteArray> ba, bool fast) {
 	
 	bool imgLoaded = false;
 
@@ -407,7 +966,9 @@ bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPoi
 			if (fast || DkSettingsManager::param().resources().loadRawThumb == DkSettings::raw_thumb_always ||
 				DkSettingsManager::param().resources().loadRawThumb == DkSettings::raw_thumb_if_large) {
 
-				mMetaData->readMetaData(filePath, ba);
+				// loadGeneral already parsed the metadata
+				if (!mMetaData->isLoaded())
+					mMetaData->readMetaData(filePath, ba);
 
 				int minWidth = 0;
 
@@ -426,6 +987,21 @@ bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPoi
 		}
 #ifdef WITH_LIBRAW
 
+		// images are developed at half size for viewing - all pixels are developed if users zoom in or save
+		bool halfSize = DkSettingsManager::param().resources().rawHalfSize && (fast || mDisplaySize.isValid());
+		bool binned = false;
+
+		// revisited RAWs are not developed again - only half-size renderings are cached
+		// since they are never used for saving or editing (see DkRawCache)
+		img = halfSize ? DkRawCache::instance().find(filePath) : QImage();
+
+		if (!img.isNull()) {
+			mDownscaled = true;
+			mOriginalSize = img.size() * 2;	// the pixel aspect is applied already (see below)
+			qDebug() << "[RAW] loaded from the cache in" << dt;
+			return true;
+		}
+
 		LibRaw iProcessor;
 		QImage image;
 
@@ -449,6 +1025,9 @@ bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPoi
 		if (error != LIBRAW_SUCCESS)
 			return false;
 
+		// stops at the next LibRaw stage if the load is canceled
+		iProcessor.set_progress_handler(rawProgress, mCancelToken.data());
+
 		//// (-w) Use camera white balance, if possible (otherwise, fallback to auto_wb)
 		//iProcessor.imgdata.params.use_camera_wb = 1;
 		//// (-a) Use automatic white balance obtained after averaging over the entire image
@@ -497,7 +1076,7 @@ bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPoi
 		if (std::strcmp(iProcessor.version(), "0.13.5") != 0)	// fixes a bug specific to libraw 13 - version call is UNTESTED
 			iProcessor.raw2image();
 
-		if (error != LIBRAW_SUCCESS)
+		if (error != LIBRAW_SUCCESS || isCanceled())
 			return false;
 
 		//iProcessor.dcraw_process();
@@ -549,87 +1128,53 @@ bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPoi
 		}
 
 		// 1. read raw image and normalize it according to dynamic range and black point
-
-		//dynamic range is defined by maximum - black
-		float dynamicRange = (float)(iProcessor.imgdata.color.maximum - iProcessor.imgdata.color.black);	// iProcessor.imgdata.color.channel_maximum[0]-iProcessor.imgdata.color.black;	// dynamic range
+		// 2. demosaic
+		// 3., 4., 5. apply white balance, color correction and gamma
+		// the per-pixel stages run in parallel on stripes of rows (DkRawNormalize, DkRawDevelop)
 
 		if (iProcessor.imgdata.idata.filters) {
 
-			rawMat = cv::Mat(rows, cols, CV_32FC1);
-
-			for (uint row = 0; row < rows; row++) {
-				float *ptrRaw = rawMat.ptr<float>(row);
-
-				for (uint col = 0; col < cols; col++) {
-
-					int colorIdx = iProcessor.COLOR(row, col);
-					ptrRaw[col] = (float)(iProcessor.imgdata.image[cols*(row)+col][colorIdx]);
-
-					//correct the image values according the black point defined by the camera
-					ptrRaw[col] -= iProcessor.imgdata.color.black;
-					//normalize according the dynamic range
-					ptrRaw[col] /= dynamicRange;
-					ptrRaw[col] *= 65535;  // for conversion to 16U
-				}
-			}
-
-			// 2. demosaic raw image
-			rawMat.convertTo(rawMat, CV_16U);
-
-			//cvtColor(rawMat, rgbImg, CV_BayerBG2RGB);
 			unsigned long type = (unsigned long)iProcessor.imgdata.idata.filters;
 			type = type & 255;
 
+			int code = -1;
+
 			//define bayer pattern
-			if (type == 180) cvtColor(rawMat, rgbImg, CV_BayerBG2RGB);      //bitmask  10 11 01 00  -> 3(G) 2(B) 1(G) 0(R) -> RG RG RG
-			//												                                                                  GB GB GB
-			else if (type == 30) cvtColor(rawMat, rgbImg, CV_BayerRG2RGB);		//bitmask  00 01 11 10	-> 0 1 3 2
-			else if (type == 225) cvtColor(rawMat, rgbImg, CV_BayerGB2RGB);		//bitmask  11 10 00 01
-			else if (type == 75) cvtColor(rawMat, rgbImg, CV_BayerGR2RGB);		//bitmask  01 00 10 11
+			if (type == 180) code = CV_BayerBG2RGB;			//bitmask  10 11 01 00  -> 3(G) 2(B) 1(G) 0(R) -> RG RG RG
+			//												                                                  GB GB GB
+			else if (type == 30) code = CV_BayerRG2RGB;		//bitmask  00 01 11 10	-> 0 1 3 2
+			else if (type == 225) code = CV_BayerGB2RGB;	//bitmask  11 10 00 01
+			else if (type == 75) code = CV_BayerGR2RGB;		//bitmask  01 00 10 11
 			else {
 				qWarning() << "Wrong Bayer Pattern (not BG, RG, GB, GR)\n";
 				return false;
 			}
-		}
-		else {
-
-			rawMat = cv::Mat(rows, cols, CV_32FC3);
-			rawMat.setTo(0);
-			std::vector<cv::Mat> rawCh;
-			split(rawMat, rawCh);
-
-			for (unsigned int row = 0; row < rows; row++) {
-				float *ptrR = rawCh[0].ptr<float>(row);
-				float *ptrG = rawCh[1].ptr<float>(row);
-				float *ptrB = rawCh[2].ptr<float>(row);
-				//float *ptrE = rawCh[3].ptr<float>(row);
-
-				for (unsigned int col = 0; col < cols; col++) {
-
-					ptrR[col] = (float)(iProcessor.imgdata.image[cols*(row)+col][0]);
-					ptrR[col] -= iProcessor.imgdata.color.black;
-					ptrR[col] /= dynamicRange;
-					ptrR[col] *= 65535;  // for conversion to 16U
 
-					ptrG[col] = (float)(iProcessor.imgdata.image[cols*(row)+col][1]);
-					ptrG[col] -= iProcessor.imgdata.color.black;
-					ptrG[col] /= dynamicRange;
-					ptrG[col] *= 65535;  // for conversion to 16U
+			if (halfSize) {
+				// bin 2x2 cells - no demosaicing needed
+				rgbImg = cv::Mat(rows/2, cols/2, CV_16UC3);
+				cv::parallel_for_(cv::Range(0, rows/2), DkRawBin(iProcessor, rgbImg), rawStripes(rows/2));
+				binned = true;
+			}
+			else {
+				rawMat = cv::Mat(rows, cols, CV_16UC1);
+				cv::parallel_for_(cv::Range(0, rows), DkRawNormalize(iProcessor, rawMat), rawStripes(rows));
 
-					ptrB[col] = (float)(iProcessor.imgdata.image[cols*(row)+col][2]);
-					ptrB[col] -= iProcessor.imgdata.color.black;
-					ptrB[col] /= dynamicRange;
-					ptrB[col] *= 65535;  // for conversion to 16U
+				if (isCanceled())
+					return false;
 
-				}
+				cvtColor(rawMat, rgbImg, code);
 			}
-			merge(rawCh, rgbImg);
-			rgbImg.convertTo(rgbImg, CV_16U);
+		}
+		else {
+			rgbImg = cv::Mat(rows, cols, CV_16UC3);
+			cv::parallel_for_(cv::Range(0, rows), DkRawNormalize(iProcessor, rgbImg), rawStripes(rows));
 		}
 
 		rawMat.release();
 
-		// 3.. 4., 5.: apply white balance, color correction and gamma 
+		if (isCanceled())
+			return false;
 
 		// get color correction matrix
 		float colorCorrMat[3][4] = {};
@@ -642,13 +1187,6 @@ bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPoi
 		mulWhite[2] = iProcessor.imgdata.color.cam_mul[2];
 		mulWhite[3] = iProcessor.imgdata.color.cam_mul[3];
 
-		//read gamma value and create gamma table
-		float gamma = (float)iProcessor.imgdata.params.gamm[0];///(float)iProcessor.imgdata.params.gamm[1];
-		float gammaTable[65536];
-		for (int i = 0; i < 65536; i++) {
-			gammaTable[i] = (float)(1.099f*pow((float)i / 65535.0f, gamma) - 0.099f);
-		}
-
 		// normalize white balance multipliers
 		float w = (mulWhite[0] + mulWhite[1] + mulWhite[2] + mulWhite[3]) / 4.0f;
 		float maxW = 1.0f;//mulWhite[0];
@@ -671,53 +1209,28 @@ bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPoi
 		if (mulWhite[3] == 0)
 			mulWhite[3] = mulWhite[1];
 
-		//apply corrections
-		std::vector<cv::Mat> corrCh;
-		split(rgbImg, corrCh);
+		// white balance and color correction are fused into one matrix
+		float corrMat[3][3];
+		for (int i = 0; i < 3; i++) for (int j = 0; j < 3; j++) corrMat[i][j] = colorCorrMat[i][j] * mulWhite[j];
 
-		for (uint row = 0; row < rows; row++)
-		{
-			unsigned short *ptrR = corrCh[0].ptr<unsigned short>(row);
-			unsigned short *ptrG = corrCh[1].ptr<unsigned short>(row);
-			unsigned short *ptrB = corrCh[2].ptr<unsigned short>(row);
+		// gamma correction (and the conversion to 8 bit) is a look-up table
+		float gamma = (float)iProcessor.imgdata.params.gamm[0];///(float)iProcessor.imgdata.params.gamm[1];
+		float gammaLinear = (float)iProcessor.imgdata.params.gamm[1] / 257.0f;
+		std::vector<uchar> gammaLut(65536);
 
-			for (uint col = 0; col < cols; col++)
-			{
-				//apply white balance correction
-				int tempR = qRound(ptrR[col] * mulWhite[0]);
-				int tempG = qRound(ptrG[col] * mulWhite[1]);
-				int tempB = qRound(ptrB[col] * mulWhite[2]);
-
-				//apply color correction					
-				int corrR = qRound(colorCorrMat[0][0] * tempR + colorCorrMat[0][1] * tempG + colorCorrMat[0][2] * tempB);
-				int corrG = qRound(colorCorrMat[1][0] * tempR + colorCorrMat[1][1] * tempG + colorCorrMat[1][2] * tempB);
-				int corrB = qRound(colorCorrMat[2][0] * tempR + colorCorrMat[2][1] * tempG + colorCorrMat[2][2] * tempB);
-				// without color correction: change above three lines to the bottom ones
-				//int corrR = tempR;
-				//int corrG = tempG;
-				//int corrB = tempB;
-
-				//clipping
-				ptrR[col] = (corrR > 65535) ? 65535 : (corrR < 0) ? 0 : (unsigned short)corrR;
-				ptrG[col] = (corrG > 65535) ? 65535 : (corrG < 0) ? 0 : (unsigned short)corrG;
-				ptrB[col] = (corrB > 65535) ? 65535 : (corrB < 0) ? 0 : (unsigned short)corrB;
-
-				//apply gamma correction
-				ptrR[col] = ptrR[col] <= 0.018f * 65535.0f ? (unsigned short)(ptrR[col] * (float)iProcessor.imgdata.params.gamm[1] / 257.0f) :
-					(unsigned short)(gammaTable[ptrR[col]] * 255);
-				//									(1.099f*(float)(pow((float)ptrRaw[col], gamma))-0.099f);
-				ptrG[col] = ptrG[col] <= 0.018f * 65535.0f ? (unsigned short)(ptrG[col] * (float)iProcessor.imgdata.params.gamm[1] / 257.0f) :
-					(unsigned short)(gammaTable[ptrG[col]] * 255);
-				ptrB[col] = ptrB[col] <= 0.018f * 65535.0f ? (unsigned short)(ptrB[col] * (float)iProcessor.imgdata.params.gamm[1] / 257.0f) :
-					(unsigned short)(gammaTable[ptrB[col]] * 255);
-			}
+		for (int i = 0; i < 65536; i++) {
+			unsigned short v = i <= 0.018f * 65535.0f ? (unsigned short)(i * gammaLinear) :
+				(unsigned short)((1.099f*pow((float)i / 65535.0f, gamma) - 0.099f) * 255);
+			gammaLut[i] = cv::saturate_cast<uchar>(v);
 		}
 
-		merge(corrCh, rgbImg);
-		rgbImg.convertTo(rgbImg, CV_8U);
+		// binned images have half the rows & cols
+		cv::Mat rgb8(rgbImg.rows, rgbImg.cols, CV_8UC3);
+		cv::parallel_for_(cv::Range(0, rgbImg.rows), DkRawDevelop(rgbImg, rgb8, corrMat, gammaLut.data()), rawStripes(rgbImg.rows));
+		rgbImg = rgb8;
 
 		// filter color noise withe a median filter
-		if (DkSettingsManager::param().resources().filterRawImages) {
+		if (DkSettingsManager::param().resources().filterRawImages && !isCanceled()) {
 
 			float isoSpeed = iProcessor.imgdata.other.iso_speed;
 
@@ -733,6 +1246,7 @@ bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPoi
 				DkTimer dMed;
 
 				cvtColor(rgbImg, rgbImg, CV_RGB2YCrCb);
+				std::vector<cv::Mat> corrCh;
 				split(rgbImg, corrCh);
 
 				cv::medianBlur(corrCh[1], corrCh[1], winSize);
@@ -759,6 +1273,13 @@ bool DkBasicLoader::loadRawFile(const QString& filePath, QImage& img, QSharedPoi
 		img = image.copy();
 		imgLoaded = true;
 
+		// same as for cached images: the binned size (incl. the pixel aspect) is doubled
+		if (binned) {
+			mDownscaled = true;
+			mOriginalSize = img.size() * 2;
+			DkRawCache::instance().insert(filePath, img);
+		}
+
 		iProcessor.recycle();
 
 #else
@@ -791,7 +1312,7 @@ bool DkBasicLoader::loadPSDFile(const QString& filePath, QImage& img, QSharedPoi
 		psdHandler.setDevice(&file);	// QFile is an IODevice
 		//psdHandler.setFormat(fileInfo.suffix().toLocal8Bit());
 
-		if (psdHandler.canRead(&file)) {
+		if (psdHandler.canRead(&file) && !isCanceled()) {
 			bool success = psdHandler.read(&img);
 			//setEditImage(img, tr("Original Image"));
 			
@@ -808,7 +1329,7 @@ bool DkBasicLoader::loadPSDFile(const QString& filePath, QImage& img, QSharedPoi
 		psdHandler.setDevice(&buffer);	// QFile is an IODevice
 		//psdHandler.setFormat(file.suffix().toLocal8Bit());
 
-		if (psdHandler.canRead(&buffer)) {
+		if (psdHandler.canRead(&buffer) && !isCanceled()) {
 			bool success = psdHandler.read(&img);
 			//setEditImage(img, tr("Original Image"));
 
@@ -823,6 +1344,7 @@ bool DkBasicLoader::loadPSDFile(const QString& filePath, QImage& img, QSharedPoi
 void DkBasicLoader::setImage(const QImage & img, const QString & editName, const QString & file) {
 
 	mFile = file;
+	mDownscaled = false;
 	setEditImage(img, editName);
 };
 
@@ -920,13 +1442,7 @@ QSharedPointer<QByteArray> DkBasicLoader::loadFileToBuffer(const QString& fileIn
 		return DkZipContainer::extractImage(DkZipContainer::decodeZipFile(fileInfo), DkZipContainer::decodeImageFile(fileInfo));
 #endif
 
-	QFile file(fileInfo);
-	file.open(QIODevice::ReadOnly);
-
-	QSharedPointer<QByteArray> ba(new QByteArray(file.readAll()));
-	file.close();
-
-	return ba;
+	return DkFileBuffer::load(fileInfo);
 }
 
 bool DkBasicLoader::writeBufferToFile(const QString& fileInfo, const QSharedPointer<QByteArray> ba) const {
@@ -934,10 +1450,7 @@ bool DkBasicLoader::writeBufferToFile(const QString& fileInfo, const QSharedPoin
 	if (!ba || ba->isEmpty())
 		return false;
 
-	QFile file(fileInfo);
-	file.open(QIODevice::WriteOnly);
-	qint64 bytesWritten = file.write(*ba.data(), ba->size());
-	file.close();
+	qint64 bytesWritten = DkFileBuffer::write(fileInfo, *ba);
 	qDebug() << "[DkBasicLoader] buffer saved, bytes written: " << bytesWritten;
 
 	if (!bytesWritten || bytesWritten == -1)
@@ -966,25 +1479,39 @@ void DkBasicLoader::indexPages(const QString& filePath) {
 	oldErrorHandler = TIFFSetErrorHandler(NULL); 
 
 	DkTimer dt;
+
+	// known file - no need to walk the directories
+	QVector<quint64> offsets = DkTiffIndex::instance().find(filePath);
+
+	if (!offsets.empty()) {
+		mNumPages = offsets.size();
+		qDebug() << mNumPages << "TIFF directories (indexed)" << dt;
+		TIFFSetWarningHandler(oldWarningHandler);
+		TIFFSetErrorHandler(oldErrorHandler);
+		return;
+	}
+
 	TIFF* tiff = TIFFOpen(filePath.toLatin1(), "r");	// this->mFile was here before - not sure why
 
 	if (!tiff) 
 		return;
 
 	// libtiff example
-	int dircount = 0;
-
 	do {
-		dircount++;
+		offsets << (quint64)TIFFCurrentDirOffset(tiff);
 
-	} while (TIFFReadDirectory(tiff));
+	} while (!isCanceled() && TIFFReadDirectory(tiff));
 
-	mNumPages = dircount;
+	mNumPages = offsets.size();
 
 	if (mNumPages > 1)
 		mPageIdx = 1;
 
-	qDebug() << dircount << " TIFF directories... " << dt;
+	// a canceled walk is incomplete
+	if (!isCanceled())
+		DkTiffIndex::instance().insert(filePath, offsets);
+
+	qDebug() << mNumPages << " TIFF directories... " << dt;
 	TIFFClose(tiff);
 
 	TIFFSetWarningHandler(oldWarningHandler);
@@ -1006,14 +1533,260 @@ bool DkBasicLoader::loadPage(int skipIdx) {
 	return loadPageAt(mPageIdx);
 }
 
+#ifdef WITH_LIBTIFF
+/**
+ * Returns the QImage format that matches a TIFF directory's samples.
+ * Just 8-bit contiguous gray, RGB and RGBA images are decoded natively.
+ * @param tiff the TIFF file (set to the page's directory)
+ * @return QImage::Format the format or Format_Invalid if libtiff needs to convert the samples
+ **/ 
+static QImage::Format tiffNativeFormat(TIFF* tiff) {
+
+	uint16 bps = 0, spp = 0, photometric = 0, planar = 0, orientation = 0;
+	TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bps);
+	TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &spp);
+	TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG, &planar);
+	TIFFGetFieldDefaulted(tiff, TIFFTAG_ORIENTATION, &orientation);
+
+	if (!TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric))
+		return QImage::Format_Invalid;
+
+	if (bps != 8 || planar != PLANARCONFIG_CONTIG || orientation != ORIENTATION_TOPLEFT)
+		return QImage::Format_Invalid;
+
+	if (photometric == PHOTOMETRIC_MINISBLACK && spp == 1)
+		return QImage::Format_Grayscale8;
+	else if (photometric == PHOTOMETRIC_RGB && spp == 3)
+		return QImage::Format_RGB888;
+	else if (photometric == PHOTOMETRIC_RGB && spp == 4)
+		return QImage::Format_RGBA8888;
+
+	return QImage::Format_Invalid;
+}
+
+/**
+ * Lets libtiff read a TIFF from memory (TIFFClientOpen).
+ * The buffer is mapped into libtiff, hence strips are not copied
+ * and several handles can share one (file) buffer.
+ **/ 
+class DkTiffBufferStream {
+
+public:
+	DkTiffBufferStream(const QByteArray& ba) : mData(ba.constData()), mSize((toff_t)ba.size()) {};
+
+	TIFF* open(const char* name = "buffer") {
+		return TIFFClientOpen(name, "r", (thandle_t)this, read, write, seek, close, size, map, unmap);
+	};
+
+protected:
+	static tmsize_t read(thandle_t h, void* buf, tmsize_t n) {
+
+		DkTiffBufferStream* s = static_cast<DkTiffBufferStream*>(h);
+
+		if (s->mPos >= s->mSize || n <= 0)
+			return 0;
+
+		tmsize_t len = (tmsize_t)qMin((toff_t)n, s->mSize - s->mPos);
+		memcpy(buf, s->mData + s->mPos, (size_t)len);
+		s->mPos += len;
+
+		return len;
+	};
+
+	static tmsize_t write(thandle_t, void*, tmsize_t) {
+		return 0;	// read-only
+	};
+
+	static toff_t seek(thandle_t h, toff_t off, int whence) {
+
+		DkTiffBufferStream* s = static_cast<DkTiffBufferStream*>(h);
+
+		switch (whence) {
+		case SEEK_CUR:	off += s->mPos; break;
+		case SEEK_END:	off += s->mSize; break;
+		default:		break;
+		}
+
+		s->mPos = off;
+		return off;
+	};
+
+	static int close(thandle_t) {
+		return 0;	// the buffer belongs to the caller
+	};
+
+	static toff_t size(thandle_t h) {
+		return static_cast<DkTiffBufferStream*>(h)->mSize;
+	};
+
+	static int map(thandle_t h, void** base, toff_t* size) {
+
+		DkTiffBufferStream* s = static_cast<DkTiffBufferStream*>(h);
+		*base = (void*)s->mData;
+		*size = s->mSize;
+
+		return 1;
+	};
+
+	static void unmap(thandle_t, void*, toff_t) {};
+
+	const char* mData;
+	toff_t mSize;
+	toff_t mPos = 0;
+};
+
+/**
+ * Decodes the strips (or tiles) of a TIFF page in parallel.
+ * libtiff handles must not be shared between threads - so each
+ * range opens its own handle over the shared file buffer and 
+ * seeks to the page's directory.
+ * Strips are decoded directly into the image's scanlines.
+ **/ 
+class DkTiffChunkReader : public cv::ParallelLoopBody {
+
+public:
+	DkTiffChunkReader(const QByteArray& ba, quint64 dirOffset, QImage& img, int bytesPerPixel, DkCancelToken* token) : 
+		mBuffer(ba), mDirOffset(dirOffset), mToken(token) {
+
+		mBits = img.bits();
+		mBytesPerLine = img.bytesPerLine();
+		mWidth = img.width();
+		mHeight = img.height();
+		mBytesPerPixel = bytesPerPixel;
+	};
+
+	void operator()(const cv::Range& r) const override {
+
+		DkTiffBufferStream stream(mBuffer);
+		TIFF* tiff = stream.open();
+
+		if (!tiff || !TIFFSetSubDirectory(tiff, (toff_t)mDirOffset)) {
+			mFailed.storeRelease(1);
+			if (tiff) TIFFClose(tiff);
+			return;
+		}
+
+		bool tiled = TIFFIsTiled(tiff) != 0;
+		std::vector<uchar> buffer((size_t)(tiled ? TIFFTileSize(tiff) : TIFFStripSize(tiff)));
+
+		for (int idx = r.start; idx < r.end; idx++) {
+
+			if (mFailed.loadAcquire() || (mToken && mToken->isCanceled()))
+				break;
+
+			bool ok = tiled ? readTile(tiff, idx, buffer) : readStrip(tiff, idx, buffer);
+
+			if (!ok) {
+				mFailed.storeRelease(1);
+				break;
+			}
+		}
+
+		TIFFClose(tiff);
+	};
+
+	bool failed() const {
+		return mFailed.loadAcquire() != 0;
+	};
+
+protected:
+	bool readStrip(TIFF* tiff, int idx, std::vector<uchar>& buffer) const {
+
+		uint32 rowsPerStrip = 0;
+		TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+		rowsPerStrip = qMin(rowsPerStrip, (uint32)mHeight);
+
+		int y0 = idx * rowsPerStrip;
+		int rows = qMin((int)rowsPerStrip, mHeight - y0);
+		int rowBytes = mWidth * mBytesPerPixel;
+
+		if (rows <= 0)
+			return true;
+
+		// decode straight into the image if the scanlines are not padded
+		if (rowBytes == mBytesPerLine)
+			return TIFFReadEncodedStrip(tiff, idx, mBits + (size_t)y0 * mBytesPerLine, (tmsize_t)rows * rowBytes) != -1;
+
+		if (TIFFReadEncodedStrip(tiff, idx, buffer.data(), (tmsize_t)buffer.size()) == -1)
+			return false;
+
+		for (int y = 0; y < rows; y++)
+			memcpy(mBits + (size_t)(y0 + y) * mBytesPerLine, buffer.data() + (size_t)y * rowBytes, rowBytes);
+
+		return true;
+	};
+
+	bool readTile(TIFF* tiff, int idx, std::vector<uchar>& buffer) const {
+
+		uint32 tw = 0, th = 0;
+		TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &tw);
+		TIFFGetField(tiff, TIFFTAG_TILELENGTH, &th);
+
+		if (!tw || !th)
+			return false;
+
+		int tilesAcross = (mWidth + tw - 1) / tw;
+		int x0 = (idx % tilesAcross) * tw;
+		int y0 = (idx / tilesAcross) * th;
+
+		if (TIFFReadEncodedTile(tiff, idx, buffer.data(), (tmsize_t)buffer.size()) == -1)
+			return false;
+
+		// tiles at the right/bottom border are padded
+		int cols = qMin((int)tw, mWidth - x0);
+		int rows = qMin((int)th, mHeight - y0);
+
+		for (int y = 0; y < rows; y++)
+			memcpy(mBits + (size_t)(y0 + y) * mBytesPerLine + (size_t)x0 * mBytesPerPixel, 
+				buffer.data() + (size_t)y * tw * mBytesPerPixel, 
+				(size_t)cols * mBytesPerPixel);
+
+		return true;
+	};
+
+	const QByteArray& mBuffer;
+	quint64 mDirOffset;
+	DkCancelToken* mToken;
+
+	uchar* mBits;
+	int mBytesPerLine;
+	int mWidth;
+	int mHeight;
+	int mBytesPerPixel;
+
+	mutable QAtomicInt mFailed;
+};
+#endif
+
 bool DkBasicLoader::loadPageAt(int pageIdx) {
 
+	QImage img;
+	bool imgLoaded = loadTiffPage(pageIdx, img);
+
+	if (imgLoaded)
+		setEditImage(img, tr("Original Image"));
+
+	return imgLoaded;
+}
+
+/**
+ * Decodes a TIFF page with libtiff.
+ * 8-bit gray, RGB and RGBA pages are decoded in parallel (strips or tiles)
+ * to their native QImage format. Other pages are converted to RGBA by libtiff.
+ * @param pageIdx the page (starting with 1)
+ * @param img the decoded page
+ * @param nativeOnly if true, pages that need a conversion are not decoded
+ * @param ba the file buffer (the file is read if it is empty)
+ * @return bool true if the page was decoded
+ **/ 
+bool DkBasicLoader::loadTiffPage(int pageIdx, QImage& img, bool nativeOnly, QSharedPointer<QByteArray> ba) {
+
 	bool imgLoaded = false;
 
 #ifdef WITH_LIBTIFF
 
-	// <= 1 since first page is loaded using qt
-	if (pageIdx > mNumPages || pageIdx < 1)
+	// the first page can be loaded before the pages are indexed
+	if (pageIdx < 1 || (pageIdx > 1 && pageIdx > mNumPages))
 		return imgLoaded;
 
 	// first turn off nasty warning/error dialogs - (we do the GUI : )
@@ -1022,34 +1795,99 @@ bool DkBasicLoader::loadPageAt(int pageIdx) {
 	oldErrorHandler = TIFFSetErrorHandler(NULL); 
 
 	DkTimer dt;
-	TIFF* tiff = TIFFOpen(mFile.toLatin1(), "r");
-	
 
-	if (!tiff)
+	// all handles read the same bytes - the file is opened once
+	if (!ba || ba->isEmpty())
+		ba = DkFileBuffer::load(mFile);
+
+	if (!ba || ba->isEmpty()) {
+		TIFFSetWarningHandler(oldWarningHandler);
+		TIFFSetErrorHandler(oldErrorHandler);
+		return imgLoaded;
+	}
+
+	DkTiffBufferStream stream(*ba);
+	TIFF* tiff = stream.open(mFile.toUtf8().constData());
+
+	if (!tiff) {
+		TIFFSetWarningHandler(oldWarningHandler);
+		TIFFSetErrorHandler(oldErrorHandler);
 		return imgLoaded;
+	}
 
 	uint32 width = 0;
 	uint32 height = 0;
 
 	// go to current directory
-	for (int idx = 1; idx < pageIdx; idx++) {
+	QVector<quint64> offsets = DkTiffIndex::instance().find(mFile);
 
-		if (!TIFFReadDirectory(tiff))
+	if (pageIdx <= offsets.size()) {
+
+		// seek to the page directly
+		if (!TIFFSetSubDirectory(tiff, (toff_t)offsets[pageIdx-1])) {
+			TIFFClose(tiff);
 			return false;
+		}
+	}
+	else {
+		for (int idx = 1; idx < pageIdx; idx++) {
+
+			if (isCanceled() || !TIFFReadDirectory(tiff)) {
+				TIFFClose(tiff);
+				return false;
+			}
+		}
+	}
+
+	if (isCanceled()) {
+		TIFFClose(tiff);
+		return false;
 	}
 
 	TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
 	TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
 
-	// init the qImage
-	QImage img = QImage(width, height, QImage::Format_ARGB32);
+	QImage::Format format = tiffNativeFormat(tiff);
 
-	const int stopOnError = 1;
-	imgLoaded = TIFFReadRGBAImageOriented(tiff, width, height, reinterpret_cast<uint32 *>(img.bits()), ORIENTATION_TOPLEFT, stopOnError) != 0;
+	if (format != QImage::Format_Invalid) {
 
-	if (imgLoaded) {
-		for (uint32 y=0; y<height; ++y)
-			convert32BitOrder(img.scanLine(y), width);
+		img = QImage(width, height, format);
+
+		if (!img.isNull()) {
+
+			int numChunks = TIFFIsTiled(tiff) ? (int)TIFFNumberOfTiles(tiff) : (int)TIFFNumberOfStrips(tiff);
+			int bytesPerPixel = format == QImage::Format_Grayscale8 ? 1 : (format == QImage::Format_RGB888 ? 3 : 4);
+
+			DkTiffChunkReader reader(*ba, TIFFCurrentDirOffset(tiff), img, bytesPerPixel, mCancelToken.data());
+			cv::parallel_for_(cv::Range(0, numChunks), reader, qMin(numChunks, QThread::idealThreadCount()));
+
+			imgLoaded = !reader.failed() && !isCanceled();
+			qDebug() << "[TIFF] page" << pageIdx << "decoded from" << numChunks << "chunks in" << dt;
+		}
+
+		if (!imgLoaded)
+			img = QImage();
+	}
+
+	if (!imgLoaded && !nativeOnly && !isCanceled()) {
+
+		// libtiff's ABGR words are RGBA bytes on little endian machines
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+		img = QImage(width, height, QImage::Format_RGBA8888);
+#else
+		img = QImage(width, height, QImage::Format_ARGB32);
+#endif
+
+		const int stopOnError = 1;
+		imgLoaded = !img.isNull() && 
+			TIFFReadRGBAImageOriented(tiff, width, height, reinterpret_cast<uint32 *>(img.bits()), ORIENTATION_TOPLEFT, stopOnError) != 0;
+
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+		if (imgLoaded) {
+			for (uint32 y=0; y<height; ++y)
+				convert32BitOrder(img.scanLine(y), width);
+		}
+#endif
 	}
 
 	TIFFClose(tiff);
@@ -1057,11 +1895,8 @@ bool DkBasicLoader::loadPageAt(int pageIdx) {
 	TIFFSetWarningHandler(oldWarningHandler);
 	TIFFSetWarningHandler(oldErrorHandler);
 
-	setEditImage(img, tr("Original Image"));
-
 #endif
 
-
 	return imgLoaded;
 }
 
@@ -1280,6 +2115,7 @@ void DkBasicLoader::release(bool clear) {
 	saveMetaData(mFile);
 
 	mImages.clear();
+	mDownscaled = false;
 	//metaData.clear();
 	
 	// TODO: where should we clear the metadata?
@@ -1673,6 +2509,200 @@ QUrl FileDownloader::getUrl() const {
 #ifdef WITH_QUAZIP
 
 // DkZipContainer --------------------------------------------------------------------
+/**
+ * An opened zip archive and its central directory.
+ * The directory is parsed once - entries are then located with
+ * a single seek. QuaZip handles must not be shared between
+ * threads, hence each extraction takes an idle handle (or opens
+ * a new one). That way, independent entries are inflated in parallel.
+ **/ 
+class DkZipArchive {
+
+public:
+	DkZipArchive(const QString& zipFile) {
+		mZipFile = zipFile;
+		mModified = QFileInfo(zipFile).lastModified();
+	};
+
+	~DkZipArchive() {
+		qDeleteAll(mIdle);
+	};
+
+	bool isValid() const {
+		return mModified == QFileInfo(mZipFile).lastModified();
+	};
+
+	bool index() {
+
+		QuaZip* zip = acquire();
+
+		if (!zip)
+			return false;
+
+		release(zip);
+		return true;
+	};
+
+	QStringList fileList() {
+
+		QMutexLocker locker(&mMutex);
+		return mFileList;
+	};
+
+	QByteArray extract(const QString& imageFile) {
+
+		QuaZip* zip = acquire();
+
+		if (!zip)
+			return QByteArray();
+
+		QByteArray ba;
+		bool found = false;
+		unz64_file_pos pos;
+
+		{
+			QMutexLocker locker(&mMutex);
+			auto entry = mEntries.constFind(imageFile);
+			found = entry != mEntries.constEnd();
+
+			if (found)
+				pos = entry.value();
+		}
+
+		// go directly to the entry - fall back to the (linear) search if the name is not indexed
+		if (found)
+			found = unzGoToFilePos64(zip->getUnzFile(), &pos) == UNZ_OK;
+		else
+			found = zip->setCurrentFile(imageFile);
+
+		if (found) {
+			QuaZipFile extractedFile(zip);
+
+			if (extractedFile.open(QIODevice::ReadOnly) && extractedFile.getZipError() == UNZ_OK) {
+				ba = extractedFile.readAll();
+				extractedFile.close();
+			}
+		}
+
+		release(zip);
+
+		return ba;
+	};
+
+protected:
+	QuaZip* acquire() {
+
+		{
+			QMutexLocker locker(&mMutex);
+
+			if (!mIdle.empty())
+				return mIdle.takeLast();
+		}
+
+		QuaZip* zip = new QuaZip(mZipFile);
+
+		// goToFirstFile makes QuaZipFile accept the positions we set
+		if (!zip->open(QuaZip::mdUnzip) || !zip->goToFirstFile()) {
+			delete zip;
+			return 0;
+		}
+
+		QMutexLocker locker(&mMutex);
+
+		if (!mIndexed) {
+
+			DkTimer dt;
+
+			for (bool more = true; more; more = zip->goToNextFile()) {
+
+				unz64_file_pos pos;
+				if (unzGetFilePos64(zip->getUnzFile(), &pos) != UNZ_OK)
+					continue;
+
+				QString name = zip->getCurrentFileName();
+				mEntries.insert(name, pos);
+				mFileList << name;
+			}
+
+			mIndexed = true;
+			qDebug() << "[DkZipArchive]" << mEntries.size() << "entries indexed in" << dt;
+
+			// the loop ends behind the last entry - QuaZipFile needs a current file
+			if (!zip->goToFirstFile()) {
+				delete zip;
+				return 0;
+			}
+		}
+
+		return zip;
+	};
+
+	void release(QuaZip* zip) {
+
+		// failed lookups reset the current file - unzGoToFilePos64 does not set it again
+		if (!zip->hasCurrentFile() && !zip->goToFirstFile()) {
+			delete zip;
+			return;
+		}
+
+		QMutexLocker locker(&mMutex);
+
+		if (mIdle.size() < DkThreadPools::numIoThreads)
+			mIdle << zip;
+		else
+			delete zip;
+	};
+
+	QString mZipFile;
+	QDateTime mModified;
+
+	QMutex mMutex;
+	bool mIndexed = false;
+	QHash<QString, unz64_file_pos> mEntries;
+	QStringList mFileList;
+	QList<QuaZip*> mIdle;
+};
+
+/**
+ * Returns the resident archive (the most recently used archives are kept open).
+ * @param zipFile the zip file
+ * @return QSharedPointer<DkZipArchive> the archive
+ **/ 
+static QSharedPointer<DkZipArchive> zipArchive(const QString& zipFile) {
+
+	static QMutex mutex;
+	static QList<QSharedPointer<DkZipArchive> > archives;	// least recently used first
+	static QStringList archivePaths;
+	const int maxArchives = 4;
+
+	QMutexLocker locker(&mutex);
+
+	int idx = archivePaths.indexOf(zipFile);
+	QSharedPointer<DkZipArchive> archive;
+
+	if (idx != -1) {
+		archive = archives.takeAt(idx);
+		archivePaths.removeAt(idx);
+
+		// the archive was changed - parse it again
+		if (!archive->isValid())
+			archive.clear();
+	}
+
+	if (!archive)
+		archive = QSharedPointer<DkZipArchive>(new DkZipArchive(zipFile));
+
+	archives << archive;
+	archivePaths << zipFile;
+
+	if (archives.size() > maxArchives) {
+		archives.removeFirst();
+		archivePaths.removeFirst();
+	}
+
+	return archive;
+}
+
 DkZipContainer::DkZipContainer(const QString& encodedFilePath) {
 
 	if (!encodedFilePath.isEmpty() && 
@@ -1720,42 +2750,28 @@ QString DkZipContainer::decodeImageFile(const QString& encodedFileInfo) {
 
 QSharedPointer<QByteArray> DkZipContainer::extractImage(const QString& zipFile, const QString& imageFile) {
 
-	QuaZip zip(zipFile);		
-	if(!zip.open(QuaZip::mdUnzip)) 
-		return QSharedPointer<QByteArray>(new QByteArray());
-
-	qDebug() << "DkZip::extractImage filePath: " << zipFile;
-	qDebug() << "3.0 image file" << imageFile;
-
-	zip.setCurrentFile(imageFile);
-	QuaZipFile extractedFile(&zip);
-	if(!extractedFile.open(QIODevice::ReadOnly) || extractedFile.getZipError() != UNZ_OK) 
-		return QSharedPointer<QByteArray>(new QByteArray());
-
-	QSharedPointer<QByteArray> ba(new QByteArray(extractedFile.readAll()));
-	extractedFile.close();
-
-	zip.close();
-
-	return ba;
+	return QSharedPointer<QByteArray>(new QByteArray(zipArchive(zipFile)->extract(imageFile)));
 }
 
 void DkZipContainer::extractImage(const QString& zipFile, const QString& imageFile, QByteArray& ba) {
 
-	QuaZip zip(zipFile);		
-	if(!zip.open(QuaZip::mdUnzip)) 
-		return;
+	ba = zipArchive(zipFile)->extract(imageFile);
+}
 
-	zip.setCurrentFile(imageFile);
-	QuaZipFile extractedFile(&zip);
-	if(!extractedFile.open(QIODevice::ReadOnly) || extractedFile.getZipError() != UNZ_OK) 
-		return;
+/**
+ * Returns the names of all entries in the zip file.
+ * The archive's central directory is kept - so extracting entries is fast afterwards.
+ * @param zipFile the zip file
+ * @return QStringList the entries (empty if the archive could not be opened)
+ **/ 
+QStringList DkZipContainer::fileList(const QString& zipFile) {
 
-	ba = QByteArray(extractedFile.readAll());
-	extractedFile.close();
+	QSharedPointer<DkZipArchive> archive = zipArchive(zipFile);
 
-	zip.close();
+	if (!archive->index())
+		return QStringList();
 
+	return archive->fileList();
 }
 
 bool DkZipContainer::isZip() const {
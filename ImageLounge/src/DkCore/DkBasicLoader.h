@@ -32,6 +32,11 @@
 #include <QSharedPointer>
 #include <QUrl>
 #include <QImage>
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
 #pragma warning(pop)
 
 #pragma warning(disable: 4251)	// TODO: remove
@@ -64,10 +69,12 @@
 
 // Qt defines
 class QNetworkReply;
+class QImageReader;
 
 namespace nmc {
 
 class DkMetaDataT;
+class DkImageFormat;
 
 #ifdef WITH_QUAZIP
 class DllCoreExport DkZipContainer {
@@ -82,6 +89,7 @@ public:
 	static QString zipMarker();
 	static QSharedPointer<QByteArray> extractImage(const QString& zipFile, const QString& imageFile);
 	static void extractImage(const QString& zipFile, const QString& imageFile, QByteArray& ba);
+	static QStringList fileList(const QString& zipFile);
 	static QString decodeZipFile(const QString& encodedFileInfo);
 	static QString decodeImageFile(const QString& encodedFileInfo);
 	static QString encodeZipFile(const QString& zipFile, const QString& imageFile);
@@ -111,6 +119,87 @@ protected:
 
 };
 
+/**
+ * Cooperative cancellation of threaded loads.
+ * The token is shared between the thread that starts a load
+ * and the worker. Workers poll isCanceled() between expensive
+ * steps and stop early if the result is not needed anymore.
+ **/ 
+class DllCoreExport DkCancelToken {
+
+public:
+	void cancel() {
+		mCanceled.storeRelease(1);
+	};
+
+	bool isCanceled() const {
+		return mCanceled.loadAcquire() != 0;
+	};
+
+protected:
+	QAtomicInt mCanceled;
+};
+
+/**
+ * Loads files to shared buffers.
+ * Files are read in chunks by default. Mapping is opt-in:
+ * large files are then memory mapped (on unix) and wrapped into
+ * the QByteArray without copying. The buffer is read-only:
+ * non-const access detaches (copies) it. Copies of the
+ * QByteArray must not outlive the shared pointer.
+ * Reading a mapped buffer faults (SIGBUS) if another process
+ * truncates the file. Hence, only map files nobody else writes -
+ * nomacs does not map the images it displays.
+ **/ 
+class DllCoreExport DkFileBuffer {
+
+public:
+	static QSharedPointer<QByteArray> load(const QString& filePath, bool map = false, QSharedPointer<DkCancelToken> token = QSharedPointer<DkCancelToken>());
+	static bool isMapped(const QSharedPointer<QByteArray>& ba);
+	static qint64 write(const QString& filePath, const QByteArray& ba);
+
+	static const qint64 mapThreshold = 8 * 1024 * 1024;	// files smaller than this are read
+
+protected:
+	static QMutex& mappedMutex();
+	static QSet<const char*>& mappedBuffers();
+};
+
+/**
+ * Directory index of multi-page TIFF files.
+ * libtiff can only walk the directories one by one. Hence,
+ * loading page N would cost N directory reads. The index
+ * stores the offsets of all directories so that pages are
+ * loaded with a single seek. Indices are kept in memory
+ * (most recently used files) and in the user's cache folder.
+ * Entries are keyed by path, size and modification date.
+ **/ 
+class DllCoreExport DkTiffIndex {
+
+public:
+	static DkTiffIndex& instance();
+
+	// singleton
+	DkTiffIndex(DkTiffIndex const&)			= delete;
+	void operator=(DkTiffIndex const&)		= delete;
+
+	QVector<quint64> find(const QString& filePath);
+	void insert(const QString& filePath, const QVector<quint64>& offsets);
+
+private:
+	DkTiffIndex();
+
+	QString key(const QString& filePath) const;
+	QString entryPath(const QString& key) const;
+	void touch(const QString& key);
+
+	QString mCacheDir;
+	QMutex mMutex;
+	QHash<QString, QVector<quint64> > mIndices;
+	QStringList mRecent;	// least recently used first
+	int mMaxEntries = 64;
+};
+
 /**
  * This class provides image loading and editing capabilities.
  * It additionally stores the currently loaded image.
@@ -151,9 +240,10 @@ public:
 	 * Loads the image for the given file
 	 * @param file an image file
 	 * @param skipIdx the number of (internal) pages to be skipped
+	 * @param token if canceled, loading stops early and false is returned
 	 * @return bool true if the image was loaded
 	 **/
-	bool loadGeneral(const QString& filePath, const QSharedPointer<QByteArray> ba, bool loadMetaData = false, bool fast = false);
+	bool loadGeneral(const QString& filePath, const QSharedPointer<QByteArray> ba, bool loadMetaData = false, bool fast = false, QSharedPointer<DkCancelToken> token = QSharedPointer<DkCancelToken>());
 
 	/**
 	 * Loads the page requested (with respect to the current page)
@@ -174,6 +264,39 @@ public:
 	bool setPageIdx(int skipIdx);
 	void resetPageIdx();
 
+	/**
+	 * Sets the size images are displayed at.
+	 * If set, images are decoded at the smallest scale that covers it.
+	 * @param size the display size (an invalid size decodes all pixels)
+	 **/
+	void setDisplaySize(const QSize& size) {
+		mDisplaySize = size;
+	};
+
+	QSize displaySize() const {
+		return mDisplaySize;
+	};
+
+	/**
+	 * Returns true if the image was decoded for display (see setDisplaySize).
+	 * @return bool true if the image is smaller than the original
+	 **/
+	bool isDownscaled() const {
+		return mDownscaled;
+	};
+
+	QSize originalSize() const {
+		return mDownscaled ? mOriginalSize : image().size();
+	};
+
+	/**
+	 * Returns true if the current load was canceled (see loadGeneral).
+	 * @return bool true if the load's token is canceled
+	 **/
+	bool isCanceled() const {
+		return mCancelToken && mCancelToken->isCanceled();
+	};
+
 	QString save(const QString& filePath, const QImage& img, int compression = -1);
 	bool saveToBuffer(const QString& filePath, const QImage& img, QSharedPointer<QByteArray>& ba, int compression = -1);
 	void saveThumbToMetaData(const QString& filePath, QSharedPointer<QByteArray>& ba);
@@ -285,9 +408,13 @@ public slots:
 	QImage rotate(const QImage& img, int orientation);
 
 protected:
+	bool loadFormat(const DkImageFormat& format, QImage& img, QSharedPointer<QByteArray> ba, bool fast);
+	bool loadQtImage(const QString& filePath, QImage& img, QSharedPointer<QByteArray> ba, const QByteArray& format);
+	QSize displayDecodeSize(QImageReader& reader) const;
 	bool loadRohFile(const QString& filePath, QImage& img, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>()) const;
-	bool loadRawFile(const QString& filePath, QImage& img, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(), bool fast = false) const;
+	bool loadRawFile(const QString& filePath, QImage& img, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(), bool fast = false);
 	void indexPages(const QString& filePath);
+	bool loadTiffPage(int pageIdx, QImage& img, bool nativeOnly = false, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
 	void convert32BitOrder(void *buffer, int width);
 
 	int mLoader;
@@ -302,6 +429,12 @@ protected:
 	QVector<DkEditImage> mImages;
 	int mMinHistorySize = 2;
 	int mImageIndex = 0;
+
+	QSize mDisplaySize;
+	QSize mOriginalSize;
+	bool mDownscaled = false;
+
+	QSharedPointer<DkCancelToken> mCancelToken;
 };
 
 // file downloader from: http://qt-project.org/wiki/Download_Data_from_URL
@@ -0,0 +1,320 @@
+/*******************************************************************************************************
+ DkBenchmark.cpp
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkBenchmark.h"
+
+#include "DkBasicLoader.h"
+#include "DkFormatRegistry.h"
+#include "DkImageContainer.h"
+#include "DkMetaData.h"
+#include "DkSettings.h"
+#include "DkThreadPools.h"
+#include "DkTimer.h"
+#include "DkUtils.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QVector>
+#pragma warning(pop)		// no warnings from includes - end
+
+#include <algorithm>
+
+namespace nmc {
+
+// DkBenchmark --------------------------------------------------------------------
+/**
+ * Runs a benchmark suite.
+ * @param suite the suite's name (see suites())
+ * @param dirPath sample images for suites that decode files
+ * @return bool false if the suite is unknown or cannot run
+ **/ 
+bool DkBenchmark::run(const QString& suite, const QString& dirPath) {
+
+	QStringList needsFiles = QStringList() << "formats" << "raw" << "exif-thumbs";
+
+	if (needsFiles.contains(suite) && !QFileInfo(dirPath).isDir()) {
+		qWarning() << "the" << suite << "benchmark needs sample images - set them with --benchmark-dir";
+		return false;
+	}
+
+	if (suite == "sort")
+		sortImages();
+	else if (suite == "formats")
+		decodeFormats(dirPath);
+	else if (suite == "raw")
+		developRaw(dirPath);
+	else if (suite == "exif-thumbs")
+		readExifThumbs(dirPath);
+	else {
+		qWarning() << "unknown benchmark" << suite << "- available:" << suites().join(", ");
+		return false;
+	}
+
+	// queue latencies of the jobs the suite ran in the thread pools
+	qInfo().noquote() << "[DkThreadPools]\n" << DkThreadPools::instance().report();
+
+	return true;
+}
+
+QStringList DkBenchmark::suites() {
+
+	return QStringList() << "sort" << "formats" << "raw" << "exif-thumbs";
+}
+
+/**
+ * Sorts synthetic file lists (10k, 100k and 1M files) by name.
+ * Compares the precomputed keys (sequential and parallel) with
+ * the natural compare of file infos that was used before.
+ **/ 
+void DkBenchmark::sortImages() {
+
+	const int sortMode = DkSettings::sort_filename;
+
+	for (int numFiles : {10000, 100000, 1000000}) {
+
+		QStringList fileNames = syntheticFileNames(numFiles);
+
+		DkTimer dt;
+		QVector<DkSortKey> keys;
+		keys.reserve(numFiles);
+
+		for (const QString& fn : fileNames)
+			keys << DkSortKey(fn);
+
+		qInfo() << "[sort]" << numFiles << "keys created in" << dt;
+
+		QVector<DkSortKey> seqKeys = keys;
+		dt.start();
+		std::sort(seqKeys.begin(), seqKeys.end(), [sortMode](const DkSortKey& l, const DkSortKey& r) {
+			return l.lessThan(r, sortMode);
+		});
+		qInfo() << "[sort]" << numFiles << "keys sorted (1 thread) in" << dt;
+
+		dt.start();
+		sortKeys(keys, sortMode, true);
+		qInfo() << "[sort]" << numFiles << "keys sorted (parallel) in" << dt;
+
+		// tokenizing in the comparator takes minutes for 1M files
+		if (numFiles > 100000)
+			continue;
+
+		QVector<QFileInfo> files;
+		files.reserve(numFiles);
+
+		for (const QString& fn : fileNames)
+			files << QFileInfo(fn);
+
+		dt.start();
+		std::sort(files.begin(), files.end(), &DkUtils::compFilename);
+		qInfo() << "[sort]" << numFiles << "file infos sorted (natural compare) in" << dt;
+	}
+}
+
+/**
+ * Decodes all files of a directory tree and reports the timings per format.
+ * Run it on a mixed corpus (e.g. a folder with misnamed and RAW files)
+ * so that misdetections and slow fallbacks show up.
+ * @param dirPath the corpus
+ **/ 
+void DkBenchmark::decodeFormats(const QString& dirPath) {
+
+	// no name filters - misnamed files are part of the corpus
+	QStringList filePaths = files(dirPath);
+	DkFormatRegistry::instance().clearTimings();
+
+	DkTimer dt;
+	int numLoaded = 0;
+
+	for (const QString& fp : filePaths) {
+		DkBasicLoader loader;
+		
+		if (loader.loadGeneral(fp, true))
+			numLoaded++;
+	}
+
+	qInfo().noquote() << "[formats]" << numLoaded << "/" << filePaths.size() << "files decoded in" << dt 
+		<< "\n" << DkFormatRegistry::instance().report();
+}
+
+/**
+ * Develops all RAW files of a directory tree at full size.
+ * Embedded previews are not used and full renderings are not cached
+ * (see DkRawCache) - so every file is developed by LibRaw & OpenCV.
+ * @param dirPath sample RAW files (e.g. a 45 MP shoot)
+ **/ 
+void DkBenchmark::developRaw(const QString& dirPath) {
+
+	QStringList nameFilters;
+
+	// "Nikon Raw (*.nef *.nrw)" -> *.nef, *.nrw
+	for (const QString& f : DkSettingsManager::param().app().rawFilters) {
+		QString patterns = f.section('(', 1).section(')', 0, 0);
+		nameFilters << patterns.split(' ', QString::SkipEmptyParts);
+	}
+
+	QStringList filePaths = files(dirPath, nameFilters);
+
+	int& loadRawThumb = DkSettingsManager::param().resources().loadRawThumb;
+	int oldLoadRawThumb = loadRawThumb;
+	loadRawThumb = DkSettings::raw_thumb_never;
+
+	DkTimer dt;
+	double mPixels = 0;
+	int numDeveloped = 0;
+
+	for (const QString& fp : filePaths) {
+
+		DkTimer ft;
+		DkBasicLoader loader;
+
+		if (!loader.loadGeneral(fp)) {
+			qWarning() << "[raw] could not develop" << fp;
+			continue;
+		}
+
+		QSize s = loader.image().size();
+		mPixels += s.width() * (double)s.height() / 1e6;
+		numDeveloped++;
+
+		qInfo() << "[raw]" << QFileInfo(fp).fileName() << s << "developed in" << ft;
+	}
+
+	loadRawThumb = oldLoadRawThumb;
+
+	double sec = dt.elapsed() / 1000.0;
+	qInfo() << "[raw]" << numDeveloped << "/" << filePaths.size() << "files developed in" << dt
+		<< QString("(%1 MP/s)").arg(sec > 0 ? mPixels / sec : 0.0, 0, 'f', 1);
+}
+
+/**
+ * Reads the EXIF thumbnails of a directory tree with DkExifThumb and with Exiv2.
+ * Both readers get the same files from the page cache - so just the
+ * parsing is compared. Makernote-heavy files (nef, cr2) show the difference.
+ * @param dirPath sample images
+ **/ 
+void DkBenchmark::readExifThumbs(const QString& dirPath) {
+
+	QStringList filePaths = files(dirPath, QStringList() << "*.jpg" << "*.jpeg" << "*.tif" << "*.tiff" << "*.nef" << "*.cr2" << "*.arw");
+
+	// warm up the page cache
+	for (const QString& fp : filePaths)
+		DkFileBuffer::load(fp);
+
+	DkTimer dt;
+	int numFast = 0;
+	QVector<int> fastOrientations;
+	fastOrientations.reserve(filePaths.size());
+
+	for (const QString& fp : filePaths) {
+
+		DkExifThumb exifReader;
+		exifReader.read(fp);
+
+		if (!exifReader.thumbnail().isNull())
+			numFast++;
+
+		fastOrientations << exifReader.orientationDegree();
+	}
+
+	qInfo() << "[exif-thumbs] DkExifThumb:" << numFast << "/" << filePaths.size() << "thumbnails read in" << dt;
+
+	dt.start();
+	int numExiv2 = 0;
+	int numMismatches = 0;
+
+	for (int idx = 0; idx < filePaths.size(); idx++) {
+
+		QImage thumb;
+		int orientation = 0;
+
+		try {
+			DkMetaDataT metaData;
+			metaData.readMetaData(filePaths[idx]);
+			thumb = metaData.getThumbnail();
+			orientation = metaData.getOrientationDegree();
+		}
+		catch (...) {
+		}
+
+		if (!thumb.isNull())
+			numExiv2++;
+
+		if (!thumb.isNull() && orientation != fastOrientations[idx])
+			numMismatches++;
+	}
+
+	qInfo() << "[exif-thumbs] Exiv2:" << numExiv2 << "/" << filePaths.size() << "thumbnails read in" << dt
+		<< "-" << numMismatches << "orientations differ";
+}
+
+/**
+ * Creates shuffled file names as they are found in photo folders.
+ * @param numFiles the number of file names
+ * @return QStringList the file names
+ **/ 
+QStringList DkBenchmark::syntheticFileNames(int numFiles) {
+
+	QStringList fileNames;
+	fileNames.reserve(numFiles);
+
+	for (int idx = 0; idx < numFiles; idx++) {
+
+		switch (idx % 4) {
+		case 0:	fileNames << QString("IMG_%1.JPG").arg(idx);									break;
+		case 1:	fileNames << QString("DSC%1.NEF").arg(idx, 7, 10, QChar('0'));					break;
+		case 2:	fileNames << QString("holiday %1 - part %2.png").arg(idx / 100).arg(idx % 100);	break;
+		case 3:	fileNames << QString("Scan-%1-v%2.tif").arg(idx * 7919 % numFiles).arg(idx % 3);	break;
+		}
+	}
+
+	std::random_shuffle(fileNames.begin(), fileNames.end());
+
+	return fileNames;
+}
+
+/**
+ * Lists the files of a directory tree (sorted, so runs are comparable).
+ * @param dirPath the root directory
+ * @param nameFilters e.g. *.nef - all files are listed if empty
+ * @return QStringList the file paths
+ **/ 
+QStringList DkBenchmark::files(const QString& dirPath, const QStringList& nameFilters) {
+
+	QStringList filePaths;
+	QDirIterator it(dirPath, nameFilters, QDir::Files, QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+
+	while (it.hasNext())
+		filePaths << it.next();
+
+	filePaths.sort();
+
+	return filePaths;
+}
+
+};
@@ -0,0 +1,68 @@
+/*******************************************************************************************************
+ DkBenchmark.h
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <QStringList>
+#pragma warning(pop)		// no warnings from includes - end
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+namespace nmc {
+
+/**
+ * Headless benchmarks (--benchmark).
+ * The results are written to the log. Suites that decode
+ * files need a directory with sample images (--benchmark-dir).
+ **/ 
+class DllCoreExport DkBenchmark {
+
+public:
+	static bool run(const QString& suite, const QString& dirPath = QString());
+	static QStringList suites();
+
+	static void sortImages();
+	static void decodeFormats(const QString& dirPath);
+	static void developRaw(const QString& dirPath);
+	static void readExifThumbs(const QString& dirPath);
+
+protected:
+	static QStringList syntheticFileNames(int numFiles);
+	static QStringList files(const QString& dirPath, const QStringList& nameFilters = QStringList());
+};
+
+};
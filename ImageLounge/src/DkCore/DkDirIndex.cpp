@@ -0,0 +1,551 @@
+/*******************************************************************************************************
+ DkDirIndex.cpp
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkDirIndex.h"
+
+#include "DkSettings.h"
+#include "DkTimer.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#pragma warning(pop)		// no warnings from includes - end
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#endif
+
+namespace nmc {
+
+// DkDirIndexEntry --------------------------------------------------------------------
+DkDirIndexEntry::DkDirIndexEntry(const QString& fileName, qint64 size, const QDateTime& modified, const QDateTime& created) {
+
+	mFileName = fileName;
+	mSize = size;
+	mModified = modified;
+	mCreated = created;
+}
+
+/**
+ * Creates an entry from a file info (this stats the file).
+ **/ 
+DkDirIndexEntry DkDirIndexEntry::fromFileInfo(const QFileInfo& fileInfo) {
+
+	return DkDirIndexEntry(fileInfo.fileName(), fileInfo.size(), fileInfo.lastModified(), fileInfo.created());
+}
+
+QString DkDirIndexEntry::fileName() const {
+	return mFileName;
+}
+
+qint64 DkDirIndexEntry::size() const {
+	return mSize;
+}
+
+QDateTime DkDirIndexEntry::modified() const {
+	return mModified;
+}
+
+QDateTime DkDirIndexEntry::created() const {
+	return mCreated;
+}
+
+// DkDirIndex --------------------------------------------------------------------
+DkDirIndex::DkDirIndex(const QString& dirPath) {
+
+	mDirPath = dirPath;
+	mFilterSignature = filterSignature();
+}
+
+QString DkDirIndex::dirPath() const {
+	return mDirPath;
+}
+
+QStringList DkDirIndex::fileNames() const {
+	return mEntries.keys();
+}
+
+/**
+ * Returns the indexed files.
+ * @param withStats if false, just the file names are returned (sizes & dates are unknown).
+ **/ 
+QVector<DkDirIndexEntry> DkDirIndex::entries(bool withStats) const {
+
+	if (withStats)
+		return mEntries.values().toVector();
+
+	QVector<DkDirIndexEntry> entries;
+	entries.reserve(mEntries.size());
+
+	for (const QString& fileName : mEntries.keys())
+		entries << DkDirIndexEntry(fileName);
+
+	return entries;
+}
+
+DkDirIndexEntry DkDirIndex::entry(const QString& fileName) const {
+	return mEntries.value(fileName);
+}
+
+bool DkDirIndex::contains(const QString& fileName) const {
+	return mEntries.contains(fileName);
+}
+
+int DkDirIndex::size() const {
+	return mEntries.size();
+}
+
+/**
+ * Replaces the index with a new listing of the directory.
+ * @param entries all files of the directory.
+ * @param dirModified the directory's modification date before it was listed.
+ **/ 
+void DkDirIndex::setEntries(const QVector<DkDirIndexEntry>& entries, const QDateTime& dirModified) {
+
+	mEntries.clear();
+	mEntries.reserve(entries.size());
+
+	for (const DkDirIndexEntry& e : entries)
+		mEntries.insert(e.fileName(), e);
+
+	mFilterSignature = filterSignature();
+	mDirModified = dirModified;
+	mDirty = true;
+}
+
+void DkDirIndex::insert(const DkDirIndexEntry& entry) {
+
+	mEntries.insert(entry.fileName(), entry);
+	mDirty = true;
+}
+
+void DkDirIndex::remove(const QString& fileName) {
+
+	mDirty |= mEntries.remove(fileName) > 0;
+}
+
+/**
+ * Forgets all sizes & dates (e.g. if we do not get change events anymore).
+ **/ 
+void DkDirIndex::clearStats() {
+
+	for (auto it = mEntries.begin(); it != mEntries.end(); it++)
+		it.value() = DkDirIndexEntry(it.key());
+}
+
+/**
+ * Call this if the index is in sync with the directory.
+ **/ 
+void DkDirIndex::updateDirModified() {
+
+	mDirModified = QFileInfo(mDirPath).lastModified();
+	mDirty = true;
+}
+
+/**
+ * Returns true if the index is in sync with the directory.
+ * Adding, removing or renaming files changes the directory's 
+ * modification date - so this costs a single stat call.
+ **/ 
+bool DkDirIndex::isValid() const {
+
+	if (!mDirModified.isValid() || mFilterSignature != filterSignature())
+		return false;
+
+	return QFileInfo(mDirPath).lastModified() == mDirModified;
+}
+
+bool DkDirIndex::isDirty() const {
+	return mDirty;
+}
+
+bool DkDirIndex::load(const QString& filePath) {
+
+	QFile file(filePath);
+
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream ds(&file);
+	ds.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic, version;
+	ds >> magic >> version;
+
+	if (magic != 0x6e6d6469 || version != 3)	// 'nmdi'
+		return false;
+
+	QString dirPath;
+	QStringList fileNames;
+	ds >> dirPath >> mDirModified >> mFilterSignature >> fileNames;
+
+	// hash collision or broken file
+	if (ds.status() != QDataStream::Ok || dirPath != mDirPath)
+		return false;
+
+	mEntries.clear();
+	mEntries.reserve(fileNames.size());
+
+	// we did not see changes while nomacs was closed - so sizes & dates are not stored
+	for (const QString& fileName : fileNames)
+		mEntries.insert(fileName, DkDirIndexEntry(fileName));
+
+	mDirty = false;
+
+	return true;
+}
+
+bool DkDirIndex::save(const QString& filePath) {
+
+	QSaveFile file(filePath);
+
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+
+	QDataStream ds(&file);
+	ds.setVersion(QDataStream::Qt_5_0);
+
+	ds << (quint32)0x6e6d6469 << (quint32)3;
+	ds << mDirPath << mDirModified << mFilterSignature << fileNames();
+
+	if (!file.commit())
+		return false;
+
+	mDirty = false;
+
+	return true;
+}
+
+/**
+ * The index becomes invalid if the user changes the browse filters.
+ **/ 
+QString DkDirIndex::filterSignature() {
+
+	return DkSettingsManager::param().app().browseFilters.join(";");
+}
+
+// DkDirIndexManager --------------------------------------------------------------------
+DkDirIndexManager::DkDirIndexManager() {
+
+	mCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QDir::separator() + "dirindex";
+	QDir().mkpath(mCacheDir);
+
+	mSaveTimer.setSingleShot(true);
+	mSaveTimer.setInterval(5000);
+	connect(&mSaveTimer, SIGNAL(timeout()), this, SLOT(save()));
+
+	if (QCoreApplication::instance())
+		connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(save()));
+
+	connect(&DkDirWatcher::instance(), &DkDirWatcher::eventsRead, this, &DkDirIndexManager::readEvents);
+
+	if (!canWatch())
+		qWarning() << "[DkDirIndexManager] could not initialize inotify - falling back to the file system watcher";
+}
+
+DkDirIndexManager::~DkDirIndexManager() {
+}
+
+/**
+ * Returns the singleton. Call it from the GUI thread first.
+ **/ 
+DkDirIndexManager& DkDirIndexManager::instance() {
+
+	static DkDirIndexManager inst;
+	return inst;
+}
+
+/**
+ * Returns the indexed files of a directory. This function is thread-safe.
+ * @param dirPath the directory.
+ * @param entries the files (unsorted), if the index is valid. Sizes and dates are unknown if the directory is not watched.
+ * @return bool true if the directory did not change since it was indexed.
+ **/ 
+bool DkDirIndexManager::entries(const QString& dirPath, QVector<DkDirIndexEntry>& entries) {
+
+	QMutexLocker locker(&mMutex);
+	QSharedPointer<DkDirIndex> dirIndex = index(dirPath);
+
+	if (!dirIndex || !dirIndex->isValid())
+		return false;
+
+	// files rewritten in place do not change the directory's date - so we only trust the stats if we get events
+	entries = dirIndex->entries(mWatchCount.contains(dirPath));
+
+	return true;
+}
+
+/**
+ * Sets the listing of a directory. This function is thread-safe.
+ * @param dirPath the directory.
+ * @param entries all files of the directory that match the browse filters.
+ * @param dirModified the directory's modification date before it was listed.
+ * @param saveIndex if true, the index is written to disk right away.
+ **/ 
+void DkDirIndexManager::setEntries(const QString& dirPath, const QVector<DkDirIndexEntry>& entries, const QDateTime& dirModified, bool saveIndex) {
+
+	QSharedPointer<DkDirIndex> dirIndex(new DkDirIndex(dirPath));
+	dirIndex->setEntries(entries, dirModified);
+
+	{
+		QMutexLocker locker(&mMutex);
+		
+		mIndices.insert(dirPath, dirIndex);
+		mRecentDirs.removeAll(dirPath);
+		mRecentDirs.prepend(dirPath);
+		evictIndices();
+
+		if (saveIndex)
+			dirIndex->save(indexFilePath(dirPath));
+	}
+}
+
+/**
+ * Returns true if directories are updated incrementally.
+ * Otherwise, the caller has to use a QFileSystemWatcher.
+ **/ 
+bool DkDirIndexManager::canWatch() const {
+
+	return DkDirWatcher::instance().isValid();
+}
+
+void DkDirIndexManager::watch(const QString& dirPath) {
+
+	QMutexLocker locker(&mMutex);
+
+	if (dirPath.isEmpty() || !canWatch() || mWatchCount[dirPath]++ > 0)
+		return;
+
+	if (!DkDirWatcher::instance().watch(dirPath)) {
+		mWatchCount.remove(dirPath);
+		qWarning() << "[DkDirIndexManager] could not watch" << dirPath;
+	}
+}
+
+void DkDirIndexManager::unwatch(const QString& dirPath) {
+
+	QMutexLocker locker(&mMutex);
+
+	if (!mWatchCount.contains(dirPath) || --mWatchCount[dirPath] > 0)
+		return;
+
+	mWatchCount.remove(dirPath);
+	DkDirWatcher::instance().unwatch(dirPath);
+
+	// we will miss changes from now on
+	if (QSharedPointer<DkDirIndex> dirIndex = mIndices.value(dirPath))
+		dirIndex->clearStats();
+}
+
+/**
+ * Writes all indices that changed to disk.
+ **/ 
+void DkDirIndexManager::save() {
+
+	QMutexLocker locker(&mMutex);
+
+	for (auto it = mIndices.begin(); it != mIndices.end(); it++) {
+		if (it.value()->isDirty())
+			it.value()->save(indexFilePath(it.key()));
+	}
+}
+
+/**
+ * Applies inotify events to the indices of watched directories.
+ **/ 
+void DkDirIndexManager::readEvents(const QVector<DkDirWatcher::Event>& events) {
+
+#ifdef Q_OS_LINUX
+	QHash<QString, QHash<QString, int> > changes;
+	QStringList invalidated;
+	QStringList filters = DkSettingsManager::param().app().browseFilters;
+
+	for (const DkDirWatcher::Event& e : events) {
+
+		// we lost events - we cannot trust any index
+		if (e.mask & IN_Q_OVERFLOW) {
+			invalidated << mWatchCount.keys();
+			continue;
+		}
+
+		// not ours (e.g. the file watcher)
+		if (!mWatchCount.contains(e.dirPath))
+			continue;
+
+		if (e.mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+			invalidated << e.dirPath;
+			continue;
+		}
+
+		if (e.fileName.isEmpty() || (e.mask & IN_ISDIR))
+			continue;
+
+		if (!QDir::match(filters, e.fileName))
+			continue;
+
+		int change = change_modified;
+
+		if (e.mask & (IN_CREATE | IN_MOVED_TO))
+			change = change_added;
+		else if (e.mask & (IN_DELETE | IN_MOVED_FROM))
+			change = change_removed;
+		else if (!(e.mask & IN_CLOSE_WRITE))
+			change = change_touched;
+
+		QHash<QString, int>& dirChanges = changes[e.dirPath];
+		int oldChange = dirChanges.value(e.fileName, -1);
+
+		// files are created & written - they stay new
+		if ((oldChange == change_added || oldChange == change_modified) && (change == change_modified || change == change_touched))
+			continue;
+
+		dirChanges.insert(e.fileName, change);
+	}
+
+	invalidated.removeDuplicates();
+
+	for (const QString& dirPath : invalidated) {
+		removeIndex(dirPath);
+		changes.remove(dirPath);
+		emit indexInvalidated(dirPath);
+	}
+
+	for (auto it = changes.begin(); it != changes.end(); it++)
+		applyChanges(it.key(), it.value());
+#else
+	Q_UNUSED(events);
+#endif
+}
+
+void DkDirIndexManager::applyChanges(const QString& dirPath, const QHash<QString, int>& changes) {
+
+	QStringList added, removed, modified;
+	QDir dir(dirPath);
+
+	{
+		QMutexLocker locker(&mMutex);
+		QSharedPointer<DkDirIndex> dirIndex = mIndices.value(dirPath);
+
+		for (auto it = changes.begin(); it != changes.end(); it++) {
+
+			const QString& fileName = it.key();
+
+			if (it.value() == change_removed) {
+				removed << fileName;
+
+				if (dirIndex)
+					dirIndex->remove(fileName);
+			}
+			else {
+				
+				// touched files just get their new dates
+				if (it.value() == change_added)
+					added << fileName;
+				else if (it.value() == change_modified)
+					modified << fileName;
+
+				if (dirIndex)
+					dirIndex->insert(DkDirIndexEntry::fromFileInfo(QFileInfo(dir, fileName)));
+			}
+		}
+
+		// we are in sync again
+		if (dirIndex)
+			dirIndex->updateDirModified();
+	}
+
+	mSaveTimer.start();
+
+	if (!added.empty() || !removed.empty() || !modified.empty())
+		emit filesChanged(dirPath, added, removed, modified);
+}
+
+/**
+ * Returns the index of dirPath (from memory or disk).
+ * The mutex must be locked.
+ **/ 
+QSharedPointer<DkDirIndex> DkDirIndexManager::index(const QString& dirPath) {
+
+	QSharedPointer<DkDirIndex> dirIndex = mIndices.value(dirPath);
+
+	if (!dirIndex) {
+
+		dirIndex = QSharedPointer<DkDirIndex>(new DkDirIndex(dirPath));
+
+		if (!dirIndex->load(indexFilePath(dirPath)))
+			return QSharedPointer<DkDirIndex>();
+
+		mIndices.insert(dirPath, dirIndex);
+	}
+
+	mRecentDirs.removeAll(dirPath);
+	mRecentDirs.prepend(dirPath);
+	evictIndices();
+
+	return dirIndex;
+}
+
+/**
+ * Forgets the least recently used directories.
+ * The mutex must be locked.
+ **/ 
+void DkDirIndexManager::evictIndices() {
+
+	while (mRecentDirs.size() > mMaxIndices) {
+			
+		QString rDir = mRecentDirs.takeLast();
+		QSharedPointer<DkDirIndex> rIndex = mIndices.take(rDir);
+
+		if (rIndex && rIndex->isDirty())
+			rIndex->save(indexFilePath(rDir));
+	}
+}
+
+QString DkDirIndexManager::indexFilePath(const QString& dirPath) const {
+
+	QByteArray hash = QCryptographicHash::hash(dirPath.toUtf8(), QCryptographicHash::Md5).toHex();
+
+	return mCacheDir + QDir::separator() + QString::fromLatin1(hash) + ".idx";
+}
+
+void DkDirIndexManager::removeIndex(const QString& dirPath) {
+
+	QMutexLocker locker(&mMutex);
+
+	mIndices.remove(dirPath);
+	mRecentDirs.removeAll(dirPath);
+	QFile::remove(indexFilePath(dirPath));
+}
+
+}
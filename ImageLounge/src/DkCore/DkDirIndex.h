@@ -0,0 +1,189 @@
+/*******************************************************************************************************
+ DkDirIndex.h
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QObject>
+#include <QDataStream>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#pragma warning(pop)		// no warnings from includes - end
+
+#include "DkFileWatcher.h"
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+class QFileInfo;
+
+namespace nmc {
+
+/**
+ * A file of a directory index.
+ * Size & dates are -1/invalid if they are unknown.
+ * Image containers take them over, so sorting by date
+ * and estimating the memory of images does not stat.
+ **/ 
+class DllCoreExport DkDirIndexEntry {
+
+public:
+	DkDirIndexEntry(const QString& fileName = QString(), qint64 size = -1, const QDateTime& modified = QDateTime(), const QDateTime& created = QDateTime());
+
+	static DkDirIndexEntry fromFileInfo(const QFileInfo& fileInfo);
+
+	QString fileName() const;
+	qint64 size() const;
+	QDateTime modified() const;
+	QDateTime created() const;
+
+protected:
+	QString mFileName;
+	qint64 mSize = -1;
+	QDateTime mModified;
+	QDateTime mCreated;
+};
+
+/**
+ * Listing of a single directory.
+ * The index holds all files that match the browse filters.
+ * It is valid as long as the directory's modification date
+ * and the browse filters do not change. Rewriting a file does
+ * not change the directory's date - so sizes & dates are only
+ * kept while the directory is watched and just the file names
+ * are written to disk.
+ **/ 
+class DllCoreExport DkDirIndex {
+
+public:
+	DkDirIndex(const QString& dirPath = QString());
+
+	QString dirPath() const;
+	QStringList fileNames() const;
+	QVector<DkDirIndexEntry> entries(bool withStats = true) const;
+	DkDirIndexEntry entry(const QString& fileName) const;
+	bool contains(const QString& fileName) const;
+	int size() const;
+
+	void setEntries(const QVector<DkDirIndexEntry>& entries, const QDateTime& dirModified);
+	void insert(const DkDirIndexEntry& entry);
+	void remove(const QString& fileName);
+	void clearStats();
+	void updateDirModified();
+
+	bool isValid() const;
+	bool isDirty() const;
+
+	bool load(const QString& filePath);
+	bool save(const QString& filePath);
+
+	static QString filterSignature();
+
+protected:
+	QString mDirPath;
+	QDateTime mDirModified;
+	QString mFilterSignature;
+	QHash<QString, DkDirIndexEntry> mEntries;
+	bool mDirty = false;
+};
+
+/**
+ * Keeps the indices of visited directories in memory and on disk.
+ * Listing a directory that did not change since it was indexed is
+ * just a stat call. On Linux, watched directories are updated 
+ * incrementally (DkDirWatcher) and changes are reported with filesChanged().
+ * Sizes & dates are only handed out for watched directories.
+ **/ 
+class DllCoreExport DkDirIndexManager : public QObject {
+	Q_OBJECT
+
+public:
+	static DkDirIndexManager& instance();
+	~DkDirIndexManager();
+
+	// singleton
+	DkDirIndexManager(DkDirIndexManager const&)		= delete;
+	void operator=(DkDirIndexManager const&)		= delete;
+
+	bool entries(const QString& dirPath, QVector<DkDirIndexEntry>& entries);
+	void setEntries(const QString& dirPath, const QVector<DkDirIndexEntry>& entries, const QDateTime& dirModified, bool saveIndex = true);
+
+	bool canWatch() const;
+	void watch(const QString& dirPath);
+	void unwatch(const QString& dirPath);
+
+signals:
+	void filesChanged(const QString& dirPath, const QStringList& added, const QStringList& removed, const QStringList& modified) const;
+	void indexInvalidated(const QString& dirPath) const;
+
+public slots:
+	void save();
+
+protected slots:
+	void readEvents(const QVector<DkDirWatcher::Event>& events);
+
+protected:
+	DkDirIndexManager();
+
+	QSharedPointer<DkDirIndex> index(const QString& dirPath);
+	QString indexFilePath(const QString& dirPath) const;
+	void removeIndex(const QString& dirPath);
+	void evictIndices();
+	void applyChanges(const QString& dirPath, const QHash<QString, int>& changes);
+
+	enum {
+		change_added,
+		change_removed,
+		change_modified,
+		change_touched,		// only the dates changed (e.g. touch)
+
+		change_end
+	};
+
+	QMutex mMutex;
+	QHash<QString, QSharedPointer<DkDirIndex> > mIndices;
+	QStringList mRecentDirs;			// front: most recently used
+	QHash<QString, int> mWatchCount;
+	QString mCacheDir;
+	QTimer mSaveTimer;
+	int mMaxIndices = 32;
+};
+
+};
@@ -0,0 +1,353 @@
+/*******************************************************************************************************
+ DkFileWatcher.cpp
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkFileWatcher.h"
+
+#include "DkImageContainer.h"
+#include "DkBasicLoader.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#pragma warning(pop)		// no warnings from includes - end
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#endif
+
+namespace nmc {
+
+// DkDirWatcher --------------------------------------------------------------------
+DkDirWatcher::DkDirWatcher() {
+
+#ifdef Q_OS_LINUX
+	mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (mInotifyFd >= 0) {
+		mNotifier = new QSocketNotifier(mInotifyFd, QSocketNotifier::Read, this);
+		connect(mNotifier, SIGNAL(activated(int)), this, SLOT(readEvents()));
+	}
+	else
+		qWarning() << "[DkDirWatcher] could not initialize inotify";
+#endif
+}
+
+DkDirWatcher::~DkDirWatcher() {
+
+#ifdef Q_OS_LINUX
+	if (mInotifyFd >= 0)
+		close(mInotifyFd);
+#endif
+}
+
+/**
+ * Returns the singleton. Call it from the GUI thread first.
+ **/ 
+DkDirWatcher& DkDirWatcher::instance() {
+
+	static DkDirWatcher inst;
+	return inst;
+}
+
+/**
+ * Returns true if directories can be watched.
+ **/ 
+bool DkDirWatcher::isValid() const {
+
+	return mInotifyFd >= 0;
+}
+
+/**
+ * Starts watching a directory.
+ * Call unwatch() once for every successful call.
+ * @param dirPath the directory.
+ * @return bool false if the directory cannot be watched.
+ **/ 
+bool DkDirWatcher::watch(const QString& dirPath) {
+
+	if (dirPath.isEmpty() || !isValid())
+		return false;
+
+	if (mDirCount.contains(dirPath)) {
+		mDirCount[dirPath]++;
+		return true;
+	}
+
+#ifdef Q_OS_LINUX
+	// the union of what our listeners need
+	int wd = inotify_add_watch(mInotifyFd, QFile::encodeName(dirPath).constData(), 
+		IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+
+	if (wd >= 0) {
+		mWatchDirs.insert(wd, dirPath);
+		mDirCount.insert(dirPath, 1);
+		return true;
+	}
+#endif
+
+	return false;
+}
+
+void DkDirWatcher::unwatch(const QString& dirPath) {
+
+	if (!mDirCount.contains(dirPath) || --mDirCount[dirPath] > 0)
+		return;
+
+	mDirCount.remove(dirPath);
+
+#ifdef Q_OS_LINUX
+	int wd = mWatchDirs.key(dirPath, -1);
+
+	if (wd >= 0) {
+		inotify_rm_watch(mInotifyFd, wd);
+		mWatchDirs.remove(wd);
+	}
+#endif
+}
+
+void DkDirWatcher::readEvents() {
+
+#ifdef Q_OS_LINUX
+	alignas(struct inotify_event) char buffer[16384];
+	QVector<Event> events;
+	ssize_t len;
+
+	while ((len = read(mInotifyFd, buffer, sizeof(buffer))) > 0) {
+
+		for (char* ptr = buffer; ptr < buffer + len; ) {
+
+			const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+			ptr += sizeof(struct inotify_event) + event->len;
+
+			Event e;
+			e.mask = event->mask;
+
+			if (!(event->mask & IN_Q_OVERFLOW)) {
+
+				e.dirPath = mWatchDirs.value(event->wd);
+
+				// e.g. IN_IGNORED of removed watches
+				if (e.dirPath.isEmpty())
+					continue;
+
+				if (event->len)
+					e.fileName = QFile::decodeName(event->name);
+			}
+
+			events << e;
+		}
+	}
+
+	if (!events.empty())
+		emit eventsRead(events);
+#endif
+}
+
+// DkFileWatcher --------------------------------------------------------------------
+DkFileWatcher::DkFileWatcher() {
+
+	mPollTimer.setInterval(1000);
+	connect(&mPollTimer, SIGNAL(timeout()), this, SLOT(poll()));
+	connect(&DkDirWatcher::instance(), &DkDirWatcher::eventsRead, this, &DkFileWatcher::readEvents);
+
+	if (!DkDirWatcher::instance().isValid())
+		qWarning() << "[DkFileWatcher] could not initialize inotify - polling files";
+}
+
+DkFileWatcher::~DkFileWatcher() {
+}
+
+DkFileWatcher& DkFileWatcher::instance() {
+
+	static DkFileWatcher inst;
+	return inst;
+}
+
+/**
+ * Starts watching the container's file.
+ * If the container is watched already, its file path is updated.
+ * @param imgC the image container.
+ **/ 
+void DkFileWatcher::watch(DkImageContainerT* imgC) {
+
+	if (!imgC)
+		return;
+
+	unwatch(imgC);
+
+	QString filePath = imgC->filePath();
+
+#ifdef WITH_QUAZIP
+	// we watch the archive
+	if (imgC->isFromZip())
+		filePath = imgC->getZipData()->getZipFilePath();
+#endif
+
+	if (filePath.isEmpty())
+		return;
+
+	mWatched.insert(imgC, filePath);
+	mContainers.insert(filePath, imgC);
+
+	QString dirPath = QFileInfo(filePath).absolutePath();
+
+	if (DkDirWatcher::instance().isValid() && supportsNotifications(dirPath)) {
+
+		if (mDirCount[dirPath]++ == 0) {
+
+			if (DkDirWatcher::instance().watch(dirPath))
+				return;
+
+			mDirCount.remove(dirPath);
+			qWarning() << "[DkFileWatcher] could not watch" << dirPath << "- polling it";
+		}
+		else
+			return;
+	}
+
+	mPolled << imgC;
+
+	if (!mPollTimer.isActive())
+		mPollTimer.start();
+}
+
+void DkFileWatcher::unwatch(DkImageContainerT* imgC) {
+
+	if (!mWatched.contains(imgC))
+		return;
+
+	QString filePath = mWatched.take(imgC);
+	mContainers.remove(filePath, imgC);
+
+	if (mPolled.removeAll(imgC) > 0) {
+
+		if (mPolled.empty())
+			mPollTimer.stop();
+		return;
+	}
+
+	QString dirPath = QFileInfo(filePath).absolutePath();
+
+	if (mDirCount.contains(dirPath) && --mDirCount[dirPath] == 0) {
+		mDirCount.remove(dirPath);
+		DkDirWatcher::instance().unwatch(dirPath);
+	}
+}
+
+bool DkFileWatcher::isWatched(DkImageContainerT* imgC) const {
+
+	return mWatched.contains(imgC);
+}
+
+/**
+ * Returns false for network file systems.
+ * inotify does not see changes that are done by other clients there.
+ **/ 
+bool DkFileWatcher::supportsNotifications(const QString& dirPath) const {
+
+#ifdef Q_OS_LINUX
+	struct statfs sfs;
+
+	if (statfs(QFile::encodeName(dirPath).constData(), &sfs) != 0)
+		return false;
+
+	switch ((quint32)sfs.f_type) {
+	case 0x6969:		// NFS
+	case 0x517B:		// SMB
+	case 0xFF534D42:	// CIFS
+	case 0xFE534D42:	// SMB2
+	case 0x65735546:	// FUSE (e.g. sshfs)
+		return false;
+	}
+
+	return true;
+#else
+	Q_UNUSED(dirPath);
+	return false;
+#endif
+}
+
+void DkFileWatcher::readEvents(const QVector<DkDirWatcher::Event>& events) {
+
+#ifdef Q_OS_LINUX
+	QStringList changedFiles;
+
+	for (const DkDirWatcher::Event& e : events) {
+
+		// we lost events - check all files
+		if (e.mask & IN_Q_OVERFLOW) {
+			changedFiles << mContainers.uniqueKeys();
+			continue;
+		}
+
+		// not ours (e.g. the directory index)
+		if (!mDirCount.contains(e.dirPath) || e.fileName.isEmpty())
+			continue;
+
+		QString filePath = QFileInfo(QDir(e.dirPath), e.fileName).absoluteFilePath();
+
+		if (mContainers.contains(filePath) && !changedFiles.contains(filePath))
+			changedFiles << filePath;
+	}
+
+	for (const QString& filePath : changedFiles)
+		notify(filePath);
+#else
+	Q_UNUSED(events);
+#endif
+}
+
+/**
+ * Lets all polled containers check their files.
+ **/ 
+void DkFileWatcher::poll() {
+
+	// containers might unwatch themselves
+	QList<DkImageContainerT*> polled = mPolled;
+
+	for (DkImageContainerT* imgC : polled) {
+		if (mPolled.contains(imgC))
+			imgC->checkForFileUpdates();
+	}
+}
+
+void DkFileWatcher::notify(const QString& filePath) {
+
+	QList<DkImageContainerT*> containers = mContainers.values(filePath);
+
+	for (DkImageContainerT* imgC : containers) {
+		if (mWatched.contains(imgC))
+			imgC->checkForFileUpdates();
+	}
+}
+
+}
@@ -0,0 +1,140 @@
+/*******************************************************************************************************
+ DkFileWatcher.h
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QObject>
+#include <QHash>
+#include <QMultiHash>
+#include <QTimer>
+#include <QVector>
+#pragma warning(pop)		// no warnings from includes - end
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+class QSocketNotifier;
+
+namespace nmc {
+
+// nomacs defines
+class DkImageContainerT;
+
+/**
+ * Process-wide directory notification service (inotify on Linux).
+ * All watchers share a single inotify instance. Watches are reference
+ * counted, so the directory index (DkDirIndexManager) and the file
+ * watcher (DkFileWatcher) can observe the same directory. Every
+ * listener gets all events and picks the directories it watches.
+ **/ 
+class DllCoreExport DkDirWatcher : public QObject {
+	Q_OBJECT
+
+public:
+	struct Event {
+		QString dirPath;	// empty if events were lost (the kernel queue overflowed)
+		QString fileName;	// empty for events of the directory itself
+		quint32 mask = 0;	// inotify event mask
+	};
+
+	static DkDirWatcher& instance();
+	~DkDirWatcher();
+
+	// singleton
+	DkDirWatcher(DkDirWatcher const&)		= delete;
+	void operator=(DkDirWatcher const&)		= delete;
+
+	bool isValid() const;
+	bool watch(const QString& dirPath);
+	void unwatch(const QString& dirPath);
+
+signals:
+	void eventsRead(const QVector<DkDirWatcher::Event>& events) const;
+
+protected slots:
+	void readEvents();
+
+protected:
+	DkDirWatcher();
+
+	int mInotifyFd = -1;
+	QSocketNotifier* mNotifier = 0;
+	QHash<int, QString> mWatchDirs;		// watch descriptor -> directory
+	QHash<QString, int> mDirCount;		// directory -> number of watches
+};
+
+/**
+ * Process-wide file change service for image containers.
+ * On Linux, the parent directories of watched files are observed
+ * with DkDirWatcher and changes are dispatched to the affected containers
+ * (DkImageContainerT::checkForFileUpdates). Files on file systems that
+ * do not report changes (e.g. NFS, SMB) and files on other platforms
+ * are polled with a single timer.
+ **/ 
+class DllCoreExport DkFileWatcher : public QObject {
+	Q_OBJECT
+
+public:
+	static DkFileWatcher& instance();
+	~DkFileWatcher();
+
+	// singleton
+	DkFileWatcher(DkFileWatcher const&)		= delete;
+	void operator=(DkFileWatcher const&)	= delete;
+
+	void watch(DkImageContainerT* imgC);
+	void unwatch(DkImageContainerT* imgC);
+	bool isWatched(DkImageContainerT* imgC) const;
+
+protected slots:
+	void readEvents(const QVector<DkDirWatcher::Event>& events);
+	void poll();
+
+protected:
+	DkFileWatcher();
+
+	bool supportsNotifications(const QString& dirPath) const;
+	void notify(const QString& filePath);
+
+	QHash<DkImageContainerT*, QString> mWatched;		// container -> watched file
+	QMultiHash<QString, DkImageContainerT*> mContainers;	// watched file -> containers
+	QList<DkImageContainerT*> mPolled;
+	QTimer mPollTimer;
+
+	QHash<QString, int> mDirCount;		// directory -> number of watched files
+};
+
+};
@@ -0,0 +1,267 @@
+/*******************************************************************************************************
+ DkFormatRegistry.cpp
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkFormatRegistry.h"
+
+#include "DkBasicLoader.h"
+#include "DkUtils.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QMutexLocker>
+#include <QDebug>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace nmc {
+
+// DkImageFormat --------------------------------------------------------------------
+DkImageFormat::DkImageFormat(const QString& name, int loader, const QByteArray& qtFormat) {
+
+	mName = name;
+	mLoader = loader;
+	mQtFormat = qtFormat;
+}
+
+void DkImageFormat::addMagic(const QByteArray& magic, int offset) {
+
+	mMagic << QPair<int, QByteArray>(offset, magic);
+}
+
+bool DkImageFormat::matches(const QByteArray& header) const {
+
+	if (mMagic.isEmpty())
+		return false;
+
+	for (const QPair<int, QByteArray>& m : mMagic) {
+
+		if (header.size() < m.first + m.second.size() || 
+			header.mid(m.first, m.second.size()) != m.second)
+			return false;
+	}
+
+	return true;
+}
+
+bool DkImageFormat::isValid() const {
+	return mLoader != DkBasicLoader::no_loader;
+}
+
+QString DkImageFormat::name() const {
+	return mName;
+}
+
+int DkImageFormat::loader() const {
+	return mLoader;
+}
+
+QByteArray DkImageFormat::qtFormat() const {
+	return mQtFormat;
+}
+
+// DkFormatRegistry --------------------------------------------------------------------
+DkFormatRegistry::DkFormatRegistry() {
+
+	struct Magic {
+		const char* name;
+		int loader;
+		const char* qtFormat;
+		const char* magic;
+		int magicSize;
+		int offset;
+	};
+
+	// raw formats that are not tiff based first
+	const Magic magics[] = {
+		{"jpg",		DkBasicLoader::qt_loader,	"jpg",	"\xFF\xD8\xFF",			3, 0},
+		{"png",		DkBasicLoader::qt_loader,	"png",	"\x89PNG\r\n\x1A\n",	8, 0},
+		{"gif",		DkBasicLoader::qt_loader,	"gif",	"GIF8",					4, 0},
+		{"bmp",		DkBasicLoader::qt_loader,	"bmp",	"BM",					2, 0},
+		{"webp",	DkBasicLoader::qt_loader,	"webp",	"WEBP",					4, 8},
+		{"jp2",		DkBasicLoader::qt_loader,	"jp2",	"\0\0\0\x0CjP  ",		8, 0},
+		{"icns",	DkBasicLoader::qt_loader,	"icns",	"icns",					4, 0},
+		{"dds",		DkBasicLoader::qt_loader,	"dds",	"DDS ",					4, 0},
+		{"heic",	DkBasicLoader::qt_loader,	"heic",	"ftypheic",				8, 4},
+		{"avif",	DkBasicLoader::qt_loader,	"avif",	"ftypavif",				8, 4},
+		{"psd",		DkBasicLoader::psd_loader,	"",		"8BPS",					4, 0},
+		{"crw",		DkBasicLoader::raw_loader,	"",		"HEAPCCDR",				8, 6},
+		{"cr3",		DkBasicLoader::raw_loader,	"",		"ftypcrx ",				8, 4},
+		{"raf",		DkBasicLoader::raw_loader,	"",		"FUJIFILMCCD-RAW",		15, 0},
+		{"orf",		DkBasicLoader::raw_loader,	"",		"IIRO",					4, 0},
+		{"orf",		DkBasicLoader::raw_loader,	"",		"IIRS",					4, 0},
+		{"orf",		DkBasicLoader::raw_loader,	"",		"MMOR",					4, 0},
+		{"rw2",		DkBasicLoader::raw_loader,	"",		"IIU\0",				4, 0},
+		{"x3f",		DkBasicLoader::raw_loader,	"",		"FOVb",					4, 0},
+		{"mrw",		DkBasicLoader::raw_loader,	"",		"\0MRM",				4, 0},
+		{"tif",		DkBasicLoader::qt_loader,	"tif",	"II*\0",				4, 0},
+		{"tif",		DkBasicLoader::qt_loader,	"tif",	"MM\0*",				4, 0},
+	};
+
+	for (const Magic& m : magics) {
+		DkImageFormat f(m.name, m.loader, m.qtFormat);
+		f.addMagic(QByteArray(m.magic, m.magicSize), m.offset);
+		mFormats << f;
+	}
+
+	// cr2 is tiff based - but marks itself
+	DkImageFormat cr2("cr2", DkBasicLoader::raw_loader);
+	cr2.addMagic(QByteArray("II*\0", 4));
+	cr2.addMagic(QByteArray("CR\x02", 3), 8);
+	mFormats.prepend(cr2);
+
+	for (const QByteArray& qf : QImageReader::supportedImageFormats())
+		mQtFormats.insert(qf);
+}
+
+DkFormatRegistry& DkFormatRegistry::instance() {
+
+	static DkFormatRegistry inst;
+	return inst;
+}
+
+/**
+ * Registers a format - it is matched before the built-in formats.
+ * @param format the image format
+ **/ 
+void DkFormatRegistry::registerFormat(const DkImageFormat& format) {
+
+	QWriteLocker locker(&mFormatLock);
+	mFormats.prepend(format);
+}
+
+/**
+ * Detects the image format.
+ * Many RAW formats (nef, dng, arw...) are tiff files - so a tiff header
+ * is decoded with the RAW loader if Qt does not know the suffix.
+ * @param header the first bytes of the file (see readHeader)
+ * @param suffix the file's suffix (lower case)
+ * @return DkImageFormat the format or an invalid format if the header is unknown
+ **/ 
+DkImageFormat DkFormatRegistry::detect(const QByteArray& header, const QString& suffix) const {
+
+	DkImageFormat format;
+
+	{
+		QReadLocker locker(&mFormatLock);
+
+		for (const DkImageFormat& f : mFormats) {
+
+			if (f.matches(header)) {
+				format = f;
+				break;
+			}
+		}
+	}
+
+	if (format.name() == "tif" && !suffix.isEmpty() && !isQtFormat(suffix.toLatin1()))
+		format = DkImageFormat("tiff raw", DkBasicLoader::raw_loader);
+
+	return format;
+}
+
+/**
+ * Returns the first headerSize bytes of a file.
+ * @param filePath the file's path (used if ba is empty)
+ * @param ba the file buffer
+ * @return QByteArray the header
+ **/ 
+QByteArray DkFormatRegistry::readHeader(const QString& filePath, const QSharedPointer<QByteArray> ba) {
+
+	if (ba && !ba->isEmpty())
+		return QByteArray(ba->constData(), qMin(ba->size(), (int)headerSize));
+
+	QFile file(filePath);
+
+	if (!file.open(QIODevice::ReadOnly))
+		return QByteArray();
+
+	return file.read(headerSize);
+}
+
+/**
+ * Returns true if Qt can read the format.
+ * The formats are cached - Qt lists its plugins on every call.
+ * @param format the format (e.g. suffix) in lower case
+ **/ 
+bool DkFormatRegistry::isQtFormat(const QByteArray& format) const {
+
+	return mQtFormats.contains(format);
+}
+
+/**
+ * Counts a decode.
+ * @param format the detected format (empty if unknown)
+ * @param loaded true if the image was loaded
+ * @param misdetected true if the image was loaded by another decoder than the detected
+ * @param ms the decode time
+ **/ 
+void DkFormatRegistry::addTiming(const QString& format, bool loaded, bool misdetected, int ms) {
+
+	QMutexLocker locker(&mTimingMutex);
+
+	Timing& t = mTimings[format.isEmpty() ? "unknown" : format];
+	t.loads++;
+	t.ms += ms;
+
+	if (!loaded)
+		t.failed++;
+	if (misdetected)
+		t.misdetected++;
+}
+
+void DkFormatRegistry::clearTimings() {
+
+	QMutexLocker locker(&mTimingMutex);
+	mTimings.clear();
+}
+
+QString DkFormatRegistry::report() const {
+
+	QMutexLocker locker(&mTimingMutex);
+
+	QStringList keys = mTimings.keys();
+	keys.sort();
+
+	QStringList lines;
+	for (const QString& key : keys) {
+		Timing t = mTimings.value(key);
+		lines << QString("%1: %2 loaded in %3 ms (mean %4 ms), %5 failed, %6 misdetected")
+			.arg(key)
+			.arg(t.loads)
+			.arg(t.ms)
+			.arg((double)t.ms / qMax(t.loads, 1), 0, 'f', 1)
+			.arg(t.failed)
+			.arg(t.misdetected);
+	}
+
+	return lines.join("\n");
+}
+
+};
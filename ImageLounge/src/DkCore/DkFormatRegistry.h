@@ -0,0 +1,123 @@
+/*******************************************************************************************************
+ DkFormatRegistry.h
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QReadWriteLock>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+#pragma warning(pop)		// no warnings from includes - end
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+namespace nmc {
+
+/**
+ * An image format that can be identified by its header.
+ * A format matches if all of its magic bytes are found.
+ **/ 
+class DllCoreExport DkImageFormat {
+
+public:
+	DkImageFormat(const QString& name = QString(), int loader = 0, const QByteArray& qtFormat = QByteArray());
+
+	void addMagic(const QByteArray& magic, int offset = 0);
+	bool matches(const QByteArray& header) const;
+
+	bool isValid() const;
+	QString name() const;
+	int loader() const;
+	QByteArray qtFormat() const;
+
+protected:
+	QString mName;
+	int mLoader = 0;				// DkBasicLoader::loaderID
+	QByteArray mQtFormat;			// the QImageReader format (qt_loader only)
+	QVector<QPair<int, QByteArray> > mMagic;
+};
+
+/**
+ * Identifies image formats by their magic bytes.
+ * DkBasicLoader dispatches files to the decoder that matches
+ * the header - rather than trying all decoders. Decode times
+ * are counted per format, hence slow fallbacks and files that
+ * were detected wrongly show up in report().
+ **/ 
+class DllCoreExport DkFormatRegistry {
+
+public:
+	static DkFormatRegistry& instance();
+
+	// singleton
+	DkFormatRegistry(DkFormatRegistry const&)		= delete;
+	void operator=(DkFormatRegistry const&)			= delete;
+
+	void registerFormat(const DkImageFormat& format);
+	DkImageFormat detect(const QByteArray& header, const QString& suffix) const;
+	static QByteArray readHeader(const QString& filePath, const QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+	bool isQtFormat(const QByteArray& format) const;
+
+	void addTiming(const QString& format, bool loaded, bool misdetected, int ms);
+	void clearTimings();
+	QString report() const;
+
+	static const int headerSize = 64;
+
+private:
+	DkFormatRegistry();
+
+	struct Timing {
+		int loads = 0;
+		int failed = 0;
+		int misdetected = 0;	// another decoder had to load the file
+		qint64 ms = 0;
+	};
+
+	mutable QReadWriteLock mFormatLock;
+	QVector<DkImageFormat> mFormats;
+	QSet<QByteArray> mQtFormats;		// QImageReader::supportedImageFormats() - it queries all plugins
+
+	mutable QMutex mTimingMutex;
+	QHash<QString, Timing> mTimings;
+};
+
+};
@@ -0,0 +1,306 @@
+/*******************************************************************************************************
+ DkImageCache.cpp
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkImageCache.h"
+
+#include "DkImageContainer.h"
+#include "DkSettings.h"
+#include "DkUtils.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QMutexLocker>
+#include <QVector>
+#include <QDebug>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace nmc {
+
+// DkImageCache --------------------------------------------------------------------
+DkImageCache::DkImageCache() {
+}
+
+DkImageCache& DkImageCache::instance() {
+
+	static DkImageCache inst;
+	return inst;
+}
+
+/**
+ * Updates the memory usage of a container and marks it as most recently used.
+ * Call this function whenever the container loads or releases data.
+ * If the budget is exceeded, the least recently used containers are released.
+ * @param imgC the image container.
+ **/ 
+void DkImageCache::update(DkImageContainer* imgC) {
+
+	if (!imgC)
+		return;
+
+	double memSize = imgC->getMemoryUsage();
+
+	{
+		QMutexLocker locker(&mMutex);
+
+		if (memSize <= 0) {
+			removeIntern(imgC);
+			return;
+		}
+
+		auto eIt = mEntries.find(imgC);
+
+		if (eIt == mEntries.end()) {
+			mLru.push_front(imgC);
+
+			Entry e;
+			e.lruIt = mLru.begin();
+			e.ref = imgC->sharedFromThis();
+			e.size = memSize;
+			mEntries.insert(imgC, e);
+			mUsed += memSize;
+		}
+		else {
+			mUsed += memSize - eIt->size;
+			eIt->size = memSize;
+			mLru.splice(mLru.begin(), mLru, eIt->lruIt);
+		}
+	}
+
+	shrink();
+}
+
+/**
+ * Marks the container as most recently used.
+ * @param imgC the image container.
+ **/ 
+void DkImageCache::touch(DkImageContainer* imgC) {
+
+	QMutexLocker locker(&mMutex);
+
+	auto eIt = mEntries.find(imgC);
+
+	if (eIt != mEntries.end())
+		mLru.splice(mLru.begin(), mLru, eIt->lruIt);
+}
+
+/**
+ * Removes a container from the cache without releasing it.
+ * @param imgC the image container.
+ **/ 
+void DkImageCache::remove(DkImageContainer* imgC) {
+
+	QMutexLocker locker(&mMutex);
+	removeIntern(imgC);
+
+	for (auto cIt = mCurrent.begin(); cIt != mCurrent.end();) {
+		if (cIt.value() == imgC)
+			cIt = mCurrent.erase(cIt);
+		else
+			++cIt;
+	}
+}
+
+/**
+ * Sets the image a loader currently displays.
+ * Every loader (e.g. each tab) pins its own current image,
+ * which is never released by the cache.
+ * @param loader the loader that displays imgC.
+ * @param imgC the current image container (0 unpins the loader's image).
+ **/ 
+void DkImageCache::setCurrent(const DkImageLoader* loader, DkImageContainer* imgC) {
+
+	{
+		QMutexLocker locker(&mMutex);
+
+		if (imgC)
+			mCurrent.insert(loader, imgC);
+		else
+			mCurrent.remove(loader);
+	}
+
+	touch(imgC);
+	shrink();
+}
+
+/**
+ * Releases the least recently used containers until we are within budget.
+ **/ 
+void DkImageCache::shrink() {
+
+	QVector<QSharedPointer<DkImageContainer> > victims;
+
+	{
+		QMutexLocker locker(&mMutex);
+		double maxMem = budgetIntern();
+
+		auto lIt = mLru.end();
+		while (mUsed > maxMem && lIt != mLru.begin()) {
+
+			--lIt;
+
+			if (isPinnedIntern(*lIt))
+				continue;
+
+			// the container is being deleted (it removes itself)
+			QSharedPointer<DkImageContainer> imgC = mEntries.value(*lIt).ref.toStrongRef();
+
+			if (!imgC)
+				continue;
+
+			mUsed -= mEntries.value(*lIt).size;
+			mEntries.remove(*lIt);
+			lIt = mLru.erase(lIt);
+			victims << imgC;
+		}
+	}
+
+	// release outside the lock - clear() calls update()
+	for (QSharedPointer<DkImageContainer> imgC : victims)
+		imgC->clear();
+
+	if (!victims.empty())
+		qDebug() << "[DkImageCache]" << victims.size() << "images released, using" << mUsed << "MB";
+}
+
+/**
+ * Releases all cached containers (except for current and edited ones).
+ **/ 
+void DkImageCache::clear() {
+
+	QVector<QSharedPointer<DkImageContainer> > victims;
+
+	{
+		QMutexLocker locker(&mMutex);
+
+		for (DkImageContainer* imgC : mLru) {
+
+			QSharedPointer<DkImageContainer> ref = mEntries.value(imgC).ref.toStrongRef();
+
+			if (ref && !isPinnedIntern(imgC))
+				victims << ref;
+		}
+
+		for (QSharedPointer<DkImageContainer> imgC : victims)
+			removeIntern(imgC.data());
+	}
+
+	for (QSharedPointer<DkImageContainer> imgC : victims)
+		imgC->clear();
+}
+
+bool DkImageCache::contains(DkImageContainer* imgC) const {
+
+	QMutexLocker locker(&mMutex);
+	return mEntries.contains(imgC);
+}
+
+int DkImageCache::size() const {
+
+	QMutexLocker locker(&mMutex);
+	return mEntries.size();
+}
+
+/**
+ * Returns the memory used by all cached containers in MB.
+ **/ 
+double DkImageCache::usedMemory() const {
+
+	QMutexLocker locker(&mMutex);
+	return mUsed;
+}
+
+/**
+ * Returns the cache budget in MB.
+ * The budget is reduced if the system runs low on memory.
+ **/ 
+double DkImageCache::budget() const {
+
+	QMutexLocker locker(&mMutex);
+	return budgetIntern();
+}
+
+bool DkImageCache::isFull(double additionalMemory) const {
+
+	QMutexLocker locker(&mMutex);
+	return mUsed + additionalMemory >= budgetIntern();
+}
+
+double DkImageCache::budgetIntern() const {
+
+	double maxMem = DkSettingsManager::param().resources().cacheMemory;
+
+	// asking the system is cheap - but not that cheap
+	if (!mPressureTimer.isValid() || mPressureTimer.elapsed() > 500) {
+
+		mPressureTimer.restart();
+
+		double freeMem = DkMemory::getFreeMemory();
+		double minFree = qMax(256.0, DkMemory::getTotalMemory()*0.05);
+
+		// give back what the system is missing
+		if (freeMem >= 0 && freeMem < minFree)
+			mPressureLimit = qMax(0.0, mUsed - (minFree - freeMem));
+		else
+			mPressureLimit = -1.0;
+	}
+
+	if (mPressureLimit >= 0)
+		maxMem = qMin(maxMem, mPressureLimit);
+
+	return maxMem;
+}
+
+/**
+ * Returns true if the container must not be released.
+ * That is the current image of any loader and images with unsaved changes.
+ * @param imgC the image container.
+ **/ 
+bool DkImageCache::isPinnedIntern(DkImageContainer* imgC) const {
+
+	if (imgC->hasUnsavedChanges())
+		return true;
+
+	for (const DkImageContainer* c : mCurrent) {
+		if (c == imgC)
+			return true;
+	}
+
+	return false;
+}
+
+void DkImageCache::removeIntern(DkImageContainer* imgC) {
+
+	auto eIt = mEntries.find(imgC);
+
+	if (eIt == mEntries.end())
+		return;
+
+	mUsed -= eIt->size;
+	mLru.erase(eIt->lruIt);
+	mEntries.erase(eIt);
+}
+
+}
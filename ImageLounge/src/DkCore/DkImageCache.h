@@ -0,0 +1,109 @@
+/*******************************************************************************************************
+ DkImageCache.h
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+#pragma warning(pop)		// no warnings from includes - end
+
+#include <list>
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+namespace nmc {
+
+// nomacs defines
+class DkImageContainer;
+class DkImageLoader;
+
+/**
+ * Byte budgeted LRU cache for decoded images and file buffers.
+ * Image containers report their memory usage whenever they 
+ * load or release data. If the budget (resources().cacheMemory)
+ * is exceeded, the least recently used containers are released.
+ * The current image of every loader (e.g. tabs) and images with
+ * unsaved changes are never released by the cache.
+ * The budget shrinks if the system runs low on memory.
+ **/ 
+class DllCoreExport DkImageCache {
+
+public:
+	static DkImageCache& instance();
+
+	// singleton
+	DkImageCache(DkImageCache const&)		= delete;
+	void operator=(DkImageCache const&)		= delete;
+
+	void update(DkImageContainer* imgC);
+	void touch(DkImageContainer* imgC);
+	void remove(DkImageContainer* imgC);
+	void setCurrent(const DkImageLoader* loader, DkImageContainer* imgC);
+	void shrink();
+	void clear();
+
+	bool contains(DkImageContainer* imgC) const;
+	int size() const;
+	double usedMemory() const;
+	double budget() const;
+	bool isFull(double additionalMemory = 0.0) const;
+
+private:
+	DkImageCache();
+
+	struct Entry {
+		std::list<DkImageContainer*>::iterator lruIt;
+		QWeakPointer<DkImageContainer> ref;	// keeps victims alive while they are released
+		double size = 0.0;	// MB
+	};
+
+	double budgetIntern() const;
+	bool isPinnedIntern(DkImageContainer* imgC) const;
+	void removeIntern(DkImageContainer* imgC);
+
+	mutable QMutex mMutex;
+	std::list<DkImageContainer*> mLru;	// front: most recently used
+	QHash<DkImageContainer*, Entry> mEntries;
+	QHash<const DkImageLoader*, DkImageContainer*> mCurrent;	// the current image of each loader
+	double mUsed = 0.0;					// MB
+
+	mutable QElapsedTimer mPressureTimer;
+	mutable double mPressureLimit = -1.0;	// MB, -1 if there is no memory pressure
+};
+
+};
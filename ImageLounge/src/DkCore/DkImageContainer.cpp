@@ -26,6 +26,9 @@
  *******************************************************************************************************/
 
 #include "DkImageContainer.h"
+#include "DkImageCache.h"
+#include "DkFileWatcher.h"
+#include "DkThreadPools.h"
 #include "DkImageStorage.h"
 #include "DkMetaData.h"
 #include "DkThumbs.h"
@@ -38,6 +41,10 @@
 #include <QObject>
 #include <QImage>
 #include <QtConcurrentRun>
+#include <QtConcurrentMap>
+#include <QThread>
+
+#include <algorithm>
 
 // quazip
 #ifdef WITH_QUAZIP
@@ -67,6 +74,8 @@ DkImageContainer::DkImageContainer(const QString& filePath) {
 }
 
 DkImageContainer::~DkImageContainer() {
+
+	DkImageCache::instance().remove(this);
 }
 
 void DkImageContainer::init() {
@@ -115,9 +124,12 @@ void DkImageContainer::clear() {
 
 	if (mLoader)
 		mLoader->release();
-	if (mFileBuffer)
-		mFileBuffer->clear();
+	// drop our reference - the buffer is freed with the last one
+	mFileBuffer.clear();
 	init();
+
+	// drops us from the cache
+	DkImageCache::instance().update(this);
 }
 
 void DkImageContainer::undo() {
@@ -142,7 +154,7 @@ void DkImageContainer::cropImage(const DkRotatingRect & rect, const QColor & col
 		getMetaData()->clearXMPRect();
 	}
 	else
-		getMetaData()->saveRectToXMP(rect, image().size());
+		getMetaData()->saveRectToXMP(rect, imageSize());
 }
 
 QFileInfo DkImageContainer::fileInfo() const {
@@ -261,18 +273,59 @@ QSharedPointer<QByteArray> DkImageContainer::getFileBuffer() {
 
 float DkImageContainer::getMemoryUsage() const {
 
-	if (!mLoader)
-		return 0;
-
+	// the buffer counts even if nothing is decoded yet
 	float memSize = mFileBuffer ? mFileBuffer->size()/(1024.0f*1024.0f) : 0;
-	memSize += DkImage::getBufferSizeFloat(mLoader->image().size(), mLoader->image().depth());
+
+	if (mLoader)
+		memSize += DkImage::getBufferSizeFloat(mLoader->image().size(), mLoader->image().depth());
 
 	return memSize;
 }
 
+/**
+ * Returns the sort key. The file dates are captured
+ * on first use if the images are sorted by date.
+ **/ 
+const DkSortKey& DkImageContainer::sortKey() const {
+
+	int sortMode = DkSettingsManager::param().global().sortMode;
+
+	if (!mSortKey.hasDates() && (sortMode == DkSettings::sort_date_created || sortMode == DkSettings::sort_date_modified))
+		mSortKey.setDates(mFileInfo);
+
+	return mSortKey;
+}
+
+/**
+ * Re-reads the file dates (e.g. if the file was changed).
+ **/ 
+void DkImageContainer::updateSortKey() {
+
+	QFileInfo fileInfo(mFilePath);
+	mSortKey.setDates(fileInfo);
+	mFileSize = fileInfo.size();
+}
+
 float DkImageContainer::getFileSize() const {
 
-	return QFileInfo(mFilePath).size()/(1024.0f*1024.0f);
+	qint64 size = mFileSize >= 0 ? mFileSize : QFileInfo(mFilePath).size();
+
+	return size/(1024.0f*1024.0f);
+}
+
+/**
+ * Takes over the file's size and dates from a directory listing.
+ * Invalid values are ignored (they are read from disk if needed).
+ * @param size the file size in bytes or -1.
+ * @param created the creation date.
+ * @param modified the modification date.
+ **/ 
+void DkImageContainer::setFileStats(qint64 size, const QDateTime& created, const QDateTime& modified) {
+
+	mFileSize = size;
+
+	if (created.isValid() && modified.isValid())
+		mSortKey.setDates(created.toMSecsSinceEpoch(), modified.toMSecsSinceEpoch());
 }
 
 DkRotatingRect DkImageContainer::cropRect() {
@@ -280,7 +333,7 @@ DkRotatingRect DkImageContainer::cropRect() {
 	QSharedPointer<DkMetaDataT> metaData = getMetaData();
 
 	if (metaData) {
-		return metaData->getXMPRect(image().size());
+		return metaData->getXMPRect(imageSize());
 	}
 	else
 		qWarning() << "empty crop rect because there are no metadata...";
@@ -289,14 +342,70 @@ DkRotatingRect DkImageContainer::cropRect() {
 }
 
 
+/**
+ * Returns the image with all its pixels.
+ * Images that were decoded for display (see setDisplaySize) are
+ * not decoded again - this would block the calling thread. Check
+ * isDownscaled() and load them with DkImageContainerT::loadFullImageThreaded
+ * (or DkViewPort::runWithFullImage) before editing or saving.
+ * @return QImage the image
+ **/ 
 QImage DkImageContainer::image() {
 
+	if (getLoader()->image().isNull() && getLoadState() == not_loaded)
+		loadImage(QSize());
+
+	if (isDownscaled())
+		qWarning() << "[DkImageContainer]" << fileName() << "is decoded for display - image() does not have all pixels";
+
+	return mLoader->image();
+}
+
+/**
+ * Returns the image for display.
+ * This might be smaller than the original (see setDisplaySize).
+ * Never edit or save this image - use image() instead.
+ * @return QImage the (downscaled) image
+ **/ 
+QImage DkImageContainer::displayImage() {
+
 	if (getLoader()->image().isNull() && getLoadState() == not_loaded)
 		loadImage();
 
 	return mLoader->image();
 }
 
+bool DkImageContainer::isDownscaled() const {
+
+	return mLoader && mLoader->isDownscaled();
+}
+
+/**
+ * Returns the size of the full resolution image.
+ * It does not decode the image if it was decoded for display.
+ * @return QSize the image size
+ **/ 
+QSize DkImageContainer::imageSize() {
+
+	return getLoader()->originalSize();
+}
+
+/**
+ * Sets the size this image is displayed at.
+ * Formats that support it are then decoded at the smallest scale
+ * that covers this size. Set an invalid size to decode all pixels.
+ * @param size the display size in device pixels
+ **/ 
+void DkImageContainer::setDisplaySize(const QSize& size) {
+
+	mDisplaySize = size;
+}
+
+QSize DkImageContainer::displaySize() const {
+
+	return mDisplaySize;
+}
+
 QImage DkImageContainer::imageScaledToHeight(int height) {
 
 	// check cash first
@@ -305,8 +414,11 @@ QImage DkImageContainer::imageScaledToHeight(int height) {
 			return img;
 	}
 
+	// the display decode covers the viewport - that is good enough for previews
+	QImage img = displayImage();
+
 	// cache it
-	QImage sImg = image().scaledToHeight(height, Qt::SmoothTransformation);
+	QImage sImg = img.scaledToHeight(height, Qt::SmoothTransformation);
 	scaledImages << sImg;
 
 	// clean up
@@ -324,8 +436,11 @@ QImage DkImageContainer::imageScaledToWidth(int width) {
 			return img;
 	}
 
+	// the display decode covers the viewport - that is good enough for previews
+	QImage img = displayImage();
+
 	// cache it
-	QImage sImg = image().scaledToWidth(width, Qt::SmoothTransformation);
+	QImage sImg = img.scaledToWidth(width, Qt::SmoothTransformation);
 	scaledImages << sImg;
 
 	// clean up
@@ -353,6 +468,8 @@ void DkImageContainer::setFilePath(const QString& filePath) {
 
 	mFilePath = filePath;
 	mFileInfo = filePath;
+	mSortKey = DkSortKey(mFileInfo.fileName());
+	mFileSize = -1;
 
 #ifdef Q_OS_WIN
 #if QT_VERSION < 0x050000
@@ -379,19 +496,25 @@ int DkImageContainer::getLoadState() const {
 
 bool DkImageContainer::loadImage() {
 
+	return loadImage(mDisplaySize);
+}
+
+bool DkImageContainer::loadImage(const QSize& displaySize) {
+
 	if (!QFileInfo(mFileInfo).exists())
 		return false;
 
 	if (getFileBuffer()->isEmpty())
 		mFileBuffer = loadFileToBuffer(mFilePath);
 
+	getLoader()->setDisplaySize(displaySize);
 	mLoader = loadImageIntern(mFilePath, getLoader(), mFileBuffer);
 
 	return mLoader->hasImage();
 }
 
 bool DkImageContainer::saveImage(const QString& filePath, int compression /* = -1 */) {
-	return saveImage(filePath, getLoader()->image(), compression);
+	return saveImage(filePath, image(), compression);
 }
 
 bool DkImageContainer::saveImage(const QString& filePath, const QImage saveImg, int compression /* = -1 */) {
@@ -404,7 +527,13 @@ bool DkImageContainer::saveImage(const QString& filePath, const QImage saveImg,
 	return saveFile.exists() && saveFile.isFile();
 }
 
-QSharedPointer<QByteArray> DkImageContainer::loadFileToBuffer(const QString& filePath) {
+/**
+ * Loads the file to a buffer.
+ * @param filePath the file's path
+ * @param token reading stops if the token is canceled
+ * @return QSharedPointer<QByteArray> the file buffer
+ **/ 
+QSharedPointer<QByteArray> DkImageContainer::loadFileToBuffer(const QString& filePath, QSharedPointer<DkCancelToken> token) {
 
 	QFileInfo fInfo = filePath;
 
@@ -420,20 +549,14 @@ QSharedPointer<QByteArray> DkImageContainer::loadFileToBuffer(const QString& fil
 		return QSharedPointer<QByteArray>(new QByteArray());
 	}
 
-	QFile file(fInfo.absoluteFilePath());
-	file.open(QIODevice::ReadOnly);
-
-	QSharedPointer<QByteArray> ba(new QByteArray(file.readAll()));
-	file.close();
-
-	return ba;
+	return DkFileBuffer::load(fInfo.absoluteFilePath(), false, token);
 }
 
 
-QSharedPointer<DkBasicLoader> DkImageContainer::loadImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer) {
+QSharedPointer<DkBasicLoader> DkImageContainer::loadImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer, QSharedPointer<DkCancelToken> token) {
 
 	try {
-		loader->loadGeneral(filePath, fileBuffer, true);
+		loader->loadGeneral(filePath, fileBuffer, true, false, token);
 	} catch (...) {
 		qWarning() << "Unknown error in DkImageContainer::loadImageIntern";
 	}
@@ -468,6 +591,18 @@ bool DkImageContainer::isEdited() const {
 	return mEdited;
 }
 
+/**
+ * Returns true if releasing the image would lose changes.
+ * That is if the image is edited or its metadata are not saved yet.
+ * @return bool true if the image has unsaved changes
+ **/ 
+bool DkImageContainer::hasUnsavedChanges() const {
+
+	QSharedPointer<DkBasicLoader> loader = mLoader;
+
+	return mEdited || (loader && loader->getMetaData() && loader->getMetaData()->isDirty());
+}
+
 bool DkImageContainer::isSelected() const {
 
 	return mSelected;
@@ -511,72 +646,237 @@ bool imageContainerLessThanPtr(const QSharedPointer<DkImageContainer> l, const Q
 
 bool imageContainerLessThan(const DkImageContainer& l, const DkImageContainer& r) {
 
-	switch(DkSettingsManager::param().global().sortMode) {
+	int sortMode = DkSettingsManager::param().global().sortMode;
 
-	case DkSettings::sort_filename:
-#ifdef Q_OS_WIN
-		// not beautiful if you take a look at the code, but:
-		// time on Win8 with compFilename:
-		//		WinAPI, indexed ( 73872 ) files in:  " 92 ms"
-		//		[DkImageLoader]  73872  containers created in  " 1.825 sec"
-		//		[DkImageLoader] after sorting:  " 52.246 sec"
-		// time on Win8 with direct wCompLogic:
-		//		WinAPI, indexed ( 73872 ) files in:  " 63 ms"
-		//		[DkImageLoader]  73872  containers created in  " 1.203 sec"
-		//		[DkImageLoader] after sorting:  " 14.407 sec"
-		if (DkSettingsManager::param().global().sortDir == DkSettings::sort_ascending)
-			return DkUtils::wCompLogic(l.getFileNameWStr(), r.getFileNameWStr());
-		else
-			return !DkUtils::wCompLogic(l.getFileNameWStr(), r.getFileNameWStr());
-		break;
-#else
-		if (DkSettingsManager::param().global().sortDir == DkSettings::sort_ascending)
-			return DkUtils::compFilename(l.fileInfo(), r.fileInfo());
-		else
-			return DkUtils::compFilenameInv(l.fileInfo(), r.fileInfo());
-		break;
-#endif
+	if (DkSettingsManager::param().global().sortDir == DkSettings::sort_ascending)
+		return l.sortKey().lessThan(r.sortKey(), sortMode);
+	else
+		return r.sortKey().lessThan(l.sortKey(), sortMode);
+}
+
+/**
+ * Sorts large vectors in parallel chunks which are merged afterwards.
+ * @param items the items to be sorted.
+ * @param lessThan a strict weak ordering.
+ * @return int the number of chunks (1 if the items were sorted in this thread).
+ **/ 
+template <typename T, typename LessThan>
+static int parallelSort(QVector<T>& items, LessThan lessThan) {
+
+	int numChunks = qMin(QThread::idealThreadCount(), items.size()/10000);
+
+	if (numChunks < 2) {
+		std::sort(items.begin(), items.end(), lessThan);
+		return 1;
+	}
+
+	// detach here - the threads must not do that
+	T* data = items.data();
+
+	QVector<int> bounds;
+	for (int idx = 0; idx <= numChunks; idx++)
+		bounds << (int)((qint64)items.size() * idx / numChunks);
+
+	QVector<int> chunks;
+	for (int idx = 0; idx < numChunks; idx++)
+		chunks << idx;
+
+	QtConcurrent::blockingMap(chunks, [&](int cIdx) {
+		std::sort(data + bounds[cIdx], data + bounds[cIdx+1], lessThan);
+	});
+
+	// merge neighboring chunks until we are done
+	while (bounds.size() > 2) {
+
+		QVector<int> pairs;
+		for (int idx = 0; idx+2 < bounds.size(); idx += 2)
+			pairs << idx;
+
+		QtConcurrent::blockingMap(pairs, [&](int pIdx) {
+			std::inplace_merge(data + bounds[pIdx], data + bounds[pIdx+1], data + bounds[pIdx+2], lessThan);
+		});
+
+		QVector<int> mergedBounds;
+		for (int idx = 0; idx < bounds.size(); idx += 2)
+			mergedBounds << bounds[idx];
+
+		if (mergedBounds.last() != bounds.last())
+			mergedBounds << bounds.last();
+
+		bounds = mergedBounds;
+	}
+
+	return numChunks;
+}
+
+/**
+ * Sorts the images according to the current sort settings.
+ * Large folders are sorted in parallel chunks which are merged afterwards.
+ * @param images the images to be sorted.
+ **/ 
+void sortImageContainers(QVector<QSharedPointer<DkImageContainerT> >& images) {
+
+	DkTimer dt;
+
+	int sortMode = DkSettingsManager::param().global().sortMode;
+	bool ascending = DkSettingsManager::param().global().sortDir == DkSettings::sort_ascending;
+
+	auto lessThan = [sortMode, ascending](const QSharedPointer<DkImageContainerT>& l, const QSharedPointer<DkImageContainerT>& r) {
+		return ascending ? l->sortKey().lessThan(r->sortKey(), sortMode) : r->sortKey().lessThan(l->sortKey(), sortMode);
+	};
+
+	// capture the file dates (stat calls) in parallel
+	if (sortMode == DkSettings::sort_date_created || sortMode == DkSettings::sort_date_modified) {
+		QtConcurrent::blockingMap(images, [](QSharedPointer<DkImageContainerT>& imgC) {
+			imgC->sortKey();
+		});
+	}
+
+	int numChunks = parallelSort(images, lessThan);
+
+	if (numChunks > 1)
+		qDebug() << "[DkImageContainer]" << images.size() << "images sorted in" << numChunks << "chunks in" << dt;
+}
+
+/**
+ * Sorts plain keys the way sortImageContainers sorts images (see DkBenchmark).
+ * @param keys the keys to be sorted.
+ * @param sortMode the DkSettings::sortMode.
+ * @param ascending the sort direction.
+ **/ 
+void sortKeys(QVector<DkSortKey>& keys, int sortMode, bool ascending) {
+
+	parallelSort(keys, [sortMode, ascending](const DkSortKey& l, const DkSortKey& r) {
+		return ascending ? l.lessThan(r, sortMode) : r.lessThan(l, sortMode);
+	});
+}
+
+// DkSortKey --------------------------------------------------------------------
+DkSortKey::DkSortKey(const QString& fileName) {
+
+	mFileName = fileName;
+	mNameKey = naturalKey(fileName);
+	mRandom = (quint32)qrand();
+}
+
+/**
+ * Captures the file dates.
+ * @param fileInfo the image's file info.
+ **/ 
+void DkSortKey::setDates(const QFileInfo& fileInfo) {
+
+	setDates(fileInfo.created().toMSecsSinceEpoch(), fileInfo.lastModified().toMSecsSinceEpoch());
+}
+
+/**
+ * Sets the file dates (e.g. from a directory index).
+ * @param created the creation date in ms since epoch.
+ * @param modified the modification date in ms since epoch.
+ **/ 
+void DkSortKey::setDates(qint64 created, qint64 modified) {
+
+	mCreated = created;
+	mModified = modified;
+	mHasDates = true;
+}
+
+bool DkSortKey::hasDates() const {
+	return mHasDates;
+}
+
+qint64 DkSortKey::modified() const {
+	return mModified;
+}
+
+/**
+ * Strict weak ordering of two keys.
+ * Equal criteria are ordered by the file name.
+ * @param o the other key.
+ * @param sortMode the DkSettings::sortMode.
+ * @return bool true if this key is sorted before o.
+ **/ 
+bool DkSortKey::lessThan(const DkSortKey& o, int sortMode) const {
+
+	switch (sortMode) {
 
 	case DkSettings::sort_date_created:
-		if (DkSettingsManager::param().global().sortDir == DkSettings::sort_ascending)
-			return DkUtils::compDateCreated(l.fileInfo(), r.fileInfo());
-		else
-			return DkUtils::compDateCreatedInv(l.fileInfo(), r.fileInfo());
+		if (mCreated != o.mCreated)
+			return mCreated < o.mCreated;
 		break;
 
 	case DkSettings::sort_date_modified:
-		if (DkSettingsManager::param().global().sortDir == DkSettings::sort_ascending)
-			return DkUtils::compDateModified(l.fileInfo(), r.fileInfo());
-		else
-			return DkUtils::compDateModifiedInv(l.fileInfo(), r.fileInfo());
+		if (mModified != o.mModified)
+			return mModified < o.mModified;
+		break;
 
 	case DkSettings::sort_random:
-		return DkUtils::compRandom(l.fileInfo(), r.fileInfo());
+		if (mRandom != o.mRandom)
+			return mRandom < o.mRandom;
+		break;
+	}
 
-	default:
-		// filename
-		return DkUtils::compFilename(l.fileInfo(), r.fileInfo());
+	int c = mNameKey.compare(o.mNameKey);
+
+	if (c != 0)
+		return c < 0;
+
+	return mFileName < o.mFileName;
+}
+
+/**
+ * Tokenizes a file name such that a plain string compare sorts naturally.
+ * The name is case folded and numbers are replaced by '0' + their
+ * number of digits + the digits (without leading zeros). Hence, 
+ * digits still sort before letters and img4 < img10 < img0010a.
+ * @param fileName the file name.
+ * @return QString the key.
+ **/ 
+QString DkSortKey::naturalKey(const QString& fileName) {
+
+	QString name = fileName.toCaseFolded();
+	QString key;
+	key.reserve(name.size() + 8);
+
+	for (int idx = 0; idx < name.size(); ) {
+
+		if (!name[idx].isDigit()) {
+			key += name[idx++];
+			continue;
+		}
+
+		// skip leading zeros
+		while (idx < name.size() && name[idx] == '0')
+			idx++;
+
+		int nIdx = idx;
+
+		while (idx < name.size() && name[idx].isDigit())
+			idx++;
+
+		key += QChar('0');
+		key += QChar((ushort)(idx - nIdx));
+		key += name.midRef(nIdx, idx - nIdx);
 	}
-	
+
+	return key;
 }
 
 // DkImageContainerT --------------------------------------------------------------------
 DkImageContainerT::DkImageContainerT(const QString& filePath) : DkImageContainer(filePath) {
 	
-	// our file watcher
-	mFileUpdateTimer.setSingleShot(false);
-	mFileUpdateTimer.setInterval(500);
-
-	connect(&mFileUpdateTimer, SIGNAL(timeout()), this, SLOT(checkForFileUpdates()), Qt::UniqueConnection);
 	//connect(&metaDataWatcher, SIGNAL(finished()), this, SLOT(metaDataLoaded()));
 }
 
 DkImageContainerT::~DkImageContainerT() {
 	
+	DkFileWatcher::instance().unwatch(this);
+
 	mBufferWatcher.blockSignals(true);
 	mBufferWatcher.cancel();
 	mImageWatcher.blockSignals(true);
 	mImageWatcher.cancel();
+	mFullImageWatcher.blockSignals(true);
+	mFullImageWatcher.cancel();
 
 	saveMetaData();
 
@@ -621,7 +921,7 @@ void DkImageContainerT::checkForFileUpdates() {
 #endif
 
 	if (changed) {
-		mFileUpdateTimer.stop();
+		DkFileWatcher::instance().unwatch(this);
 		if (DkSettingsManager::param().global().askToSaveDeletedFiles) {
 			mEdited = changed;
 			emit fileLoadedSignal(true);
@@ -629,9 +929,8 @@ void DkImageContainerT::checkForFileUpdates() {
 		return;
 	}
 
-	// we use our own file watcher, since the qt watcher
-	// uses locks to check for updates. this might
-	// be more accurate. however, the locks are pretty nasty
+	// we use our own file watcher (DkFileWatcher), since the qt watcher
+	// uses locks to check for updates. the locks are pretty nasty
 	// if the user e.g. wants to delete the file while watching
 	// it in nomacs
 	if (mWaitForUpdate == update_pending && mFileInfo.isReadable()) {
@@ -687,11 +986,70 @@ bool DkImageContainerT::loadImageThreaded(bool force) {
 		setFilePath(getZipData()->getImageFileName());
 #endif
 	
+	getLoader()->setDisplaySize(mDisplaySize);
 	mLoadState = loading;
 	fetchFile();
 	return true;
 }
 
+/**
+ * Loads all pixels of an image that was decoded for display.
+ * The display decode is kept until all pixels arrived - then
+ * fileLoadedSignal is emitted. If decoding fails, the display
+ * decode stays and fullImageLoadedSignal(false) is emitted.
+ * @return bool true if all pixels are being loaded
+ **/ 
+bool DkImageContainerT::loadFullImageThreaded() {
+
+	if (mFetchingFullImage)
+		return true;
+
+	if (!isDownscaled() || getLoadState() != loaded || mFetchingImage)
+		return false;
+
+	// the full decode reads the metadata from the file
+	if (getMetaData() && getMetaData()->isDirty())
+		saveMetaData();
+
+	QString path = filePath();
+	QSharedPointer<QByteArray> fileBuffer = mFileBuffer;
+	QSharedPointer<DkBasicLoader> loader(new DkBasicLoader());
+	mFetchingFullImage = true;
+
+	connect(&mFullImageWatcher, SIGNAL(finished()), this, SLOT(fullImageLoaded()), Qt::UniqueConnection);
+
+	mFullImageWatcher.setFuture(DkThreadPools::instance().run(
+		DkThreadPools::lane_current_decode,
+		[this, path, loader, fileBuffer]() { return loadImageIntern(path, loader, fileBuffer, QSharedPointer<DkCancelToken>()); }));
+
+	return true;
+}
+
+void DkImageContainerT::fullImageLoaded() {
+
+	mFetchingFullImage = false;
+	QSharedPointer<DkBasicLoader> loader = mFullImageWatcher.result();
+
+	// the image was released (or edited) meanwhile
+	if (getLoadState() != loaded || !isDownscaled()) {
+		emit fullImageLoadedSignal(false);
+		return;
+	}
+
+	if (!loader || !loader->hasImage()) {
+		emit showInfoSignal(tr("Sorry, I could not load all pixels of %1").arg(fileName()));
+		emit fullImageLoadedSignal(false);
+		return;
+	}
+
+	mLoader = loader;
+	connect(mLoader.data(), SIGNAL(errorDialogSignal(const QString&)), this, SIGNAL(errorDialogSignal(const QString&)));
+
+	DkImageCache::instance().update(this);
+	emit fileLoadedSignal(true);
+	emit fullImageLoadedSignal(true);
+}
+
 void DkImageContainerT::fetchFile() {
 	
 	if (mFetchingBuffer && getLoadState() == loading_canceled) {
@@ -711,10 +1069,23 @@ void DkImageContainerT::fetchFile() {
 	}
 
 	mFetchingBuffer = true;	// saves the threaded call
+	mCancelToken = QSharedPointer<DkCancelToken>(new DkCancelToken());
 	connect(&mBufferWatcher, SIGNAL(finished()), this, SLOT(bufferLoaded()), Qt::UniqueConnection);
 
-	mBufferWatcher.setFuture(QtConcurrent::run(this, 
-		&nmc::DkImageContainerT::loadFileToBuffer, filePath()));
+	runBufferJob();
+}
+
+void DkImageContainerT::runBufferJob() {
+
+	QString path = filePath();
+	QSharedPointer<DkCancelToken> token = mCancelToken;
+
+	// the displayed image is read before neighbours that are prefetched
+	mJobTicket = QSharedPointer<DkLaneTicket>(new DkLaneTicket());
+	mBufferWatcher.setFuture(DkThreadPools::instance().run(
+		mSelected ? DkThreadPools::lane_current_io : DkThreadPools::lane_prefetch_io,
+		[this, path, token]() { return loadFileToBuffer(path, token); }, 
+		mJobTicket));
 }
 
 void DkImageContainerT::bufferLoaded() {
@@ -723,6 +1094,16 @@ void DkImageContainerT::bufferLoaded() {
 
 	if (!mBufferWatcher.isCanceled())
 		mFileBuffer = mBufferWatcher.result();
+	else if (getLoadState() == loading) {
+		// the fetch was canceled but the image was requested again
+		fetchFile();
+		return;
+	}
+
+	if (mFileBuffer && !mFileBuffer->isEmpty()) {
+		getThumb()->setFileBuffer(mFileBuffer);
+		DkImageCache::instance().update(this);
+	}
 
 	if (getLoadState() == loading)
 		fetchImage();
@@ -750,11 +1131,43 @@ void DkImageContainerT::fetchImage() {
 	
 	qInfoClean() << "loading " << filePath();
 	mFetchingImage = true;
+	mCancelToken = QSharedPointer<DkCancelToken>(new DkCancelToken());
 
 	connect(&mImageWatcher, SIGNAL(finished()), this, SLOT(imageLoaded()), Qt::UniqueConnection);
 
-	mImageWatcher.setFuture(QtConcurrent::run(this, 
-		&nmc::DkImageContainerT::loadImageIntern, filePath(), mLoader, mFileBuffer));
+	runImageJob();
+}
+
+void DkImageContainerT::runImageJob() {
+
+	QString path = filePath();
+	QSharedPointer<DkBasicLoader> loader = mLoader;
+	QSharedPointer<QByteArray> fileBuffer = mFileBuffer;
+	QSharedPointer<DkCancelToken> token = mCancelToken;
+
+	mJobTicket = QSharedPointer<DkLaneTicket>(new DkLaneTicket());
+	mImageWatcher.setFuture(DkThreadPools::instance().run(
+		mSelected ? DkThreadPools::lane_current_decode : DkThreadPools::lane_prefetch_decode,
+		[this, path, loader, fileBuffer, token]() { return loadImageIntern(path, loader, fileBuffer, token); }, 
+		mJobTicket));
+}
+
+/**
+ * Moves a queued prefetch job to the current lanes.
+ * Prefetched images that become the current image
+ * would otherwise wait behind all other prefetch jobs.
+ **/ 
+void DkImageContainerT::promoteJob() {
+
+	// the job started already (or there is none)
+	if (!mJobTicket || !mJobTicket->claim())
+		return;
+
+	// the claimed job does not run - the watchers just see the new job
+	if (mFetchingImage)
+		runImageJob();
+	else if (mFetchingBuffer)
+		runBufferJob();
 }
 
 void DkImageContainerT::imageLoaded() {
@@ -770,6 +1183,12 @@ void DkImageContainerT::imageLoaded() {
 	// deliver image
 	mLoader = mImageWatcher.result();
 
+	// we were canceled and requested again while the thread was stopping
+	if (mCancelToken && mCancelToken->isCanceled()) {
+		fetchImage();
+		return;
+	}
+
 	loadingFinished();
 }
 
@@ -799,7 +1218,7 @@ void DkImageContainerT::loadingFinished() {
 	}
 
 	if (!getLoader()->hasImage()) {
-		mFileUpdateTimer.stop();
+		DkFileWatcher::instance().unwatch(this);
 		mEdited = false;
 		QString msg = tr("Sorry, I could not load: %1").arg(fileName());
 		emit showInfoSignal(msg);
@@ -813,9 +1232,10 @@ void DkImageContainerT::loadingFinished() {
 
 	// clear file buffer if it exceeds a certain size?! e.g. psd files
 	if (mFileBuffer && mFileBuffer->size()/(1024.0f*1024.0f) > DkSettingsManager::param().resources().cacheMemory*0.5f)
-		mFileBuffer->clear();
+		mFileBuffer.clear();
 	
 	mLoadState = loaded;
+	DkImageCache::instance().update(this);
 	emit fileLoadedSignal(true);
 	qInfoClean() << filePath() << " loaded";
 }
@@ -856,10 +1276,22 @@ void DkImageContainerT::fileDownloaded() {
 
 void DkImageContainerT::cancel() {
 
+	// prefetched files are fetched without changing the load state
+	if (mFetchingBuffer) {
+		mBufferWatcher.cancel();	// queued jobs are not started
+
+		if (mCancelToken)
+			mCancelToken->cancel();
+	}
+
 	if (mLoadState != loading)
 		return;
 
 	mLoadState = loading_canceled;
+
+	// stop the running thread - the pool is free for images that are shown
+	if (mCancelToken)
+		mCancelToken->cancel();
 }
 
 void DkImageContainerT::receiveUpdates(QObject* obj, bool connectSignals /* = true */) {
@@ -871,7 +1303,10 @@ void DkImageContainerT::receiveUpdates(QObject* obj, bool connectSignals /* = tr
 		connect(this, SIGNAL(showInfoSignal(const QString&, int, int)), obj, SIGNAL(showInfoSignal(const QString&, int, int)), Qt::UniqueConnection);
 		connect(this, SIGNAL(fileSavedSignal(const QString&, bool)), obj, SLOT(imageSaved(const QString&, bool)), Qt::UniqueConnection);
 		connect(this, SIGNAL(imageUpdatedSignal()), obj, SLOT(currentImageUpdated()), Qt::UniqueConnection);
-		mFileUpdateTimer.start();
+		DkFileWatcher::instance().watch(this);
+
+		mSelected = true;
+		promoteJob();
 	}
 	else if (!connectSignals) {
 		disconnect(this, SIGNAL(errorDialogSignal(const QString&)), obj, SLOT(errorDialog(const QString&)));
@@ -879,7 +1314,7 @@ void DkImageContainerT::receiveUpdates(QObject* obj, bool connectSignals /* = tr
 		disconnect(this, SIGNAL(showInfoSignal(const QString&, int, int)), obj, SIGNAL(showInfoSignal(const QString&, int, int)));
 		disconnect(this, SIGNAL(fileSavedSignal(const QString&, bool)), obj, SLOT(imageSaved(const QString&, bool)));
 		disconnect(this, SIGNAL(imageUpdatedSignal()), obj, SLOT(currentImageUpdated()));
-		mFileUpdateTimer.stop();
+		DkFileWatcher::instance().unwatch(this);
 	}
 
 	mSelected = connectSignals;
@@ -891,7 +1326,7 @@ void DkImageContainerT::saveMetaDataThreaded() {
 	if (!exists() || (getLoader()->getMetaData() && !getLoader()->getMetaData()->isDirty()))
 		return;
 
-	mFileUpdateTimer.stop();
+	DkFileWatcher::instance().unwatch(this);
 	QFuture<void> future = QtConcurrent::run(this, 
 		&nmc::DkImageContainerT::saveMetaDataIntern, filePath(), getLoader(), getFileBuffer());
 
@@ -899,7 +1334,13 @@ void DkImageContainerT::saveMetaDataThreaded() {
 
 bool DkImageContainerT::saveImageThreaded(const QString& filePath, int compression /* = -1 */) {
 
-	return saveImageThreaded(filePath, getLoader()->image(), compression);
+	// edited images have all pixels - others need loadFullImageThreaded() first
+	if (isDownscaled()) {
+		qWarning() << "[DkImageContainerT] not saving" << fileName() << "- it is decoded for display";
+		return false;
+	}
+
+	return saveImageThreaded(filePath, image(), compression);
 }
 
 
@@ -927,7 +1368,7 @@ bool DkImageContainerT::saveImageThreaded(const QString& filePath, const QImage
 
 	qDebug() << "attempting to save: " << filePath;
 
-	mFileUpdateTimer.stop();
+	DkFileWatcher::instance().unwatch(this);
 	connect(&mSaveImageWatcher, SIGNAL(finished()), this, SLOT(savingFinished()), Qt::UniqueConnection);
 
 	mSaveImageWatcher.setFuture(QtConcurrent::run(this, 
@@ -950,27 +1391,30 @@ void DkImageContainerT::savingFinished() {
 		//// reset thumb - loadImageThreaded should do it anyway
 		//thumb = QSharedPointer<DkThumbNailT>(new DkThumbNailT(saveFile, loader->image()));
 
-		if (mFileBuffer)
-			mFileBuffer->clear();	// do a complete clear?
+		mFileBuffer.clear();	// do a complete clear?
 		setFilePath(savePath);
 		mEdited = false;
 		mDownloaded = false;
 		if (mSelected) {
 			loadImageThreaded(true);	// force a reload
-			mFileUpdateTimer.start();
+			DkFileWatcher::instance().watch(this);
 		}
 		emit fileSavedSignal(savePath);
 	}
 }
 
-QSharedPointer<QByteArray> DkImageContainerT::loadFileToBuffer(const QString& filePath) {
+QSharedPointer<QByteArray> DkImageContainerT::loadFileToBuffer(const QString& filePath, QSharedPointer<DkCancelToken> token) {
+
+	// canceled while waiting in the thread pool
+	if (token && token->isCanceled())
+		return QSharedPointer<QByteArray>(new QByteArray());
 
-	return DkImageContainer::loadFileToBuffer(filePath);
+	return DkImageContainer::loadFileToBuffer(filePath, token);
 }
 
-QSharedPointer<DkBasicLoader> DkImageContainerT::loadImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer) {
+QSharedPointer<DkBasicLoader> DkImageContainerT::loadImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer, QSharedPointer<DkCancelToken> token) {
 
-	return DkImageContainer::loadImageIntern(filePath, loader, fileBuffer);
+	return DkImageContainer::loadImageIntern(filePath, loader, fileBuffer, token);
 }
 
 QString DkImageContainerT::saveImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, QImage saveImg, int compression) {
@@ -1010,6 +1454,11 @@ bool DkImageContainerT::isFileDownloaded() const {
 	return mDownloaded;
 }
 
+bool DkImageContainerT::isFetching() const {
+
+	return mFetchingBuffer || mFetchingImage || mFetchingFullImage;
+}
+
 void DkImageContainerT::undo() {
 	DkImageContainer::undo();
 	emit imageUpdatedSignal();
@@ -31,6 +31,7 @@
 #include <QFutureWatcher>
 #include <QTimer>
 #include <QSharedPointer>
+#include <QDateTime>
 #pragma warning(pop)		// no warnings from includes - end
 
 #pragma warning(disable: 4251)	// TODO: remove
@@ -51,12 +52,43 @@ namespace nmc {
 
 // nomacs defines
 class DkBasicLoader;
+class DkCancelToken;
+class DkLaneTicket;
 class DkMetaDataT;
 class DkZipContainer;
 class FileDownloader;
 class DkRotatingRect;
 
-class DllCoreExport DkImageContainer {
+/**
+ * Precomputed sort criteria of an image container.
+ * The file name is tokenized once into a key that sorts
+ * naturally (img4 < img10) with a plain string compare.
+ * File dates are captured once - so sorting does not stat.
+ **/ 
+class DllCoreExport DkSortKey {
+
+public:
+	DkSortKey(const QString& fileName = QString());
+
+	void setDates(const QFileInfo& fileInfo);
+	void setDates(qint64 created, qint64 modified);
+	bool hasDates() const;
+	qint64 modified() const;
+
+	bool lessThan(const DkSortKey& o, int sortMode) const;
+
+	static QString naturalKey(const QString& fileName);
+
+protected:
+	QString mNameKey;
+	QString mFileName;		// tie breaker
+	qint64 mCreated = 0;
+	qint64 mModified = 0;
+	quint32 mRandom = 0;
+	bool mHasDates = false;
+};
+
+class DllCoreExport DkImageContainer : public QEnableSharedFromThis<DkImageContainer> {
 
 public:
 	enum {
@@ -76,10 +108,15 @@ public:
 	bool operator>= (const DkImageContainer& o) const;
 
 	QImage image();
+	QImage displayImage();
 	QImage imageScaledToHeight(int height);
 	QImage imageScaledToWidth(int width);
 
 	bool hasImage() const;
+	bool isDownscaled() const;
+	QSize imageSize();
+	void setDisplaySize(const QSize& size);
+	QSize displaySize() const;
 	int getLoadState() const;
 	QFileInfo fileInfo() const;
 	QString filePath() const;
@@ -87,11 +124,15 @@ public:
 	QString fileName() const;
 	bool isFromZip();
 	bool isEdited() const;
+	bool hasUnsavedChanges() const;
 	bool isSelected() const;
 	void setEdited(bool edited);
 	QString getTitleAttribute() const;
 	float getMemoryUsage() const;
 	float getFileSize() const;
+	void setFileStats(qint64 size, const QDateTime& created, const QDateTime& modified);
+	const DkSortKey& sortKey() const;
+	void updateSortKey();
 
 	virtual QSharedPointer<DkBasicLoader> getLoader();
 	virtual QSharedPointer<DkMetaDataT> getMetaData();
@@ -107,7 +148,7 @@ public:
 	bool exists();
 	bool setPageIdx(int skipIdx);
 
-	QSharedPointer<QByteArray> loadFileToBuffer(const QString& filePath);
+	QSharedPointer<QByteArray> loadFileToBuffer(const QString& filePath, QSharedPointer<DkCancelToken> token = QSharedPointer<DkCancelToken>());
 	bool loadImage();
 	void setImage(const QImage& img, const QString& editName);
 	void setImage(const QImage& img, const QString& editName, const QString& filePath);
@@ -122,7 +163,8 @@ public:
 	DkRotatingRect cropRect();
 
 protected:
-	QSharedPointer<DkBasicLoader> loadImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer);
+	QSharedPointer<DkBasicLoader> loadImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer, QSharedPointer<DkCancelToken> token = QSharedPointer<DkCancelToken>());
+	bool loadImage(const QSize& displaySize);
 	void saveMetaDataIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, QSharedPointer<QByteArray> fileBuffer = QSharedPointer<QByteArray>());
 	QString saveImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, QImage saveImg, int compression);
 	void setFilePath(const QString& filePath);
@@ -137,6 +179,9 @@ protected:
 	bool mSelected	= false;
 
 	QFileInfo mFileInfo;
+	QSize mDisplaySize;		// images are decoded for this size (see DkBasicLoader::setDisplaySize)
+	mutable DkSortKey mSortKey;
+	qint64 mFileSize = -1;	// bytes (-1 if unknown)
 	QVector<QImage> scaledImages;
 
 #ifdef WITH_QUAZIP	
@@ -168,10 +213,12 @@ public:
 	void downloadFile(const QUrl& url);
 
 	bool loadImageThreaded(bool force = false);
+	bool loadFullImageThreaded();
 	bool saveImageThreaded(const QString& filePath, const QImage saveImg, int compression = -1);
 	bool saveImageThreaded(const QString& filePath, int compression = -1);
 	void saveMetaDataThreaded();
 	bool isFileDownloaded() const;
+	bool isFetching() const;
 
 	virtual QSharedPointer<DkBasicLoader> getLoader();
 	virtual QSharedPointer<DkThumbNailT> getThumb();
@@ -188,6 +235,7 @@ signals:
 	void errorDialogSignal(const QString& msg) const;
 	void thumbLoadedSignal(bool loaded = true) const;
 	void imageUpdatedSignal() const;
+	void fullImageLoadedSignal(bool loaded = true) const;
 
 public slots:
 	void checkForFileUpdates(); 
@@ -195,24 +243,31 @@ public slots:
 protected slots:
 	void bufferLoaded();
 	void imageLoaded();
+	void fullImageLoaded();
 	void savingFinished();
 	void loadingFinished();
 	void fileDownloaded();
 
 protected:
 	void fetchImage();
+	void runBufferJob();
+	void runImageJob();
+	void promoteJob();
 	
-	QSharedPointer<QByteArray> loadFileToBuffer(const QString& filePath);
-	QSharedPointer<DkBasicLoader> loadImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer);
+	QSharedPointer<QByteArray> loadFileToBuffer(const QString& filePath, QSharedPointer<DkCancelToken> token);
+	QSharedPointer<DkBasicLoader> loadImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer, QSharedPointer<DkCancelToken> token);
 	QString saveImageIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, QImage saveImg, int compression);
 	void saveMetaDataIntern(const QString& filePath, QSharedPointer<DkBasicLoader> loader, QSharedPointer<QByteArray> fileBuffer);
 	
 	QFutureWatcher<QSharedPointer<QByteArray> > mBufferWatcher;
 	QFutureWatcher<QSharedPointer<DkBasicLoader> > mImageWatcher;
+	QFutureWatcher<QSharedPointer<DkBasicLoader> > mFullImageWatcher;
 	QFutureWatcher<QString> mSaveImageWatcher;
 	QFutureWatcher<bool> mSaveMetaDataWatcher;
 
 	QSharedPointer<FileDownloader> mFileDownloader;
+	QSharedPointer<DkCancelToken> mCancelToken;	// token of the running buffer/image thread
+	QSharedPointer<DkLaneTicket> mJobTicket;	// lets us move a queued buffer/image job to the current lane
 
 	enum UpdateStates {
 		update_idle,
@@ -226,9 +281,11 @@ protected:
 
 	bool mFetchingImage = false;
 	bool mFetchingBuffer = false;
+	bool mFetchingFullImage = false;
 	bool mDownloaded = false;
-
-	QTimer mFileUpdateTimer;
 };
 
+void sortImageContainers(QVector<QSharedPointer<DkImageContainerT> >& images);
+void sortKeys(QVector<DkSortKey>& keys, int sortMode, bool ascending);
+
 };
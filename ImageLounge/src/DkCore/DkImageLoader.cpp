@@ -35,6 +35,9 @@
 #include "DkBasicLoader.h"
 #include "DkMetaData.h"
 #include "DkImageContainer.h"
+#include "DkImageCache.h"
+#include "DkDirIndex.h"
+#include "DkThreadPools.h"
 #include "DkMessageBox.h"
 #include "DkSaveDialog.h"
 #include "DkUtils.h"
@@ -59,6 +62,7 @@
 #include <QStringList>
 #include <QMessageBox>
 #include <QDirIterator>
+#include <QSet>
 #include <QProgressDialog>
 #include <QReadLocker>
 #include <QWriteLocker>
@@ -74,6 +78,8 @@
 #include <qmath.h>
 #include <QtConcurrentRun>
 
+#include <algorithm>
+
 // quazip
 #ifdef WITH_QUAZIP
 #include <quazip/JlCompress.h>
@@ -97,6 +103,550 @@
 
 namespace nmc {
 
+// DkPrefetchJob --------------------------------------------------------------------
+DkPrefetchJob::DkPrefetchJob(QSharedPointer<DkImageContainerT> imgC, int type, double priority) {
+
+	mImage = imgC;
+	mType = type;
+	mPriority = priority;
+}
+
+bool DkPrefetchJob::operator<(const DkPrefetchJob& o) const {
+
+	// std::priority_queue pops the largest element first - so we invert the order here
+	return mPriority > o.mPriority;
+}
+
+QSharedPointer<DkImageContainerT> DkPrefetchJob::image() const {
+	return mImage;
+}
+
+int DkPrefetchJob::type() const {
+	return mType;
+}
+
+double DkPrefetchJob::priority() const {
+	return mPriority;
+}
+
+// DkPrefetchScheduler --------------------------------------------------------------------
+DkPrefetchScheduler::DkPrefetchScheduler(QObject* parent) : QObject(parent) {
+
+	// leave at least one thread for the current image
+	mMaxRunning = qMax(1, qMin(2, DkSettingsManager::param().global().numThreads-1));
+
+	mDispatchTimer.setInterval(50);
+	connect(&mDispatchTimer, SIGNAL(timeout()), this, SLOT(dispatch()));
+}
+
+/**
+ * Updates the browsing direction and speed.
+ * Call this function whenever the current image changes.
+ * Queued jobs are dropped and running jobs that are out of
+ * the new prefetch window are canceled.
+ * @param images the images of the current folder.
+ * @param cIdx the index of the new current image.
+ **/ 
+void DkPrefetchScheduler::setCursor(const QVector<QSharedPointer<DkImageContainerT> >& images, int cIdx) {
+
+	if (cIdx < 0 || cIdx == mLastIdx)
+		return;
+
+	if (mLastIdx != -1 && mNavTimer.isValid()) {
+
+		int delta = cIdx - mLastIdx;
+
+		// the shortest way is the right one if we loop the folder
+		if (DkSettingsManager::param().global().loop && qAbs(delta) > images.size()/2)
+			delta = (delta > 0) ? delta - images.size() : delta + images.size();
+
+		if (delta != 0)
+			mDirection = (delta > 0) ? 1 : -1;
+
+		// exponential moving average of images/sec
+		double ms = qMax((double)mNavTimer.restart(), 1.0);
+		mSpeed = 0.5*mSpeed + 0.5*(qAbs(delta)*1000.0/ms);
+	}
+	else
+		mNavTimer.start();
+
+	mLastIdx = cIdx;
+
+	// jobs are re-ranked as soon as the current image is loaded
+	mQueue = std::priority_queue<DkPrefetchJob>();
+	cancelStaleJobs(images, cIdx);
+}
+
+/**
+ * Re-ranks the prefetch jobs around the current image.
+ * The image in browsing direction is fully decoded while
+ * the following images are just fetched. If the user
+ * browses fast (e.g. holds the arrow key), nothing is decoded.
+ * @param images the images of the current folder.
+ * @param cIdx the index of the current image.
+ **/ 
+void DkPrefetchScheduler::update(const QVector<QSharedPointer<DkImageContainerT> >& images, int cIdx) {
+
+	mQueue = std::priority_queue<DkPrefetchJob>();
+
+	if (cIdx < 0 || cIdx >= images.size())
+		return;
+
+	if (mLastIdx == -1)
+		mLastIdx = cIdx;
+
+	cancelStaleJobs(images, cIdx);
+
+	// images outside the window are released by the LRU cache
+	double budget = DkImageCache::instance().budget();
+	double mem = images.at(cIdx)->getMemoryUsage();
+
+	int ahead, behind;
+	windowSize(ahead, behind);
+	bool loop = DkSettingsManager::param().global().loop;
+
+	for (int offset = 1; offset <= qMax(ahead, behind); offset++) {
+
+		for (int dir : {mDirection, -mDirection}) {
+
+			if (offset > ((dir == mDirection) ? ahead : behind))
+				continue;
+
+			int idx = cIdx + dir*offset;
+
+			if (loop && !images.empty())
+				idx = (idx % images.size() + images.size()) % images.size();
+			
+			if (idx < 0 || idx >= images.size() || idx == cIdx)
+				continue;
+
+			QSharedPointer<DkImageContainerT> imgC = images.at(idx);
+
+			// estimate images that are not cached yet by their file size
+			float imgMem = imgC->getMemoryUsage();
+			mem += (imgMem > 0) ? imgMem : imgC->getFileSize();
+
+			if (mem >= budget || imgC->getLoadState() != DkImageContainer::not_loaded || imgC->isFetching())
+				continue;
+
+			// the neighbors are decoded - all others are fetched
+			int type = (offset == 1 && !isFastBrowsing()) ? DkPrefetchJob::job_decode : DkPrefetchJob::job_fetch;
+
+			// images behind the cursor are less likely to be shown next
+			double priority = (dir == mDirection) ? offset : offset*2.0 + 0.5;
+
+			mQueue.push(DkPrefetchJob(imgC, type, priority));
+		}
+	}
+
+	dispatch();
+}
+
+/**
+ * Cancels all jobs & resets the browsing direction.
+ **/ 
+void DkPrefetchScheduler::clear() {
+
+	mQueue = std::priority_queue<DkPrefetchJob>();
+
+	for (const DkPrefetchJob& job : mRunning)
+		job.image()->cancel();
+
+	mRunning.clear();
+	mDispatchTimer.stop();
+
+	mLastIdx = -1;
+	mDirection = 1;
+	mSpeed = 0.0;
+	mNavTimer.invalidate();
+}
+
+/**
+ * Prefetched images are decoded for this size.
+ * @param size the display size (invalid decodes all pixels)
+ **/ 
+void DkPrefetchScheduler::setDisplaySize(const QSize& size) {
+
+	mDisplaySize = size;
+}
+
+/**
+ * Starts queued jobs until the maximal number of running jobs is reached.
+ **/ 
+void DkPrefetchScheduler::dispatch() {
+
+	// remove finished jobs
+	for (int idx = mRunning.size()-1; idx >= 0; idx--) {
+
+		QSharedPointer<DkImageContainerT> imgC = mRunning.at(idx).image();
+
+		if (!imgC->isFetching() && imgC->getLoadState() != DkImageContainer::loading)
+			mRunning.remove(idx);
+	}
+
+	// the current image is waiting for a thread - do not queue more jobs in front of it
+	DkThreadPools& pools = DkThreadPools::instance();
+	bool currentQueued = pools.queued(DkThreadPools::lane_current_io) > 0 || pools.queued(DkThreadPools::lane_current_decode) > 0;
+
+	while (!currentQueued && !mQueue.empty() && mRunning.size() < mMaxRunning) {
+
+		DkPrefetchJob job = mQueue.top();
+		mQueue.pop();
+
+		QSharedPointer<DkImageContainerT> imgC = job.image();
+
+		// the state might have changed while the job was waiting
+		if (imgC->getLoadState() != DkImageContainer::not_loaded || imgC->isFetching())
+			continue;
+
+		if (job.type() == DkPrefetchJob::job_decode) {
+			imgC->setDisplaySize(mDisplaySize);
+			imgC->loadImageThreaded();
+			qDebug() << "[Cacher] " << imgC->filePath() << " fully cached...";
+		}
+		else {
+			imgC->fetchFile();
+			qDebug() << "[Cacher] " << imgC->filePath() << " file fetched...";
+		}
+
+		mRunning << job;
+	}
+
+	if (mQueue.empty() && mRunning.empty())
+		mDispatchTimer.stop();
+	else if (!mDispatchTimer.isActive())
+		mDispatchTimer.start();
+}
+
+int DkPrefetchScheduler::direction() const {
+	return mDirection;
+}
+
+double DkPrefetchScheduler::speed() const {
+	return mSpeed;
+}
+
+bool DkPrefetchScheduler::isFastBrowsing() const {
+
+	// more than 4 images per second -> the user does not look at the images
+	return mSpeed > 4.0 && mNavTimer.isValid() && mNavTimer.elapsed() < 1000;
+}
+
+int DkPrefetchScheduler::numPendingJobs() const {
+	return (int)mQueue.size() + mRunning.size();
+}
+
+void DkPrefetchScheduler::windowSize(int& ahead, int& behind) const {
+
+	int maxCached = qMax(DkSettingsManager::param().resources().maxImagesCached, 2);
+
+	ahead = maxCached;
+	behind = qMax(1, maxCached/3);
+}
+
+bool DkPrefetchScheduler::inWindow(int idx, int cIdx, int numImages) const {
+
+	int offset = idx - cIdx;
+
+	if (DkSettingsManager::param().global().loop && qAbs(offset) > numImages/2)
+		offset = (offset > 0) ? offset - numImages : offset + numImages;
+
+	offset *= mDirection;
+
+	int ahead, behind;
+	windowSize(ahead, behind);
+
+	return offset >= -behind && offset <= ahead;
+}
+
+void DkPrefetchScheduler::cancelStaleJobs(const QVector<QSharedPointer<DkImageContainerT> >& images, int cIdx) {
+
+	for (int idx = mRunning.size()-1; idx >= 0; idx--) {
+
+		QSharedPointer<DkImageContainerT> imgC = mRunning.at(idx).image();
+		int imgIdx = images.indexOf(imgC);
+
+		// the job's image became the current image - it's not ours anymore
+		if (imgIdx == cIdx) {
+			mRunning.remove(idx);
+		}
+		else if (imgIdx == -1 || !inWindow(imgIdx, cIdx, images.size())) {
+			imgC->cancel();
+			mRunning.remove(idx);
+		}
+	}
+}
+
+// DkScanState --------------------------------------------------------------------
+void DkScanState::addFiles(const QVector<DkDirIndexEntry>& entries) {
+
+	if (entries.empty())
+		return;
+
+	{
+		QMutexLocker locker(&mMutex);
+		mFiles << entries;
+	}
+
+	emit filesFound();
+}
+
+QVector<DkDirIndexEntry> DkScanState::takeFiles() {
+
+	QMutexLocker locker(&mMutex);
+	QVector<DkDirIndexEntry> files = mFiles;
+	mFiles.clear();
+
+	return files;
+}
+
+// DkDirectoryScanner --------------------------------------------------------------------
+DkDirectoryScanner::DkDirectoryScanner(QObject* parent) : QObject(parent) {
+
+	connect(&mScanWatcher, SIGNAL(finished()), this, SLOT(scanDone()));
+}
+
+DkDirectoryScanner::~DkDirectoryScanner() {
+
+	cancel();
+}
+
+/**
+ * Starts listing dirPath in a background thread.
+ * A running scan is canceled.
+ * @param dirPath the directory to be listed.
+ * @param ignoreKeywords files that contain one of these keywords are ignored.
+ * @param keywords files that do not contain all of these keywords are ignored.
+ * @param folderKeywords the folder filter string.
+ **/ 
+void DkDirectoryScanner::scan(const QString& dirPath, const QStringList& ignoreKeywords, const QStringList& keywords, const QString& folderKeywords) {
+
+	cancel();
+
+	mDirPath = dirPath;
+	mScanning = true;
+
+	// the state is deleted in our thread, even if the scanning thread drops it last
+	QSharedPointer<DkScanState> state(new DkScanState(), &QObject::deleteLater);
+	connect(state.data(), SIGNAL(filesFound()), this, SIGNAL(filesFound()), Qt::QueuedConnection);
+	mState = state;
+
+	// listing directories blocks on I/O - hence it does not need a decoder thread
+	mScanWatcher.setFuture(DkThreadPools::instance().run(DkThreadPools::lane_current_io, 
+		[state, dirPath, ignoreKeywords, keywords, folderKeywords]() { 
+			scanIntern(state, dirPath, ignoreKeywords, keywords, folderKeywords); 
+		}));
+}
+
+/**
+ * Stops a running scan without waiting for it.
+ * The scanning thread runs out on its own state - 
+ * hence files that were not taken yet are discarded.
+ **/ 
+void DkDirectoryScanner::cancel() {
+
+	if (mState) {
+		mState->canceled.store(1);
+		mState->disconnect(this);
+		mState.clear();
+	}
+
+	// scanDone() ignores the finished() of a canceled scan
+	mScanning = false;
+}
+
+bool DkDirectoryScanner::isScanning() const {
+	return mScanning;
+}
+
+QString DkDirectoryScanner::dirPath() const {
+	return mDirPath;
+}
+
+/**
+ * Returns all files that were found since the last call.
+ * @return QVector<DkDirIndexEntry> the files of dirPath() with their sizes and dates (unsorted).
+ **/ 
+QVector<DkDirIndexEntry> DkDirectoryScanner::takeFiles() {
+
+	if (!mState)
+		return QVector<DkDirIndexEntry>();
+
+	return mState->takeFiles();
+}
+
+void DkDirectoryScanner::scanDone() {
+
+	// the watcher might report a scan that we already finished
+	if (!mScanning)
+		return;
+
+	mScanning = false;
+	emit scanFinished();
+}
+
+void DkDirectoryScanner::scanIntern(QSharedPointer<DkScanState> state, const QString& dirPath, const QStringList& ignoreKeywords, const QStringList& keywords, const QString& folderKeywords) {
+
+	DkTimer dt;
+
+	// duplicates can only be found if we know all files
+	bool holdBack = DkSettingsManager::param().resources().filterDuplicats;
+	QVector<DkDirIndexEntry> entries;
+
+	// the folder did not change since we have seen it
+	if (DkDirIndexManager::instance().entries(dirPath, entries)) {
+
+		entries = filterEntries(entries, ignoreKeywords, keywords, folderKeywords, holdBack);
+		state->addFiles(entries);
+		qInfoClean() << "[DkDirectoryScanner] " << dirPath << " [" << entries.size() << "] from index in " << dt;
+		return;
+	}
+
+	// files that are added while listing invalidate the index
+	QDateTime dirModified = QFileInfo(dirPath).lastModified();
+
+	QDirIterator dirIt(dirPath, DkSettingsManager::param().app().browseFilters, QDir::Files);
+	QElapsedTimer batchTimer;
+	batchTimer.start();
+	int batchStart = 0;
+	int numFiles = 0;
+
+	while (dirIt.hasNext() && !state->canceled.load()) {
+
+		dirIt.next();
+
+		// we are in a thread - so the stat calls do not hurt
+		entries << DkDirIndexEntry::fromFileInfo(dirIt.fileInfo());
+
+		// hand over a batch every 250 ms
+		if (!holdBack && batchTimer.elapsed() > 250) {
+			QVector<DkDirIndexEntry> batch = filterEntries(entries.mid(batchStart), ignoreKeywords, keywords, folderKeywords);
+			numFiles += batch.size();
+			state->addFiles(batch);
+			batchStart = entries.size();
+			batchTimer.restart();
+		}
+	}
+
+	if (state->canceled.load())
+		return;
+
+	DkDirIndexManager::instance().setEntries(dirPath, entries, dirModified);
+
+	// duplicates need the full listing
+	QVector<DkDirIndexEntry> batch = filterEntries(holdBack ? entries : entries.mid(batchStart), ignoreKeywords, keywords, folderKeywords, holdBack);
+	numFiles += batch.size();
+	state->addFiles(batch);
+
+	qInfoClean() << "[DkDirectoryScanner] " << dirPath << " [" << numFiles << "] listed in " << dt;
+}
+
+/**
+ * Applies the keyword (and duplicate) filters to index entries.
+ * @param entries the files of a directory.
+ * @param ignoreKeywords if one of these keywords is in the file name, the file will be ignored.
+ * @param keywords if one of these keywords is not in the file name, the file will be ignored.
+ * @param folderKeywords the folder filter string.
+ * @param duplicates if true, files that exist with the preferred extension are removed.
+ * @return QVector<DkDirIndexEntry> the filtered entries.
+ **/ 
+QVector<DkDirIndexEntry> DkDirectoryScanner::filterEntries(const QVector<DkDirIndexEntry>& entries, const QStringList& ignoreKeywords, const QStringList& keywords, const QString& folderKeywords, bool duplicates) {
+
+	if (ignoreKeywords.empty() && keywords.empty() && folderKeywords.isEmpty() && !duplicates)
+		return entries;
+
+	QStringList fileNames;
+	for (const DkDirIndexEntry& e : entries)
+		fileNames << e.fileName();
+
+	fileNames = filterFiles(fileNames, ignoreKeywords, keywords, folderKeywords);
+
+	if (duplicates)
+		fileNames = filterDuplicates(fileNames);
+
+	QSet<QString> keep = fileNames.toSet();
+	QVector<DkDirIndexEntry> filtered;
+
+	for (const DkDirIndexEntry& e : entries) {
+		if (keep.contains(e.fileName()))
+			filtered << e;
+	}
+
+	return filtered;
+}
+
+/**
+ * Applies the keyword filters to a list of file names.
+ * @param fileList the file names.
+ * @param ignoreKeywords if one of these keywords is in the file name, the file will be ignored.
+ * @param keywords if one of these keywords is not in the file name, the file will be ignored.
+ * @param folderKeywords the folder filter string.
+ * @return QStringList the filtered file names.
+ **/ 
+QStringList DkDirectoryScanner::filterFiles(const QStringList& fileList, const QStringList& ignoreKeywords, const QStringList& keywords, const QString& folderKeywords) {
+
+	QStringList filteredList = fileList;
+
+	for (int idx = 0; idx < ignoreKeywords.size(); idx++) {
+		QRegExp exp = QRegExp("^((?!" + ignoreKeywords[idx] + ").)*$");
+		exp.setCaseSensitivity(Qt::CaseInsensitive);
+		filteredList = filteredList.filter(exp);
+	}
+
+	for (int idx = 0; idx < keywords.size(); idx++) {
+		filteredList = filteredList.filter(keywords[idx], Qt::CaseInsensitive);
+	}
+
+	if (folderKeywords != "") {
+		QStringList filterList = filteredList;
+		filteredList = DkUtils::filterStringList(folderKeywords, filterList);
+	}
+
+	return filteredList;
+}
+
+/**
+ * Removes files that exist with the preferred extension.
+ * @param fileList all file names of a directory.
+ * @return QStringList the filtered file names.
+ **/ 
+QStringList DkDirectoryScanner::filterDuplicates(const QStringList& fileList) {
+
+	QString preferredExtension = DkSettingsManager::param().resources().preferredExtension;
+	preferredExtension = preferredExtension.replace("*.", "");
+	qDebug() << "preferred extension: " << preferredExtension;
+
+	QStringList filteredList;
+
+	for (int idx = 0; idx < fileList.size(); idx++) {
+		
+		QFileInfo cFName = QFileInfo(fileList.at(idx));
+
+		if (preferredExtension.compare(cFName.suffix(), Qt::CaseInsensitive) == 0) {
+			filteredList.append(fileList.at(idx));
+			continue;
+		}
+
+		QString cFBase = cFName.baseName();
+		bool remove = false;
+
+		for (int cIdx = 0; cIdx < fileList.size(); cIdx++) {
+
+			QString ccBase = QFileInfo(fileList.at(cIdx)).baseName();
+
+			if (cIdx != idx && ccBase == cFBase && fileList.at(cIdx).contains(preferredExtension, Qt::CaseInsensitive)) {
+				remove = true;
+				break;
+			}
+		}
+		
+		if (!remove)
+			filteredList.append(fileList.at(idx));
+	}
+
+	return filteredList;
+}
+
 // DkImageLoader -> is nomacs file handling routine --------------------------------------------------------------------
 /**
  * Default constructor.
@@ -114,6 +664,13 @@ DkImageLoader::DkImageLoader(const QString& filePath) {
 	mSortingImages = false;
 
 	connect(&mCreateImageWatcher, SIGNAL(finished()), this, SLOT(imagesSorted()));
+	connect(&mScanner, SIGNAL(filesFound()), this, SLOT(filesScanned()));
+	connect(&mScanner, SIGNAL(scanFinished()), this, SLOT(dirScanned()));
+
+	DkDirIndexManager& dirIndex = DkDirIndexManager::instance();
+	connect(&dirIndex, SIGNAL(filesChanged(const QString&, const QStringList&, const QStringList&, const QStringList&)), 
+		this, SLOT(filesChanged(const QString&, const QStringList&, const QStringList&, const QStringList&)));
+	connect(&dirIndex, SIGNAL(indexInvalidated(const QString&)), this, SLOT(directoryChanged(const QString&)));
 
 	mDelayedUpdateTimer.setSingleShot(true);
 	connect(&mDelayedUpdateTimer, SIGNAL(timeout()), this, SLOT(directoryChanged()));
@@ -136,8 +693,13 @@ DkImageLoader::DkImageLoader(const QString& filePath) {
  **/ 
 DkImageLoader::~DkImageLoader() {
 	
+	DkImageCache::instance().setCurrent(this, 0);
+
 	if (mCreateImageWatcher.isRunning())
 		mCreateImageWatcher.blockSignals(true);
+
+	if (!mWatchedDir.isEmpty())
+		DkDirIndexManager::instance().unwatch(mWatchedDir);
 }
 
 /**
@@ -155,6 +717,8 @@ void DkImageLoader::clearPath() {
 		mImages.clear();
 	}
 
+	mScanner.cancel();
+	mPrefetcher.clear();
 	mCurrentImage.clear();
 }
 
@@ -165,7 +729,7 @@ void DkImageLoader::clearPath() {
  **/ 
 bool DkImageLoader::loadZipArchive(const QString& zipPath) {
 
-	QStringList fileNameList = JlCompress::getFileList(zipPath);
+	QStringList fileNameList = DkZipContainer::fileList(zipPath);
 	
 	// remove the * in fileFilters
 	QStringList fileFiltersClean = DkSettingsManager::param().app().browseFilters;
@@ -225,7 +789,8 @@ bool DkImageLoader::loadDir(const QString& newDirPath, bool scanRecursive) {
 	if (mFolderUpdated && newDirPath == mCurrentDir) {
 		
 		mFolderUpdated = false;
-		QFileInfoList files = getFilteredFileInfoList(newDirPath, mIgnoreKeywords, mKeywords, mFolderFilterString);		// this line takes seconds if you have lots of files and slow loading (e.g. network)
+		mScanner.cancel();
+		QVector<DkDirIndexEntry> files = getFilteredEntries(newDirPath, mIgnoreKeywords, mKeywords, mFolderFilterString);		// this line takes seconds if you have lots of files and slow loading (e.g. network)
 
 		// might get empty too (e.g. someone deletes all images)
  		if (files.empty()) {
@@ -240,133 +805,432 @@ bool DkImageLoader::loadDir(const QString& newDirPath, bool scanRecursive) {
 		//	createImages(files, false);
 		//	sortImagesThreaded(images);
 		//}
+		//else
+			createImages(newDirPath, files, true);
+
+		qDebug() << "getting file list.....";
+	}
+	// the folder is currently listed
+	else if (mScanner.isScanning() && newDirPath == mScanner.dirPath()) {
+		return true;
+	}
+	// new folder is loaded
+	else if ((newDirPath != mCurrentDir || mImages.empty()) && !newDirPath.isEmpty() && QDir(newDirPath).exists()) {
+
+		QFileInfoList files;
+
+		//newDir.setNameFilters(DkSettingsManager::param().app().fileFilters);
+		//newDir.setSorting(QDir::LocaleAware);		// TODO: extend
+
+		// update save directory
+		mCurrentDir = newDirPath;
+		mFolderUpdated = false;
+
+		mFolderFilterString.clear();	// delete key words -> otherwise user may be confused
+
+		// stream the folder - the current image is shown while we are listing
+		if (!scanRecursive || !DkSettingsManager::param().global().scanSubFolders) {
+			
+			mImages.clear();
+			mPrefetcher.clear();
+			clearPendingFile();
+			updateDirWatcher();	// watch first - so we don't miss changes while listing
+			mScanner.scan(mCurrentDir, mIgnoreKeywords, mKeywords, mFolderFilterString);
+			
+			return true;
+		}
+
+		mScanner.cancel();
+		files = updateSubFolders(mCurrentDir);
+
+		if (files.empty()) {
+			emit showInfoSignal(tr("%1 \n does not contain any image").arg(mCurrentDir), 4000);	// stop showing
+			return false;
+		}
+
+		// ok new folder, this should speed-up loading
+		mImages.clear();
+		mPrefetcher.clear();
+		
+		//// TODO: creating ~120 000 images takes about 2 secs
+		//// but sorting (just filenames) takes ages (on windows)
+		//// so we should fix this using 2 strategies: 
+		//// - thread the image creation process
+		//// - while loading (if the user wants to move in the folder) we could display some message (e.g. indexing dir)
+		//if (files.size() > 2000) {
+		//	createImages(files, false);
+		//	sortImagesThreaded(mImages);
+		//}
 		//else
 			createImages(files, true);
 
-		qDebug() << "getting file list.....";
-	}
-	// new folder is loaded
-	else if ((newDirPath != mCurrentDir || mImages.empty()) && !newDirPath.isEmpty() && QDir(newDirPath).exists()) {
+		qInfoClean() << newDirPath << " [" << mImages.size() << "] loaded in " << dt;
+	}
+	//else
+	//	qDebug() << "ignoring... old dir: " << dir.absolutePath() << " newDir: " << newDir << " file size: " << images.size();
+
+	return true;
+}
+
+void DkImageLoader::sortImagesThreaded(QVector<QSharedPointer<DkImageContainerT > > images) {
+
+	if (mSortingImages) {
+		mSortingIsDirty = true;
+		return;
+	}
+
+	mSortingIsDirty = false;
+	mSortingImages = true;
+	mCreateImageWatcher.setFuture(QtConcurrent::run(this, 
+		&nmc::DkImageLoader::sortImages, images));
+
+	qDebug() << "sorting images threaded...";
+}
+
+void DkImageLoader::imagesSorted() {
+
+	mSortingImages = false;
+	mImages = mCreateImageWatcher.result();
+	invalidateFileIndex();
+
+	if (mSortingIsDirty) {
+		qDebug() << "re-sorting because it's dirty...";
+		sortImagesThreaded(mImages);
+		return;
+	}
+
+	emit updateDirSignal(mImages);
+
+	updateDirWatcher();
+
+	qDebug() << "images sorted...";
+}
+
+void DkImageLoader::createImages(const QFileInfoList& files, bool sort) {
+
+	// TODO: change files to QStringList
+	DkTimer dt;
+	QVector<QSharedPointer<DkImageContainerT > > oldImages = mImages;
+	QHash<QString, int> oldIndex = fileIndex();
+	mImages.clear();
+	invalidateFileIndex();
+
+	for (int idx = 0; idx < files.size(); idx++) {
+
+		int oIdx = oldIndex.value(files.at(idx).absoluteFilePath(), -1);
+
+		if (oIdx != -1 && QFileInfo(oldImages.at(oIdx)->filePath()).lastModified() == files.at(idx).lastModified())
+			mImages.append(oldImages.at(oIdx));
+		else
+			mImages.append(QSharedPointer<DkImageContainerT >(new DkImageContainerT(files.at(idx).absoluteFilePath())));
+	}
+	qDebugClean() << "[DkImageLoader] " << mImages.size() << " containers created in " << dt;
+
+	if (sort) {
+		sortImageContainers(mImages);
+		invalidateFileIndex();
+		qDebug() << "[DkImageLoader] after sorting: " << dt;
+
+		emit updateDirSignal(mImages);
+
+		updateDirWatcher();
+	}
+
+}
+
+/**
+ * Creates the image list from a directory listing.
+ * Unchanged images are kept, sizes and dates are taken from the listing.
+ * @param dirPath the directory of the entries.
+ * @param entries the files.
+ * @param sort if true, the images are sorted.
+ **/ 
+void DkImageLoader::createImages(const QString& dirPath, const QVector<DkDirIndexEntry>& entries, bool sort) {
+
+	DkTimer dt;
+	QVector<QSharedPointer<DkImageContainerT > > oldImages = mImages;
+	QHash<QString, int> oldIndex = fileIndex();
+	QDir dir(dirPath);
+	mImages.clear();
+	mImages.reserve(entries.size());
+	invalidateFileIndex();
+
+	for (const DkDirIndexEntry& e : entries) {
+
+		QString fp = QFileInfo(dir, e.fileName()).absoluteFilePath();
+		int oIdx = oldIndex.value(fp, -1);
+
+		if (oIdx != -1) {
+			
+			const QSharedPointer<DkImageContainerT>& oImgC = oldImages.at(oIdx);
+			qint64 oModified = oImgC->sortKey().hasDates() ? oImgC->sortKey().modified() : QFileInfo(fp).lastModified().toMSecsSinceEpoch();
+			qint64 eModified = e.modified().isValid() ? e.modified().toMSecsSinceEpoch() : QFileInfo(fp).lastModified().toMSecsSinceEpoch();
+			
+			if (oModified == eModified) {
+				mImages.append(oImgC);
+				continue;
+			}
+		}
+
+		QSharedPointer<DkImageContainerT> imgC(new DkImageContainerT(fp));
+		imgC->setFileStats(e.size(), e.created(), e.modified());
+		mImages.append(imgC);
+	}
+	qDebugClean() << "[DkImageLoader] " << mImages.size() << " containers created in " << dt;
+
+	if (sort) {
+		sortImageContainers(mImages);
+		invalidateFileIndex();
+		qDebug() << "[DkImageLoader] after sorting: " << dt;
+
+		emit updateDirSignal(mImages);
+
+		updateDirWatcher();
+	}
+}
+
+QVector<QSharedPointer<DkImageContainerT > > DkImageLoader::sortImages(QVector<QSharedPointer<DkImageContainerT > > images) const {
+
+	sortImageContainers(images);
+
+	return images;
+}
+
+/**
+ * Merges files into the (sorted) image list.
+ * Just the new files are sorted, so adding a batch is
+ * linear in the number of images.
+ * @param dirPath the directory of the entries.
+ * @param entries the files to be added (with their sizes and dates).
+ **/ 
+void DkImageLoader::appendImages(const QString& dirPath, const QVector<DkDirIndexEntry>& entries) {
+
+	if (entries.empty())
+		return;
+
+	QVector<QSharedPointer<DkImageContainerT > > newImages;
+	newImages.reserve(entries.size());
+	QDir dir(dirPath);
+
+	for (const DkDirIndexEntry& e : entries) {
+
+		QString fp = QFileInfo(dir, e.fileName()).absoluteFilePath();
+
+		// keep the current image - it is probably loading right now
+		if (mCurrentImage && mCurrentImage->filePath() == fp)
+			newImages.append(mCurrentImage);
+		else {
+			QSharedPointer<DkImageContainerT> imgC(new DkImageContainerT(fp));
+			imgC->setFileStats(e.size(), e.created(), e.modified());
+			newImages.append(imgC);
+		}
+	}
+
+	sortImageContainers(newImages);
+
+	int oldSize = mImages.size();
+	mImages += newImages;
+	std::inplace_merge(mImages.begin(), mImages.begin() + oldSize, mImages.end(), 
+		[](const QSharedPointer<DkImageContainerT>& l, const QSharedPointer<DkImageContainerT>& r) {
+		return imageContainerLessThan(*l, *r);
+	});
+	invalidateFileIndex();
+}
+
+/**
+ * Merges a batch of the folder scan.
+ * Views are updated once the folder is listed (see dirScanned)
+ * since they rebuild all thumbnails for every update.
+ **/ 
+void DkImageLoader::filesScanned() {
+
+	appendImages(mScanner.dirPath(), mScanner.takeFiles());
+}
 
-		QFileInfoList files;
+void DkImageLoader::dirScanned() {
 
-		//newDir.setNameFilters(DkSettingsManager::param().app().fileFilters);
-		//newDir.setSorting(QDir::LocaleAware);		// TODO: extend
+	appendImages(mScanner.dirPath(), mScanner.takeFiles());
 
-		// update save directory
-		mCurrentDir = newDirPath;
-		mFolderUpdated = false;
+	if (mImages.empty()) {
+		clearPendingFile();
+		emit showInfoSignal(tr("%1 \n does not contain any image").arg(mCurrentDir), 4000);	// stop showing
+		return;
+	}
 
-		mFolderFilterString.clear();	// delete key words -> otherwise user may be confused
+	emit updateDirSignal(mImages);
 
-		if (scanRecursive && DkSettingsManager::param().global().scanSubFolders)
-			files = updateSubFolders(mCurrentDir);
-		else 
-			files = getFilteredFileInfoList(mCurrentDir, mIgnoreKeywords, mKeywords, mFolderFilterString);		// this line takes seconds if you have lots of files and slow loading (e.g. network)
+	updateDirWatcher();
 
-		if (files.empty()) {
-			emit showInfoSignal(tr("%1 \n does not contain any image").arg(mCurrentDir), 4000);	// stop showing
-			return false;
-		}
+	// the user navigated while we were listing
+	if (mPendingSkip != 0 || mPendingIdx != -1 || mPendingLast)
+		QTimer::singleShot(0, this, SLOT(loadPendingFile()));
 
-		// ok new folder, this should speed-up loading
-		mImages.clear();
+	// the current image was loaded before we knew its neighbors
+	if (mCurrentImage && mCurrentImage->getLoadState() == DkImageContainer::loaded) {
+
+		int cIdx = findFileIdx(mCurrentImage->filePath(), mImages);
 		
-		//// TODO: creating ~120 000 images takes about 2 secs
-		//// but sorting (just filenames) takes ages (on windows)
-		//// so we should fix this using 2 strategies: 
-		//// - thread the image creation process
-		//// - while loading (if the user wants to move in the folder) we could display some message (e.g. indexing dir)
-		//if (files.size() > 2000) {
-		//	createImages(files, false);
-		//	sortImagesThreaded(mImages);
-		//}
-		//else
-			createImages(files, true);
+		mPrefetcher.setCursor(mImages, cIdx);
+		updateCacher(mCurrentImage);
+		emit imageUpdatedSignal(cIdx);
 
-		qInfoClean() << newDirPath << " [" << mImages.size() << "] loaded in " << dt;
+		if (cIdx >= 0)
+			DkStatusBarManager::instance().setMessage(tr("%1 of %2").arg(cIdx+1).arg(mImages.size()), DkStatusBar::status_filenumber_info);
 	}
-	//else
-	//	qDebug() << "ignoring... old dir: " << dir.absolutePath() << " newDir: " << newDir << " file size: " << images.size();
 
-	return true;
+	qInfoClean() << mCurrentDir << " [" << mImages.size() << "] indexed";
+
+	// the folder changed while we were listing it
+	if (mFolderUpdated)
+		loadDir(mCurrentDir, false);
 }
 
-void DkImageLoader::sortImagesThreaded(QVector<QSharedPointer<DkImageContainerT > > images) {
+/**
+ * Loads the file that was requested while the folder was listed.
+ **/ 
+void DkImageLoader::loadPendingFile() {
 
-	if (mSortingImages) {
-		mSortingIsDirty = true;
+	// a new folder is listed
+	if (mScanner.isScanning())
 		return;
-	}
 
-	mSortingIsDirty = false;
-	mSortingImages = true;
-	mCreateImageWatcher.setFuture(QtConcurrent::run(this, 
-		&nmc::DkImageLoader::sortImages, images));
+	int skipIdx = mPendingSkip;
+	int idx = mPendingIdx;
+	bool last = mPendingLast;
+	clearPendingFile();
 
-	qDebug() << "sorting images threaded...";
+	if (last)
+		loadFileAt(-1);
+	else if (idx != -1)
+		loadFileAt(idx);
+	else if (skipIdx != 0)
+		changeFile(skipIdx);
 }
 
-void DkImageLoader::imagesSorted() {
+void DkImageLoader::clearPendingFile() {
 
-	mSortingImages = false;
-	mImages = mCreateImageWatcher.result();
+	mPendingSkip = 0;
+	mPendingIdx = -1;
+	mPendingLast = false;
+}
 
-	if (mSortingIsDirty) {
-		qDebug() << "re-sorting because it's dirty...";
-		sortImagesThreaded(mImages);
-		return;
-	}
+/**
+ * Returns true while the current folder is listed.
+ * Navigating is deferred until the folder is listed
+ * completely (the neighbors are not known before).
+ **/ 
+bool DkImageLoader::isScanning() const {
 
-	emit updateDirSignal(mImages);
+	return mScanner.isScanning();
+}
+
+/**
+ * Watches the current directory.
+ * Incremental updates are used if the platform supports them.
+ **/ 
+void DkImageLoader::updateDirWatcher() {
+
+	DkDirIndexManager& dirIndex = DkDirIndexManager::instance();
+
+	if (dirIndex.canWatch()) {
 
-	if (mDirWatcher) {
+		if (mWatchedDir == mCurrentDir)
+			return;
+
+		if (!mWatchedDir.isEmpty())
+			dirIndex.unwatch(mWatchedDir);
+
+		dirIndex.watch(mCurrentDir);
+		mWatchedDir = mCurrentDir;
+	}
+	else if (mDirWatcher) {
 		if (!mDirWatcher->directories().isEmpty())
 			mDirWatcher->removePaths(mDirWatcher->directories());
 		mDirWatcher->addPath(mCurrentDir);
 	}
-
-	qDebug() << "images sorted...";
 }
 
-void DkImageLoader::createImages(const QFileInfoList& files, bool sort) {
+/**
+ * Applies changes of the current directory to the image list.
+ * This costs O(changes) rather than re-indexing the folder.
+ * @param dirPath the directory that changed.
+ * @param added file names of new files.
+ * @param removed file names of deleted files.
+ * @param modified file names of files that were written to.
+ **/ 
+void DkImageLoader::filesChanged(const QString& dirPath, const QStringList& added, const QStringList& removed, const QStringList& modified) {
 
-	// TODO: change files to QStringList
-	DkTimer dt;
-	QVector<QSharedPointer<DkImageContainerT > > oldImages = mImages;
-	mImages.clear();
+	if (dirPath != mCurrentDir)
+		return;
 
-	for (int idx = 0; idx < files.size(); idx++) {
+	// we need the full listing - re-index
+	if (mScanner.isScanning() || DkSettingsManager::param().resources().filterDuplicats) {
+		mFolderUpdated = true;
 
-		int oIdx = findFileIdx(files.at(idx).absoluteFilePath(), oldImages);
+		if (!mScanner.isScanning())
+			loadDir(mCurrentDir, false);
+		return;
+	}
 
-		if (oIdx != -1 && QFileInfo(oldImages.at(oIdx)->filePath()).lastModified() == files.at(idx).lastModified())
-			mImages.append(oldImages.at(oIdx));
-		else
-			mImages.append(QSharedPointer<DkImageContainerT >(new DkImageContainerT(files.at(idx).absoluteFilePath())));
+	QDir dir(dirPath);
+	bool changed = false;
+
+	if (!removed.empty()) {
+
+		QSet<QString> removedPaths;
+		for (const QString& fn : removed)
+			removedPaths.insert(QFileInfo(dir, fn).absoluteFilePath());
+
+		int oldSize = mImages.size();
+		mImages.erase(std::remove_if(mImages.begin(), mImages.end(), [&](const QSharedPointer<DkImageContainerT>& imgC) {
+			return imgC != mCurrentImage && removedPaths.contains(imgC->filePath());
+		}), mImages.end());
+
+		changed = oldSize != mImages.size();
+		invalidateFileIndex();
 	}
-	qDebugClean() << "[DkImageLoader] " << mImages.size() << " containers created in " << dt;
 
-	if (sort) {
-		qSort(mImages.begin(), mImages.end(), imageContainerLessThanPtr);
-		qDebug() << "[DkImageLoader] after sorting: " << dt;
+	QVector<DkDirIndexEntry> addedEntries;
+	for (const QString& fn : DkDirectoryScanner::filterFiles(added, mIgnoreKeywords, mKeywords, mFolderFilterString)) {
+		
+		QFileInfo fi(dir, fn);
+		QSharedPointer<DkImageContainerT> imgC = findFile(fi.absoluteFilePath());
 
-		emit updateDirSignal(mImages);
+		if (!imgC)
+			addedEntries << DkDirIndexEntry::fromFileInfo(fi);
+		else {
+			imgC->updateSortKey();
 
-		if (mDirWatcher) {
-			if (!mDirWatcher->directories().isEmpty())
-				mDirWatcher->removePaths(mDirWatcher->directories());
-			mDirWatcher->addPath(mCurrentDir);
+			if (imgC != mCurrentImage)
+				imgC->clear();	// the file was replaced
 		}
 	}
 
-}
+	if (!addedEntries.empty()) {
+		appendImages(dirPath, addedEntries);
+		changed = true;
+	}
 
-QVector<QSharedPointer<DkImageContainerT > > DkImageLoader::sortImages(QVector<QSharedPointer<DkImageContainerT > > images) const {
+	// cached images are outdated (the current image updates itself)
+	for (const QString& fn : modified) {
 
-	qSort(images.begin(), images.end(), imageContainerLessThanPtr);
+		QSharedPointer<DkImageContainerT> imgC = findFile(QFileInfo(dir, fn).absoluteFilePath());
 
-	return images;
+		if (!imgC)
+			continue;
+
+		imgC->updateSortKey();
+
+		if (imgC != mCurrentImage && !imgC->isFetching())
+			imgC->clear();
+	}
+
+	if (!modified.empty() && DkSettingsManager::param().global().sortMode == DkSettings::sort_date_modified)
+		sort();
+	else if (changed)
+		emit updateDirSignal(mImages);
+
+	qDebug() << "[DkImageLoader]" << added.size() << "added" << removed.size() << "removed" << modified.size() << "modified";
 }
 
 /**
@@ -391,6 +1255,15 @@ void DkImageLoader::changeFile(int skipIdx) {
 	// update dir
 	loadDir(mCurrentDir);
 
+	// do not block the GUI - we navigate as soon as the folder is listed
+	if (mScanner.isScanning()) {
+		mPendingSkip += skipIdx;
+		mPendingIdx = -1;
+		mPendingLast = false;
+		emit showInfoSignal(tr("Indexing folder..."), 1000);
+		return;
+	}
+
 	QSharedPointer<DkImageContainerT> imgC = getSkippedImage(skipIdx);
 
 	load(imgC);
@@ -423,6 +1296,15 @@ QSharedPointer<DkImageContainerT> DkImageLoader::getSkippedImage(int skipIdx, bo
 	if (!recursive)
 		loadDir(mCurrentImage->dirPath(), false);
 
+	// we need all neighbors here - so we navigate once the folder is listed
+	if (mScanner.isScanning()) {
+		mPendingSkip += skipIdx;
+		mPendingIdx = -1;
+		mPendingLast = false;
+		emit showInfoSignal(tr("Indexing folder..."), 1000);
+		return imgC;
+	}
+
 	// locate the current file
 	int newFileIdx = 0;
 	
@@ -489,18 +1371,19 @@ QSharedPointer<DkImageContainerT> DkImageLoader::getSkippedImage(int skipIdx, bo
 			loadDir(mSubFolders[folderIdx], false);	// don't scan recursive again
 			qDebug() << "loading new folder: " << mSubFolders[folderIdx];
 
-			if (newFileIdx >= oldFileSize) {
-				newFileIdx -= oldFileSize;
-				mTmpFileIdx = 0;
-				qDebug() << "new skip idx: " << newFileIdx << "cFileIdx: " << mTmpFileIdx << " -----------------------------";
-				getSkippedImage(newFileIdx, false, true);
-			}
-			else if (newFileIdx < 0) {
-				newFileIdx += mTmpFileIdx;
-				mTmpFileIdx = mImages.size()-1;
-				qDebug() << "new skip idx: " << newFileIdx << "cFileIdx: " << mTmpFileIdx << " -----------------------------";
-				getSkippedImage(newFileIdx, false, true);
-			}
+			// the new folder is listed - we load the file as soon as it is known
+			clearPendingFile();
+
+			if (newFileIdx >= oldFileSize)
+				mPendingIdx = newFileIdx - oldFileSize;
+			else
+				mPendingLast = true;
+
+			if (!mScanner.isScanning())
+				QTimer::singleShot(0, this, SLOT(loadPendingFile()));
+
+			emit showInfoSignal(tr("Indexing folder..."), 1000);
+			return imgC;
 		}
 		//// dir up
 		//else if (folderIdx == subFolders.size()) {
@@ -604,6 +1487,15 @@ void DkImageLoader::loadFileAt(int idx) {
 	if (mCurrentImage && !cDir.exists())
 		loadDir(mCurrentImage->dirPath());
 
+	// do not block the GUI - we navigate as soon as the folder is listed
+	if (mScanner.isScanning()) {
+		mPendingSkip = 0;
+		mPendingIdx = idx < 0 ? -1 : idx;
+		mPendingLast = idx < 0;
+		emit showInfoSignal(tr("Indexing folder..."), 1000);
+		return;
+	}
+
 	if(mImages.empty())
 		return;
 
@@ -651,26 +1543,12 @@ QSharedPointer<DkImageContainerT> DkImageLoader::findOrCreateFile(const QString&
 
 QSharedPointer<DkImageContainerT> DkImageLoader::findFile(const QString& filePath) const {
 
-	// if one image is from zip than all should be
-	// for images in zip the "images[idx]->file() == file" comparison somahow does not work
-	if(mImages.size() > 0) {
+	int idx = findFileIdx(filePath, mImages);
 
-		if (mImages[0]->isFromZip()) {
-			int idx = findFileIdx(filePath, mImages);
-			if (idx < 0) 
-				return QSharedPointer<DkImageContainerT>();
-			else 
-				return mImages[idx];
-		}
-	}
-
-	for (int idx = 0; idx < mImages.size(); idx++) {
-
-		if (mImages[idx]->filePath() == filePath)
-			return mImages[idx];
-	}
-
-	return QSharedPointer<DkImageContainerT>();
+	if (idx < 0) 
+		return QSharedPointer<DkImageContainerT>();
+	
+	return mImages[idx];
 }
 
 int DkImageLoader::findFileIdx(const QString& filePath, const QVector<QSharedPointer<DkImageContainerT> >& images) const {
@@ -680,6 +1558,20 @@ int DkImageLoader::findFileIdx(const QString& filePath, const QVector<QSharedPoi
 	QString lFilePath = filePath;
 	lFilePath.replace("\\", QDir::separator());
 
+	// our images are hashed
+	if (&images == &mImages) {
+
+		int idx = fileIndex().value(lFilePath, -1);
+
+		// mImages shrunk or was re-assigned without invalidating the index
+		if (idx >= mImages.size() || (idx >= 0 && mImages[idx]->filePath() != lFilePath)) {
+			invalidateFileIndex();
+			idx = fileIndex().value(lFilePath, -1);
+		}
+
+		return idx;
+	}
+
 	for (int idx = 0; idx < images.size(); idx++) {
 
 		if (images[idx]->filePath() == lFilePath)
@@ -689,6 +1581,35 @@ int DkImageLoader::findFileIdx(const QString& filePath, const QVector<QSharedPoi
 	return -1;
 }
 
+/**
+ * Returns the file path -> index map of mImages.
+ * The map is rebuilt if mImages changed.
+ **/ 
+const QHash<QString, int>& DkImageLoader::fileIndex() const {
+
+	if (mFileIndexDirty) {
+		
+		mFileIndex.clear();
+		mFileIndex.reserve(mImages.size());
+
+		// the first entry wins if a path exists twice (like the linear search)
+		for (int idx = mImages.size()-1; idx >= 0; idx--)
+			mFileIndex.insert(mImages[idx]->filePath(), idx);
+
+		mFileIndexDirty = false;
+	}
+
+	return mFileIndex;
+}
+
+/**
+ * Call this whenever images are added to mImages or if they are re-ordered.
+ **/ 
+void DkImageLoader::invalidateFileIndex() const {
+
+	mFileIndexDirty = true;
+}
+
 QStringList DkImageLoader::getFileNames() const {
 
 	QStringList fileNames;
@@ -701,6 +1622,7 @@ QStringList DkImageLoader::getFileNames() const {
 
 QVector<QSharedPointer<DkImageContainerT> > DkImageLoader::getImages() {
 
+	// the folder might still be listed - views are updated once it is done (see updateDirSignal())
 	loadDir(mCurrentDir);
 	return mImages;
 }
@@ -708,6 +1630,7 @@ QVector<QSharedPointer<DkImageContainerT> > DkImageLoader::getImages() {
 void DkImageLoader::setImages(QVector<QSharedPointer<DkImageContainerT> > images) {
 
 	mImages = images;
+	invalidateFileIndex();
 	emit updateDirSignal(images);
 }
 
@@ -833,7 +1756,8 @@ void DkImageLoader::setCurrentImage(QSharedPointer<DkImageContainerT> newImg) {
 			// anyhow we don't need to save the metadata twice
 			//currentImage->saveMetaDataThreaded();
 
-			if (!DkSettingsManager::param().resources().cacheMemory)
+			// edits are discarded when we leave an image
+			if (!DkSettingsManager::param().resources().cacheMemory || mCurrentImage->isEdited())
 				mCurrentImage->clear();
 
 			mCurrentImage->getLoader()->resetPageIdx();
@@ -842,6 +1766,7 @@ void DkImageLoader::setCurrentImage(QSharedPointer<DkImageContainerT> newImg) {
 	}
 
 	mCurrentImage = newImg;
+	DkImageCache::instance().setCurrent(this, mCurrentImage.data());
 
 	if (mCurrentImage)
 		mCurrentImage->receiveUpdates(this);
@@ -904,10 +1829,15 @@ void DkImageLoader::load(QSharedPointer<DkImageContainerT> image /* = QSharedPoi
 
 	setCurrentImage(image);
 
+	// track the browsing direction for prefetching
+	if (mCurrentImage)
+		mPrefetcher.setCursor(mImages, findFileIdx(mCurrentImage->filePath(), mImages));
+
 	if (mCurrentImage && mCurrentImage->getLoadState() == DkImageContainerT::loading)
 		return;
 
 	emit updateSpinnerSignalDelayed(true);
+	mCurrentImage->setDisplaySize(displaySize());
 	bool loaded = mCurrentImage->loadImageThreaded();	// loads file threaded
 	
 	if (!loaded)
@@ -930,6 +1860,8 @@ void DkImageLoader::imageLoaded(bool loaded /* = false */) {
 		return;
 
 	emit imageUpdatedSignal(mCurrentImage);
+	updateDisplayDecode();
+
 
 	if (mCurrentImage) {
 		// this signal is needed by the folder scrollbar
@@ -939,8 +1871,13 @@ void DkImageLoader::imageLoaded(bool loaded /* = false */) {
 
 	QApplication::sendPostedEvents();	// force an event post here
 
-	if (mCurrentImage && mCurrentImage->isFileDownloaded())
-		saveTempFile(mCurrentImage->image());
+	// downloaded images are saved once all pixels arrived (imageLoaded is called again then)
+	if (mCurrentImage && mCurrentImage->isFileDownloaded()) {
+		if (mCurrentImage->isDownscaled())
+			mCurrentImage->loadFullImageThreaded();
+		else
+			saveTempFile(mCurrentImage->image());
+	}
 
 	updateCacher(mCurrentImage);
 	updateHistory();
@@ -949,8 +1886,10 @@ void DkImageLoader::imageLoaded(bool loaded /* = false */) {
 		emit imageHasGPSSignal(DkMetaDataHelper::getInstance().hasGPS(mCurrentImage->getMetaData()));
 
 	// update status bar info
-	if (mCurrentImage && !mImages.empty() && mImages.indexOf(mCurrentImage) >= 0)
-		DkStatusBarManager::instance().setMessage(tr("%1 of %2").arg(mImages.indexOf(mCurrentImage)+1).arg(mImages.size()), DkStatusBar::status_filenumber_info);
+	int cIdx = mCurrentImage ? findFileIdx(mCurrentImage->filePath(), mImages) : -1;
+
+	if (cIdx >= 0)
+		DkStatusBarManager::instance().setMessage(tr("%1 of %2").arg(cIdx+1).arg(mImages.size()), DkStatusBar::status_filenumber_info);
 	else
 		DkStatusBarManager::instance().setMessage("", DkStatusBar::status_filenumber_info);
 
@@ -1533,7 +2472,7 @@ bool DkImageLoader::hasMovie() const {
 		return false;
 
 	QString newSuffix = QFileInfo(mCurrentImage->filePath()).suffix();
-	return newSuffix.contains(QRegExp("(gif|mng)", Qt::CaseInsensitive)) != 0;
+	return newSuffix.contains(QRegExp("(gif|mng|webp)", Qt::CaseInsensitive)) != 0;
 
 }
 
@@ -1704,62 +2643,31 @@ void DkImageLoader::updateCacher(QSharedPointer<DkImageContainerT> imgC) {
 
 	DkTimer dt;
 
-	//// no caching? delete all
-	//if (!DkSettingsManager::param().resources().cacheMemory) {
-	//	for (int idx = 0; idx < images.size(); idx++) {
-	//		images.at(idx)->clear();
-	//	}
-	//	return;
-	//}
-
 	int cIdx = findFileIdx(imgC->filePath(), mImages);
-	float mem = 0;
 
 	if (cIdx == -1) {
 		qDebug() << "WARNING: image not found for caching!";
 		return;
 	}
 
-	for (int idx = 0; idx < mImages.size(); idx++) {
-
-		// clear images if they are edited
-		if (idx != cIdx && mImages.at(idx)->isEdited()) {
-			mImages.at(idx)->clear();
-			continue;
-		}
-
-		if (idx >= cIdx-1 && idx <= cIdx+DkSettingsManager::param().resources().maxImagesCached)
-			mem += mImages.at(idx)->getMemoryUsage();
-		else {
-			mImages.at(idx)->clear();
-			continue;
-		}
+	mPrefetcher.update(mImages, cIdx);
 
-		// ignore the last and current one
-		if (idx == cIdx-1 || idx == cIdx) {
-			continue;
-		}
-		// fully load the next image
-		else if (idx == cIdx+1 && mem < DkSettingsManager::param().resources().cacheMemory && mImages.at(idx)->getLoadState() == DkImageContainerT::not_loaded) {
-			mImages.at(idx)->loadImageThreaded();
-			qDebug() << "[Cacher] " << mImages.at(idx)->filePath() << " fully cached...";
-		}
-		else if (idx > cIdx && idx < cIdx+DkSettingsManager::param().resources().maxImagesCached-2 && mem < DkSettingsManager::param().resources().cacheMemory && mImages.at(idx)->getLoadState() == DkImageContainerT::not_loaded) {
-			//dt.getIvl();
-			mImages.at(idx)->fetchFile();		// TODO: crash detected here
-			qDebug() << "[Cacher] " << mImages.at(idx)->filePath() << " file fetched...";
-		}
-	}
+	qDebug() << "[Cacher] " << mPrefetcher.numPendingJobs() << " jobs scheduled (direction: " << mPrefetcher.direction() << ") in: " << dt;
+}
 
-	qDebug() << "cache with: " << mem << " MB created in: " << dt;
+#ifdef Q_OS_WIN
+static QDateTime fileTimeToDateTime(const FILETIME& ft) {
 
+	// 100 ns intervals since 1601-01-01
+	quint64 t = ((quint64)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+	return QDateTime::fromMSecsSinceEpoch((qint64)((t - 116444736000000000ULL) / 10000));
 }
+#endif
 
 /**
  * Returns the file list of the directory dir.
  * Note: this function might get slow if lots of files (> 10000) are in the
  * directory or if the directory is in the net.
- * Currently the file list is sorted according to the system specification.
  * @param dir the directory to load the file list from.
  * @param ignoreKeywords if one of these keywords is in the file name, the file will be ignored.
  * @param keywords if one of these keywords is not in the file name, the file will be ignored.
@@ -1767,132 +2675,100 @@ void DkImageLoader::updateCacher(QSharedPointer<DkImageContainerT> imgC) {
  **/ 
 QFileInfoList DkImageLoader::getFilteredFileInfoList(const QString& dirPath, QStringList ignoreKeywords, QStringList keywords, QString folderKeywords) {
 
-	DkTimer dt;
-
-#ifdef Q_OS_WIN
-
-	QString winPath = QDir::toNativeSeparators(dirPath) + "\\*.*";
-
-	const wchar_t* fname = reinterpret_cast<const wchar_t *>(winPath.utf16());
-
-	WIN32_FIND_DATAW findFileData;
-	HANDLE MyHandle = FindFirstFileW(fname, &findFileData);
-
-	std::vector<std::wstring> fileNameList;
-	std::wstring fileName;
-
-	if( MyHandle != INVALID_HANDLE_VALUE) {
-		
-		do {
-
-			fileName = findFileData.cFileName;
-			fileNameList.push_back(fileName);	// TODO: sort correct according to numbers
-		} while(FindNextFileW(MyHandle, &findFileData) != 0);
-	}
-
-	FindClose(MyHandle);
-	
-	// remove the * in fileFilters
-	QStringList fileFiltersClean = DkSettingsManager::param().app().browseFilters;
-	for (QString& filter : fileFiltersClean)
-		filter.replace("*", "");
+	QFileInfoList fileInfoList;
+	QDir dir(dirPath);
 	
-	//qDebug() << "browse filters: " << DkSettingsManager::param().app().browseFilters;
+	for (const DkDirIndexEntry& e : getFilteredEntries(dirPath, ignoreKeywords, keywords, folderKeywords))
+		fileInfoList.append(QFileInfo(dir, e.fileName()));
 
-	QStringList fileList;
-	std::vector<std::wstring>::iterator lIter = fileNameList.begin();
-
-	// convert to QStringList
-	for (unsigned int idx = 0; idx < fileNameList.size(); idx++, lIter++) {
-		
-		QString qFilename = DkUtils::stdWStringToQString(*lIter);
+	return fileInfoList;
+}
 
-		// believe it or not, but this is 10 times faster than QRegExp
-		// drawback: we also get files that contain *.jpg*
-		for (int i = 0; i < fileFiltersClean.size(); i++) {
+/**
+ * Returns the files of a directory with their sizes and dates.
+ * The directory index is used if the directory did not change.
+ * Otherwise, the directory is listed and indexed.
+ * @param dirPath the directory to load the file list from.
+ * @param ignoreKeywords if one of these keywords is in the file name, the file will be ignored.
+ * @param keywords if one of these keywords is not in the file name, the file will be ignored.
+ * @param folderKeywords the folder filter string.
+ * @return QVector<DkDirIndexEntry> all filtered files of the directory (unsorted).
+ **/ 
+QVector<DkDirIndexEntry> DkImageLoader::getFilteredEntries(const QString& dirPath, const QStringList& ignoreKeywords, const QStringList& keywords, const QString& folderKeywords) {
 
-			if (qFilename.contains(fileFiltersClean[i], Qt::CaseInsensitive)) {
-				fileList.append(qFilename);
-				break;
-			}
-		}
-	}
+	DkTimer dt;
 
-	qInfoClean() << "WinAPI, indexed (" << fileList.size() <<") files in: " << dt;
-#else
+	QVector<DkDirIndexEntry> entries;
 
-	// true file list
-	QDir tmpDir = dirPath;
-	tmpDir.setSorting(QDir::LocaleAware);
-	QStringList fileList = tmpDir.entryList(DkSettingsManager::param().app().browseFilters);
-	qDebug() << fileList;
+	// the directory did not change since we indexed it
+	if (!DkDirIndexManager::instance().entries(dirPath, entries)) {
 
-#endif
+		QDateTime dirModified = QFileInfo(dirPath).lastModified();
 
-	for (int idx = 0; idx < ignoreKeywords.size(); idx++) {
-		QRegExp exp = QRegExp("^((?!" + ignoreKeywords[idx] + ").)*$");
-		exp.setCaseSensitivity(Qt::CaseInsensitive);
-		fileList = fileList.filter(exp);
-	}
+#ifdef Q_OS_WIN
 
-	for (int idx = 0; idx < keywords.size(); idx++) {
-		fileList = fileList.filter(keywords[idx], Qt::CaseInsensitive);
-	}
+		QString winPath = QDir::toNativeSeparators(dirPath) + "\\*.*";
 
-	if (folderKeywords != "") {
-		QStringList filterList = fileList;
-		fileList = DkUtils::filterStringList(folderKeywords, filterList);
-	}
+		const wchar_t* fname = reinterpret_cast<const wchar_t *>(winPath.utf16());
 
-	if (DkSettingsManager::param().resources().filterDuplicats) {
+		// remove the * in fileFilters
+		QStringList fileFiltersClean = DkSettingsManager::param().app().browseFilters;
+		for (QString& filter : fileFiltersClean)
+			filter.replace("*", "");
 
-		QString preferredExtension = DkSettingsManager::param().resources().preferredExtension;
-		preferredExtension = preferredExtension.replace("*.", "");
-		qDebug() << "preferred extension: " << preferredExtension;
+		WIN32_FIND_DATAW findFileData;
+		HANDLE MyHandle = FindFirstFileW(fname, &findFileData);
 
-		QStringList resultList = fileList;
-		fileList.clear();
+		if( MyHandle != INVALID_HANDLE_VALUE) {
 		
-		for (int idx = 0; idx < resultList.size(); idx++) {
-			
-			QFileInfo cFName = QFileInfo(resultList.at(idx));
+			do {
+
+				if (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+					continue;
+
+				QString qFilename = DkUtils::stdWStringToQString(findFileData.cFileName);
+
+				// believe it or not, but this is 10 times faster than QRegExp
+				// drawback: we also get files that contain *.jpg*
+				for (int i = 0; i < fileFiltersClean.size(); i++) {
+
+					if (qFilename.contains(fileFiltersClean[i], Qt::CaseInsensitive)) {
+						
+						// FindFirstFile gives us size & dates for free
+						qint64 size = ((qint64)findFileData.nFileSizeHigh << 32) | findFileData.nFileSizeLow;
+						entries << DkDirIndexEntry(qFilename, size, 
+							fileTimeToDateTime(findFileData.ftLastWriteTime), 
+							fileTimeToDateTime(findFileData.ftCreationTime));
+						break;
+					}
+				}
+			} while(FindNextFileW(MyHandle, &findFileData) != 0);
+		}
 
-			if (preferredExtension.compare(cFName.suffix(), Qt::CaseInsensitive) == 0) {
-				fileList.append(resultList.at(idx));
-				continue;
-			}
+		FindClose(MyHandle);
+	
+		qInfoClean() << "WinAPI, indexed (" << entries.size() <<") files in: " << dt;
+#else
 
-			QString cFBase = cFName.baseName();
-			bool remove = false;
+		// true file list
+		QDir tmpDir = dirPath;
+		QFileInfoList files = tmpDir.entryInfoList(DkSettingsManager::param().app().browseFilters, QDir::Files);
 
-			for (int cIdx = 0; cIdx < resultList.size(); cIdx++) {
+		for (const QFileInfo& fi : files)
+			entries << DkDirIndexEntry::fromFileInfo(fi);
 
-				QString ccBase = QFileInfo(resultList.at(cIdx)).baseName();
+#endif
 
-				if (cIdx != idx && ccBase == cFBase && resultList.at(cIdx).contains(preferredExtension, Qt::CaseInsensitive)) {
-					remove = true;
-					break;
-				}
-			}
-			
-			if (!remove)
-				fileList.append(resultList.at(idx));
-		}
+		DkDirIndexManager::instance().setEntries(dirPath, entries, dirModified);
 	}
 
-	//fileList = sort(fileList, dir);
-
-	QFileInfoList fileInfoList;
-	
-	for (int idx = 0; idx < fileList.size(); idx++)
-		fileInfoList.append(QFileInfo(mCurrentDir, fileList.at(idx)));
-
-	return fileInfoList;
+	return DkDirectoryScanner::filterEntries(entries, ignoreKeywords, keywords, folderKeywords, DkSettingsManager::param().resources().filterDuplicats);
 }
 
 void DkImageLoader::sort() {
 	
-	qSort(mImages.begin(), mImages.end(), imageContainerLessThanPtr);
+	sortImageContainers(mImages);
+	invalidateFileIndex();
 	emit updateDirSignal(mImages);
 }
 
@@ -1953,13 +2829,38 @@ void DkImageLoader::redo() {
 	* Returns the currently loaded image.
 	* @return QImage the current image
 	**/ 
-QImage DkImageLoader::getImage() {
-		
-	if (!mCurrentImage)
-		return QImage();
+/**
+ * Sets the viewport size.
+ * Images are decoded for this size (if the format supports it).
+ * They are decoded in full resolution once they are zoomed.
+ * @param size the viewport size in device pixels
+ **/ 
+void DkImageLoader::setDisplaySize(const QSize& size) {
 
-	return mCurrentImage->image();
-};
+	mDisplaySize = size;
+	mPrefetcher.setDisplaySize(displaySize());
+	updateDisplayDecode();
+}
+
+QSize DkImageLoader::displaySize() const {
+
+	return DkSettingsManager::param().resources().displayDecode ? mDisplaySize : QSize();
+}
+
+/**
+ * Decodes the current image in full resolution if its
+ * display decode does not cover the viewport (anymore).
+ **/ 
+void DkImageLoader::updateDisplayDecode() {
+
+	if (!mCurrentImage || !mCurrentImage->isDownscaled())
+		return;
+
+	QSize ds = mCurrentImage->displaySize();
+
+	if (mDisplaySize.width() > ds.width() || mDisplaySize.height() > ds.height())
+		mCurrentImage->loadFullImageThreaded();
+}
 
 bool DkImageLoader::dirtyTiff() {
 
@@ -30,6 +30,12 @@
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QTimer>
 #include <QImage>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QHash>
+#include <QStringList>
+#include <QSharedPointer>
 #pragma warning(pop)	// no warnings from includes - end
 
 #ifndef DllCoreExport
@@ -44,6 +50,9 @@
 
 // my classes
 #include "DkImageContainer.h"
+#include "DkDirIndex.h"
+
+#include <queue>
 
 #ifdef Q_OS_LINUX
 	typedef  unsigned char byte;
@@ -55,6 +64,140 @@ class QUrl;
 
 namespace nmc {
 
+/**
+ * A prefetch job of the DkPrefetchScheduler.
+ * Jobs with lower priority values are processed first.
+ **/
+class DllCoreExport DkPrefetchJob {
+
+public:
+	enum JobType {
+		job_decode,		// fully decode the image
+		job_fetch,		// just load the file buffer
+
+		job_end
+	};
+
+	DkPrefetchJob(QSharedPointer<DkImageContainerT> imgC = QSharedPointer<DkImageContainerT>(), int type = job_fetch, double priority = 0.0);
+
+	bool operator<(const DkPrefetchJob& o) const;
+
+	QSharedPointer<DkImageContainerT> image() const;
+	int type() const;
+	double priority() const;
+
+protected:
+	QSharedPointer<DkImageContainerT> mImage;
+	int mType = job_fetch;
+	double mPriority = 0.0;
+};
+
+/**
+ * Predictive image prefetching.
+ * The scheduler tracks the browsing direction & speed and keeps
+ * a priority queue of decode/fetch jobs that are ranked by their 
+ * distance to the current image. Jobs that fall out of the 
+ * prefetch window are dropped (or canceled if they are running).
+ **/ 
+class DllCoreExport DkPrefetchScheduler : public QObject {
+	Q_OBJECT
+
+public:
+	DkPrefetchScheduler(QObject* parent = 0);
+
+	void setCursor(const QVector<QSharedPointer<DkImageContainerT> >& images, int cIdx);
+	void update(const QVector<QSharedPointer<DkImageContainerT> >& images, int cIdx);
+	void clear();
+	void setDisplaySize(const QSize& size);
+
+	int direction() const;
+	double speed() const;
+	bool isFastBrowsing() const;
+	int numPendingJobs() const;
+
+public slots:
+	void dispatch();
+
+protected:
+	void windowSize(int& ahead, int& behind) const;
+	bool inWindow(int idx, int cIdx, int numImages) const;
+	void cancelStaleJobs(const QVector<QSharedPointer<DkImageContainerT> >& images, int cIdx);
+
+	std::priority_queue<DkPrefetchJob> mQueue;
+	QVector<DkPrefetchJob> mRunning;
+	QTimer mDispatchTimer;
+	QElapsedTimer mNavTimer;
+
+	int mLastIdx = -1;
+	int mDirection = 1;		// 1 forward, -1 backward
+	double mSpeed = 0.0;	// images per second
+	int mMaxRunning = 2;
+	QSize mDisplaySize;
+};
+
+/**
+ * The results of a single directory scan.
+ * It is shared with the scanning thread, so that a canceled
+ * scan can run out without touching the scanner.
+ **/ 
+class DllCoreExport DkScanState : public QObject {
+	Q_OBJECT
+
+public:
+	void addFiles(const QVector<DkDirIndexEntry>& entries);
+	QVector<DkDirIndexEntry> takeFiles();
+
+	QAtomicInt canceled;		// polled by the scanning thread
+
+signals:
+	void filesFound() const;
+
+protected:
+	QMutex mMutex;
+	QVector<DkDirIndexEntry> mFiles;	// files found since the last takeFiles() call
+};
+
+/**
+ * Streaming directory enumeration.
+ * The directory is listed in a background thread and filtered
+ * files are handed over in batches (see filesFound()), so that the
+ * first files can be shown long before a large (or remote) folder
+ * is indexed completely.
+ **/ 
+class DllCoreExport DkDirectoryScanner : public QObject {
+	Q_OBJECT
+
+public:
+	DkDirectoryScanner(QObject* parent = 0);
+	virtual ~DkDirectoryScanner();
+
+	void scan(const QString& dirPath, const QStringList& ignoreKeywords = QStringList(), const QStringList& keywords = QStringList(), const QString& folderKeywords = QString());
+	void cancel();
+
+	bool isScanning() const;
+	QString dirPath() const;
+	QVector<DkDirIndexEntry> takeFiles();
+
+	static QStringList filterFiles(const QStringList& fileList, const QStringList& ignoreKeywords, const QStringList& keywords, const QString& folderKeywords);
+	static QStringList filterDuplicates(const QStringList& fileList);
+	static QVector<DkDirIndexEntry> filterEntries(const QVector<DkDirIndexEntry>& entries, const QStringList& ignoreKeywords, const QStringList& keywords, const QString& folderKeywords, bool duplicates = false);
+
+signals:
+	void filesFound() const;
+	void scanFinished() const;
+
+protected slots:
+	void scanDone();
+
+protected:
+	static void scanIntern(QSharedPointer<DkScanState> state, const QString& dirPath, const QStringList& ignoreKeywords, const QStringList& keywords, const QString& folderKeywords);
+
+	QFutureWatcher<void> mScanWatcher;
+	QString mDirPath;
+	bool mScanning = false;
+	QSharedPointer<DkScanState> mState;		// shared with the scanning thread
+};
+
 /**
  * This class is a basic image loader class.
  * It takes care of the file watches for the current folder,
@@ -73,6 +216,7 @@ public:
 	static QStringList getFoldersRecursive(const QString& dirPath);
 	QFileInfoList updateSubFolders(const QString& rootDirPath);
 	QFileInfoList getFilteredFileInfoList(const QString& dirPath, QStringList ignoreKeywords = QStringList(), QStringList keywords = QStringList(), QString folderKeywords = QString());
+	QVector<DkDirIndexEntry> getFilteredEntries(const QString& dirPath, const QStringList& ignoreKeywords = QStringList(), const QStringList& keywords = QStringList(), const QString& folderKeywords = QString());
 
 	void rotateImage(double angle);
 	QSharedPointer<DkImageContainerT> getCurrentImage() const;
@@ -112,9 +256,11 @@ public:
 	void activate(bool isActive = true);
 	bool hasImage() const;
 	bool isEdited() const;
+	bool isScanning() const;
 	int numFiles() const;
-	QImage getImage();
 	bool dirtyTiff();
+	void setDisplaySize(const QSize& size);
+	QSize displaySize() const;
 
 	QStringList ignoreKeywords() const;
 	void setIgnoreKeywords(const QStringList& ignoreKeywords);
@@ -168,6 +314,10 @@ public slots:
 	void imageLoaded(bool loaded = false);
 	void imageSaved(const QString& file, bool saved = true);
 	void imagesSorted();
+	void filesScanned();
+	void dirScanned();
+	void loadPendingFile();
+	void filesChanged(const QString& dirPath, const QStringList& added, const QStringList& removed, const QStringList& modified);
 	bool unloadFile();
 	void reloadImage();
 
@@ -179,6 +329,13 @@ protected:
 	void updateHistory();
 	void sortImagesThreaded(QVector<QSharedPointer<DkImageContainerT > > images);
 	void createImages(const QFileInfoList& files, bool sort = true);
+	void createImages(const QString& dirPath, const QVector<DkDirIndexEntry>& entries, bool sort = true);
+	void appendImages(const QString& dirPath, const QVector<DkDirIndexEntry>& entries);
+	void clearPendingFile();
+	void updateDirWatcher();
+	void updateDisplayDecode();
+	const QHash<QString, int>& fileIndex() const;
+	void invalidateFileIndex() const;
 	QVector<QSharedPointer<DkImageContainerT > > sortImages(QVector<QSharedPointer<DkImageContainerT > > images) const;
 
 	QStringList mIgnoreKeywords;
@@ -190,15 +347,24 @@ protected:
 	QString mCurrentDir;
 	QString mSaveDir;
 	QFileSystemWatcher* mDirWatcher = 0;
+	QString mWatchedDir;
 	QStringList mSubFolders;
 	QVector<QSharedPointer<DkImageContainerT > > mImages;
+	mutable QHash<QString, int> mFileIndex;		// file path -> index in mImages
+	mutable bool mFileIndexDirty = true;
 	QSharedPointer<DkImageContainerT > mCurrentImage;
 	QSharedPointer<DkImageContainerT > mLastImageLoaded;
+	QSize mDisplaySize;		// viewport size in device pixels
 	bool mFolderUpdated = false;
 	int mTmpFileIdx = 0;
+	int mPendingSkip = 0;		// navigation requested while the folder is listed
+	int mPendingIdx = -1;		// file index requested while the folder is listed (-1: none)
+	bool mPendingLast = false;	// the last file was requested while the folder is listed
 	bool mSortingImages = false;
 	bool mSortingIsDirty = false;
 	QFutureWatcher<QVector<QSharedPointer<DkImageContainerT > > > mCreateImageWatcher;
+	DkPrefetchScheduler mPrefetcher;
+	DkDirectoryScanner mScanner;
 
 };
 
@@ -31,6 +31,7 @@
 #include "DkTimer.h"
 #include "DkMath.h"
 #include "DkThumbs.h"
+#include "DkTiledImage.h"
 
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QDebug>
@@ -1552,6 +1553,28 @@ void DkImageStorage::setImage(const QImage& img) {
 	mStop = true;
 	mImgs.clear();	// is it save (if the thread is still working?)
 	mImg = img;
+
+	// we don't downscale huge images (panoramas, slide scans) - visible tiles are computed instead
+	if (DkTilePyramid::needsTiles(img.size()))
+		mTiles = QSharedPointer<DkTilePyramid>(new DkTilePyramid(QSharedPointer<DkTileSource>(new DkImageTileSource(img))));
+	else
+		mTiles.clear();
+}
+
+/**
+ * Draws tiles of source instead of the current image.
+ * The current image is used as preview - this allows for showing
+ * images that are too large to be decoded (see DkViewPort::loadFullImage).
+ * @param source the tile source
+ **/ 
+void DkImageStorage::setTileSource(QSharedPointer<DkTileSource> source) {
+
+	mTiles = QSharedPointer<DkTilePyramid>(new DkTilePyramid(source, mImg));
+	emit imageUpdated();
+}
+
+QSharedPointer<DkTilePyramid> DkImageStorage::tiles() const {
+	return mTiles;
 }
 
 void DkImageStorage::antiAliasingChanged(bool antiAliasing) {
@@ -1575,7 +1598,8 @@ QImage DkImageStorage::getImageConst() const {
 
 QImage DkImageStorage::getImage(float factor) {
 
-	if (factor >= 0.5f || mImg.isNull() || !DkSettingsManager::param().display().antiAliasing)
+	if (factor >= 0.5f || mImg.isNull() || !DkSettingsManager::param().display().antiAliasing || 
+		DkTilePyramid::needsTiles(mImg.size()))
 		return mImg;
 
 	// check if we have an image similar to that requested
@@ -1612,9 +1636,8 @@ void DkImageStorage::computeImage() {
 	while (iSize.width() > 2*1920 && iSize.height() > 2*1920)	// in general we need less than 200 ms for the whole downscaling if we start at 1500 x 1500
 		iSize *= 0.5;
 
-	// for extreme panorama images the Qt scaling crashes (if we have a width > 30000) so we simply 
-	if (qMax(iSize.width(), iSize.height()) < 20000)
-		resizedImg = resizedImg.scaled(iSize, Qt::KeepAspectRatio, Qt::FastTransformation);
+	// huge images are tiled (see DkTilePyramid) - they never get here
+	resizedImg = resizedImg.scaled(iSize, Qt::KeepAspectRatio, Qt::FastTransformation);
 
 	// it would be pretty strange if we needed more than 30 sub-images
 	for (int idx = 0; idx < 30; idx++) {
@@ -33,6 +33,7 @@
 #include <QVector>
 #include <QObject>
 #include <QColor>
+#include <QSharedPointer>
 
 // opencv
 #ifdef WITH_OPENCV
@@ -66,6 +67,8 @@ class QColor;
 namespace nmc {
 
 class DkRotatingRect;
+class DkTilePyramid;
+class DkTileSource;
 
 /**
  * DkImage holds some basic image processing
@@ -154,6 +157,9 @@ public:
 		return !mImg.isNull();
 	}
 
+	void setTileSource(QSharedPointer<DkTileSource> source);
+	QSharedPointer<DkTilePyramid> tiles() const;
+
 public slots:
 	void computeImage();
 	void antiAliasingChanged(bool antiAliasing);
@@ -165,6 +171,7 @@ signals:
 protected:
 	QImage mImg;
 	QVector<QImage> mImgs;
+	QSharedPointer<DkTilePyramid> mTiles;	// large images are drawn tile by tile
 
 	QMutex mMutex;
 	QThread* mComputeThread = 0;
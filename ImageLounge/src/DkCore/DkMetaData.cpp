@@ -26,6 +26,7 @@
  *******************************************************************************************************/
 
 #include "DkMetaData.h"
+#include "DkBasicLoader.h"
 #include "DkUtils.h"
 #include "DkMath.h"
 #include "DkImageStorage.h"
@@ -39,6 +40,8 @@
 #include <QBuffer>
 #include <QVector2D>
 #include <QApplication>
+#include <QFile>
+#include <QtEndian>
 #pragma warning(pop)		// no warnings from includes - end
 
 namespace nmc {
@@ -60,7 +63,9 @@ void DkMetaDataT::readMetaData(const QString& filePath, QSharedPointer<QByteArra
 	QFileInfo fileInfo(filePath);
 
 	try {
-		if (!ba || ba->isEmpty()) {
+		// exiv2 reads lazily - it must not read from mapped files (see DkFileBuffer)
+		if (!ba || ba->isEmpty() || DkFileBuffer::isMapped(ba)) {
+			mExifBuffer.clear();
 #ifdef EXV_UNICODE_PATH
 #if QT_VERSION < 0x050000
 			// it was crashing here - if the thumbnail is fetched in the constructor of a label
@@ -79,6 +84,7 @@ void DkMetaDataT::readMetaData(const QString& filePath, QSharedPointer<QByteArra
 		else {
 			Exiv2::MemIo::AutoPtr exifBuffer(new Exiv2::MemIo((const byte*)ba->constData(), ba->size()));
 			mExifImg = Exiv2::ImageFactory::open(exifBuffer);
+			mExifBuffer = ba;	// exiv2 reads from it
 		}
 	} 
 	catch (...) {
@@ -136,9 +142,10 @@ bool DkMetaDataT::saveMetaData(const QString& filePath, bool force) {
 		return false;
 	}
 
-	file.open(QFile::WriteOnly);
-	file.write(ba->data(), ba->size());
-	file.close();
+	if (DkFileBuffer::write(filePath, *ba) == -1) {
+		qDebug() << "[DkMetaDataT] could not save: " << QFileInfo(filePath).fileName();
+		return false;
+	}
 
 	qDebug() << "[DkMetaDataT] I saved: " << ba->size() << " bytes";
 
@@ -164,7 +171,8 @@ bool DkMetaDataT::saveMetaData(QSharedPointer<QByteArray>& ba, bool force) {
 
 	try {
 
-		exifMem = Exiv2::MemIo::AutoPtr(new Exiv2::MemIo((byte*)ba->data(), ba->size()));
+		// MemIo copies on write - so we do not need to detach the buffer
+		exifMem = Exiv2::MemIo::AutoPtr(new Exiv2::MemIo((const byte*)ba->constData(), ba->size()));
 		exifImgN = Exiv2::ImageFactory::open(exifMem);
 	} 
 	catch (...) {
@@ -200,6 +208,7 @@ bool DkMetaDataT::saveMetaData(QSharedPointer<QByteArray>& ba, bool force) {
 	else
 		return false;
 
+	mExifBuffer.clear();	// MemIo owns its data after writing
 	mExifImg = exifImgN;
 	mExifState = loaded;
 
@@ -254,18 +263,7 @@ int DkMetaDataT::getOrientationDegree() const {
 			if (pos != exifData.end() && pos->count() != 0) {
 			
 				Exiv2::Value::AutoPtr v = pos->getValue();
-				orientation = (int)pos->toFloat();
-
-				switch (orientation) {
-				case 6:		orientation = 90;	break;
-				case 7:		orientation = 90;	break;
-				case 3:		orientation = 180;	break;
-				case 4:		orientation = 180;	break;
-				case 8:		orientation = -90;	break;
-				case 5:		orientation = -90;	break;
-				case 1:		orientation = 0; 	break;
-				default:	orientation = -1;	break;
-				}	
+				orientation = orientationToDegree((int)pos->toFloat());
 			}
 		}
 	}
@@ -276,6 +274,26 @@ int DkMetaDataT::getOrientationDegree() const {
 	return orientation;
 }
 
+/**
+ * Converts the EXIF orientation to degrees.
+ * @param orientation the EXIF orientation (1-8)
+ * @return int the rotation in degrees (-1 if the orientation is illegal)
+ **/ 
+int DkMetaDataT::orientationToDegree(int orientation) {
+
+	switch (orientation) {
+	case 6:		return 90;
+	case 7:		return 90;
+	case 3:		return 180;
+	case 4:		return 180;
+	case 8:		return -90;
+	case 5:		return -90;
+	case 1:		return 0;
+	}
+
+	return -1;
+}
+
 DkMetaDataT::ExifOrientationState DkMetaDataT::checkExifOrientation() const {
 
 	if (mExifState != loaded && mExifState != dirty)
@@ -1444,6 +1462,219 @@ bool DkMetaDataT::setXMPValue(Exiv2::XmpData& xmpData, QString xmpKey, QString x
 //	xmpSidecar->writeMetadata();
 //}
 
+// DkExifThumb --------------------------------------------------------------------
+/**
+ * Reads the thumbnail and orientation of an image.
+ * @param filePath the image's file path
+ * @param ba the file buffer (the file is opened if it's empty)
+ * @return bool true if the file has an EXIF structure
+ **/ 
+bool DkExifThumb::read(const QString& filePath, QSharedPointer<QByteArray> ba) {
+
+	if (ba && !ba->isEmpty()) {
+		QBuffer buffer(ba.data());
+		buffer.open(QIODevice::ReadOnly);
+		return read(buffer);
+	}
+
+	QFile file(filePath);
+	
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	return read(file);
+}
+
+/**
+ * Reads the thumbnail and orientation from a device.
+ * Just the EXIF header and the thumbnail are read.
+ * @param device the (random access) device
+ * @return bool true if the device has an EXIF structure
+ **/ 
+bool DkExifThumb::read(QIODevice& device) {
+
+	mThumbData.clear();
+	mOrientation = 0;
+	mValid = false;
+
+	if (!device.seek(0))
+		return false;
+
+	QByteArray magic = device.read(4);
+
+	if (magic.size() < 4)
+		return false;
+
+	// tif, nef, cr2, arw
+	if ((magic[0] == 'I' && magic[1] == 'I') || (magic[0] == 'M' && magic[1] == 'M'))
+		return readTiff(device, 0);
+
+	// no jpg
+	if ((uchar)magic[0] != 0xFF || (uchar)magic[1] != 0xD8)
+		return false;
+
+	// walk the jpg segments until we find the EXIF segment (APP1)
+	qint64 pos = 2;
+
+	for (int idx = 0; idx < 256; idx++) {
+
+		if (!device.seek(pos))
+			return false;
+
+		QByteArray header = device.read(4);
+
+		if (header.size() < 4 || (uchar)header[0] != 0xFF)
+			return false;
+
+		uchar marker = (uchar)header[1];
+
+		// fill bytes
+		if (marker == 0xFF) {
+			pos++;
+			continue;
+		}
+
+		// the image data starts - there is no EXIF segment
+		if (marker == 0xDA || marker == 0xD9)
+			return false;
+
+		int length = ((uchar)header[2] << 8) | (uchar)header[3];
+
+		if (marker == 0xE1 && device.read(6) == QByteArray("Exif\0\0", 6))
+			return readTiff(device, pos + 10);
+
+		pos += 2 + length;
+	}
+
+	return false;
+}
+
+bool DkExifThumb::readTiff(QIODevice& device, qint64 base) {
+
+	if (!device.seek(base))
+		return false;
+
+	QByteArray header = device.read(8);
+
+	if (header.size() < 8)
+		return false;
+
+	bool le = header[0] == 'I' && header[1] == 'I';
+
+	if (!le && !(header[0] == 'M' && header[1] == 'M'))
+		return false;
+
+	const uchar* h = (const uchar*)header.constData();
+	quint16 magic = le ? qFromLittleEndian<quint16>(h + 2) : qFromBigEndian<quint16>(h + 2);
+	quint32 ifd0 = le ? qFromLittleEndian<quint32>(h + 4) : qFromBigEndian<quint32>(h + 4);
+
+	if (magic != 42)
+		return false;
+
+	QMap<quint16, quint32> ifd0Values;
+	quint32 ifd1 = 0;
+
+	if (!readIfd(device, base, ifd0, le, ifd0Values, ifd1))
+		return false;
+
+	mValid = true;
+	mOrientation = ifd0Values.value(0x0112, 0);	// Exif.Image.Orientation
+
+	QMap<quint16, quint32> ifd1Values;
+	quint32 next = 0;
+
+	if (ifd1 == 0 || !readIfd(device, base, ifd1, le, ifd1Values, next))
+		return true;
+
+	// Exif.Thumbnail.JPEGInterchangeFormat(Length)
+	quint32 thumbOffset = ifd1Values.value(0x0201, 0);
+	quint32 thumbLength = ifd1Values.value(0x0202, 0);
+
+	if (thumbOffset == 0 || thumbLength == 0 || base + thumbOffset + thumbLength > device.size())
+		return true;
+
+	if (device.seek(base + thumbOffset))
+		mThumbData = device.read(thumbLength);
+
+	if (mThumbData.size() != (int)thumbLength)
+		mThumbData.clear();
+
+	return true;
+}
+
+/**
+ * Reads the SHORT and LONG values of an IFD.
+ * @param device the device
+ * @param base the TIFF header's position (offsets are relative to it)
+ * @param offset the IFD's offset
+ * @param littleEndian the byte order
+ * @param values the values (tag, value)
+ * @param next the offset of the next IFD (0 if there is none)
+ * @return bool false if the IFD cannot be read
+ **/ 
+bool DkExifThumb::readIfd(QIODevice& device, qint64 base, quint32 offset, bool littleEndian, QMap<quint16, quint32>& values, quint32& next) const {
+
+	if (offset == 0 || !device.seek(base + offset))
+		return false;
+
+	QByteArray countBytes = device.read(2);
+
+	if (countBytes.size() < 2)
+		return false;
+
+	const uchar* c = (const uchar*)countBytes.constData();
+	int numEntries = littleEndian ? qFromLittleEndian<quint16>(c) : qFromBigEndian<quint16>(c);
+
+	QByteArray entries = device.read(numEntries * 12 + 4);
+
+	if (entries.size() != numEntries * 12 + 4)
+		return false;
+
+	const uchar* e = (const uchar*)entries.constData();
+
+	for (int idx = 0; idx < numEntries; idx++, e += 12) {
+
+		quint16 tag = littleEndian ? qFromLittleEndian<quint16>(e) : qFromBigEndian<quint16>(e);
+		quint16 type = littleEndian ? qFromLittleEndian<quint16>(e + 2) : qFromBigEndian<quint16>(e + 2);
+
+		// SHORT & LONG values are stored in the entry
+		if (type == 3)
+			values.insert(tag, littleEndian ? qFromLittleEndian<quint16>(e + 8) : qFromBigEndian<quint16>(e + 8));
+		else if (type == 4)
+			values.insert(tag, littleEndian ? qFromLittleEndian<quint32>(e + 8) : qFromBigEndian<quint32>(e + 8));
+	}
+
+	next = littleEndian ? qFromLittleEndian<quint32>(e) : qFromBigEndian<quint32>(e);
+
+	return true;
+}
+
+bool DkExifThumb::isValid() const {
+	return mValid;
+}
+
+QImage DkExifThumb::thumbnail() const {
+
+	QImage thumb;
+
+	if (!mThumbData.isEmpty())
+		thumb.loadFromData(mThumbData);
+
+	return thumb;
+}
+
+QByteArray DkExifThumb::thumbnailData() const {
+	return mThumbData;
+}
+
+int DkExifThumb::orientation() const {
+	return mOrientation;
+}
+
+int DkExifThumb::orientationDegree() const {
+	return mOrientation ? DkMetaDataT::orientationToDegree(mOrientation) : 0;
+}
+
 // DkMetaDataHelper --------------------------------------------------------------------
 void DkMetaDataHelper::init() {
 
@@ -65,6 +65,7 @@ typedef unsigned char byte;
 // Qt defines
 class QVector2D;
 class QImage;
+class QIODevice;
 
 namespace nmc {
 
@@ -117,6 +118,7 @@ public:
 	void setThumbnail(QImage thumb);
 	void setQtValues(const QImage& cImg);
 	static QString exiv2ToQString(std::string exifString);
+	static int orientationToDegree(int orientation);
 	void setUseSidecar(bool useSideCar = false);
 
 	bool hasMetaData() const;
@@ -145,6 +147,7 @@ protected:
 	};
 
 	Exiv2::Image::AutoPtr mExifImg;
+	QSharedPointer<QByteArray> mExifBuffer;	// keeps the buffer mExifImg reads from alive
 	QString mFilePath;
 	QStringList mQtKeys;
 	QStringList mQtValues;
@@ -153,6 +156,33 @@ protected:
 	bool mUseSidecar = false;
 };
 
+/**
+ * Reads the EXIF thumbnail without Exiv2.
+ * JPG files are scanned for their EXIF segment. TIFF based files
+ * (tif, nef, cr2, arw) are read directly. Just IFD0 (orientation) and
+ * IFD1 (thumbnail) are parsed - the makernotes are never touched.
+ **/ 
+class DllCoreExport DkExifThumb {
+
+public:
+	bool read(const QString& filePath, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+	bool read(QIODevice& device);
+
+	bool isValid() const;
+	QImage thumbnail() const;
+	QByteArray thumbnailData() const;
+	int orientation() const;
+	int orientationDegree() const;
+
+protected:
+	bool readTiff(QIODevice& device, qint64 base);
+	bool readIfd(QIODevice& device, qint64 base, quint32 offset, bool littleEndian, QMap<quint16, quint32>& values, quint32& next) const;
+
+	QByteArray mThumbData;
+	int mOrientation = 0;		// exif orientation (1-8), 0 if not set
+	bool mValid = false;		// true if the exif structure was found
+};
+
 class DllCoreExport DkMetaDataHelper {
 
 public:
@@ -0,0 +1,391 @@
+/*******************************************************************************************************
+ DkMovie.cpp
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkMovie.h"
+
+#include "DkThreadPools.h"
+#include "DkTimer.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QAtomicInt>
+#include <QDebug>
+#include <QImageReader>
+#include <QScopedPointer>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace nmc {
+
+// DkMovieFrame --------------------------------------------------------------------
+DkMovieFrame::DkMovieFrame(int index, const QImage& img, int delay) {
+
+	mIndex = index;
+	mImg = img;
+	mDelay = delay;
+}
+
+int DkMovieFrame::index() const {
+	return mIndex;
+}
+
+QImage DkMovieFrame::image() const {
+	return mImg;
+}
+
+int DkMovieFrame::delay() const {
+	return mDelay;
+}
+
+// DkFrameDecoder --------------------------------------------------------------------
+/**
+ * Decodes frames of an animation sequentially.
+ * Frames depend on their predecessors (e.g. gif disposal), hence 
+ * seeking backwards restarts the reader. The decoder is shared
+ * with the decoding thread - just one thread uses it at a time.
+ **/ 
+class DkFrameDecoder {
+
+public:
+	DkFrameDecoder(const QString& filePath) {
+		mFilePath = filePath;
+		restart();
+	};
+
+	QVector<DkMovieFrame> decode(int from, int count) {
+
+		QVector<DkMovieFrame> frames;
+
+		if (from < mNext)
+			restart();
+
+		// skip preceding frames
+		while (mNext < from) {
+
+			if (isCanceled() || mReader->read().isNull())
+				return frames;
+			mNext++;
+		}
+
+		for (int idx = 0; idx < count && !isCanceled(); idx++) {
+
+			QImage img = mReader->read();
+
+			if (img.isNull())
+				break;
+
+			// drawing premultiplied pixmaps is fast
+			frames << DkMovieFrame(mNext, img.convertToFormat(QImage::Format_ARGB32_Premultiplied), mReader->nextImageDelay());
+			mNext++;
+		}
+
+		return frames;
+	};
+
+	void cancel() {
+		mCanceled.storeRelease(1);
+	};
+
+	bool isCanceled() const {
+		return mCanceled.loadAcquire() != 0;
+	};
+
+protected:
+	void restart() {
+		mReader.reset(new QImageReader(mFilePath));
+		mNext = 0;
+	};
+
+	QString mFilePath;
+	QScopedPointer<QImageReader> mReader;
+	int mNext = 0;		// the frame that is read next
+	QAtomicInt mCanceled;
+};
+
+// DkMovie --------------------------------------------------------------------
+DkMovie::DkMovie(const QString& filePath, QObject* parent) : QObject(parent) {
+
+	QImageReader reader(filePath);
+
+	if (!reader.canRead() || !reader.supportsAnimation())
+		return;
+
+	QSize size = reader.size();
+	mFrameCount = qMax(reader.imageCount(), 0);
+	mLoopCount = reader.loopCount();
+
+	// how many frames can we keep?
+	qint64 frameBytes = size.isValid() ? (qint64)size.width() * size.height() * 4 : 4 * 1024 * 1024;
+	mCapacity = (int)qMax((qint64)8, (qint64)maxMemory * 1024 * 1024 / qMax(frameBytes, (qint64)1));
+	mFrames.resize(mFrameCount);
+
+	mDecoder = QSharedPointer<DkFrameDecoder>(new DkFrameDecoder(filePath));
+
+	mTimer.setSingleShot(true);
+	connect(&mTimer, SIGNAL(timeout()), this, SLOT(playNextFrame()));
+	connect(&mDecodeWatcher, SIGNAL(finished()), this, SLOT(framesDecoded()));
+
+	qDebug() << "[DkMovie]" << mFrameCount << "frames, buffering" << qMin(mCapacity, mFrameCount ? mFrameCount : mCapacity);
+}
+
+DkMovie::~DkMovie() {
+
+	// the decoder finishes its batch and is deleted with the last reference
+	if (mDecoder)
+		mDecoder->cancel();
+}
+
+bool DkMovie::isValid() const {
+	return !mPixmap.isNull();
+}
+
+int DkMovie::frameCount() const {
+	return mFrameCount;
+}
+
+int DkMovie::currentFrameNumber() const {
+	return mCurrent;
+}
+
+QImage DkMovie::currentImage() const {
+
+	if (mCurrent < 0 || mCurrent >= mFrames.size())
+		return QImage();
+
+	return mFrames[mCurrent].image();
+}
+
+QPixmap DkMovie::currentPixmap() const {
+	return mPixmap;
+}
+
+QRect DkMovie::frameRect() const {
+	return mPixmap.rect();
+}
+
+void DkMovie::start() {
+
+	mPlaying = true;
+	mPaused = false;
+	mLoops = 0;
+
+	jumpToFrame(mCurrent == -1 ? 0 : mCurrent);
+}
+
+void DkMovie::stop() {
+
+	mPlaying = false;
+	mTimer.stop();
+}
+
+void DkMovie::setPaused(bool paused) {
+
+	mPaused = paused;
+
+	if (paused)
+		mTimer.stop();
+	else if (mPlaying)
+		playNextFrame();
+}
+
+void DkMovie::jumpToNextFrame() {
+
+	jumpToFrame(nextFrameNumber(mCurrent));
+}
+
+void DkMovie::jumpToPreviousFrame() {
+
+	int frameNumber = mCurrent - 1;
+
+	if (frameNumber < 0)
+		frameNumber = mFrameCount > 0 ? mFrameCount - 1 : 0;
+
+	jumpToFrame(frameNumber);
+}
+
+void DkMovie::playNextFrame() {
+
+	int frameNumber = nextFrameNumber(mCurrent);
+
+	// stop if we looped often enough
+	if (frameNumber == 0 && mLoopCount != -1 && ++mLoops > mLoopCount) {
+		mPlaying = false;
+		return;
+	}
+
+	jumpToFrame(frameNumber);
+}
+
+/**
+ * Shows a frame.
+ * If the frame is not decoded yet, it is shown as soon as it arrives.
+ * @param frameNumber the frame
+ **/ 
+void DkMovie::jumpToFrame(int frameNumber) {
+
+	mRequested = frameNumber;
+
+	if (frameNumber >= 0 && frameNumber < mFrames.size() && !mFrames[frameNumber].image().isNull()) {
+
+		const DkMovieFrame& frame = mFrames[frameNumber];
+
+		mCurrent = frameNumber;
+		mPixmap = QPixmap::fromImage(frame.image());
+
+		if (mPlaying && !mPaused)
+			mTimer.start(qMax(frame.delay(), 20));	// browsers do the same for 0 ms delays
+
+		emit frameChanged(mCurrent);
+	}
+
+	evictFrames();
+	decodeAhead();
+}
+
+/**
+ * Decodes the next missing frame in the window ahead of the requested frame.
+ **/ 
+void DkMovie::decodeAhead() {
+
+	if (!mDecoder || mDecodeWatcher.isRunning())
+		return;
+
+	const int ahead = mCapacity - mCapacity / 4 - 1;
+	int from = -1;
+
+	for (int idx = 0; idx <= ahead; idx++) {
+
+		int frameNumber = mRequested + idx;
+
+		if (mFrameCount > 0)
+			frameNumber %= mFrameCount;
+
+		if (frameNumber >= mFrames.size() || mFrames[frameNumber].image().isNull()) {
+			from = frameNumber;
+			break;
+		}
+
+		// all frames are buffered
+		if (mFrameCount > 0 && idx == mFrameCount - 1)
+			break;
+	}
+
+	if (from == -1 || (mFrameCount > 0 && from >= mFrameCount))
+		return;
+
+	QSharedPointer<DkFrameDecoder> decoder = mDecoder;
+	mDecodeFrom = from;
+
+	mDecodeWatcher.setFuture(DkThreadPools::instance().run(DkThreadPools::lane_current_decode, [decoder, from]() {
+		return decoder->decode(from, batchSize);
+	}));
+}
+
+void DkMovie::framesDecoded() {
+
+	QVector<DkMovieFrame> frames = mDecodeWatcher.result();
+
+	// the reader stopped - now we know the frame count
+	if (frames.size() < batchSize && !mDecoder->isCanceled()) {
+
+		int last = frames.empty() ? mDecodeFrom : frames.last().index() + 1;
+
+		if (last == 0) {
+			qWarning() << "[DkMovie] could not decode any frame";
+			mDecoder.clear();
+			return;
+		}
+
+		if (mFrameCount == 0 || last < mFrameCount) {
+			mFrameCount = last;
+			mFrames.resize(mFrameCount);
+		}
+
+		// we ran past the last frame - loop
+		if (mRequested >= mFrameCount)
+			mRequested = 0;
+	}
+
+	for (const DkMovieFrame& f : frames) {
+
+		if (f.index() >= mFrames.size())
+			mFrames.resize(f.index() + 1);
+
+		mFrames[f.index()] = f;
+	}
+
+	// show the frame we are waiting for
+	if (mRequested != mCurrent && mRequested < mFrames.size() && !mFrames[mRequested].image().isNull())
+		jumpToFrame(mRequested);
+	else {
+		evictFrames();
+		decodeAhead();
+	}
+}
+
+void DkMovie::evictFrames() {
+
+	for (int idx = 0; idx < mFrames.size(); idx++) {
+
+		if (!inWindow(idx) && !mFrames[idx].image().isNull())
+			mFrames[idx] = DkMovieFrame();
+	}
+}
+
+/**
+ * Returns true if a frame should be buffered.
+ * The window reaches 1/4 of the capacity behind and the rest
+ * ahead of the requested frame (wrapping around if the frame count is known).
+ * @param frameNumber the frame
+ * @return bool true if the frame is within the buffer window
+ **/ 
+bool DkMovie::inWindow(int frameNumber) const {
+
+	if (mFrameCount > 0 && mFrameCount <= mCapacity)
+		return true;
+
+	int behind = mCapacity / 4;
+	int ahead = mCapacity - behind - 1;
+	int d = frameNumber - mRequested;
+
+	if (mFrameCount > 0) {
+		d = (d + mFrameCount) % mFrameCount;
+		return d <= ahead || mFrameCount - d <= behind;
+	}
+
+	return d <= ahead && -d <= behind;
+}
+
+int DkMovie::nextFrameNumber(int frameNumber) const {
+
+	frameNumber++;
+
+	if (mFrameCount > 0 && frameNumber >= mFrameCount)
+		frameNumber = 0;
+
+	return frameNumber;
+}
+
+};
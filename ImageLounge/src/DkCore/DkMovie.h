@@ -0,0 +1,136 @@
+/*******************************************************************************************************
+ DkMovie.h
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QFutureWatcher>
+#include <QImage>
+#include <QPixmap>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QVector>
+#pragma warning(pop)		// no warnings from includes - end
+
+#pragma warning(disable: 4251)	// TODO: remove
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+namespace nmc {
+
+// nomacs defines
+class DkFrameDecoder;
+
+class DllCoreExport DkMovieFrame {
+
+public:
+	DkMovieFrame(int index = -1, const QImage& img = QImage(), int delay = 0);
+
+	int index() const;
+	QImage image() const;
+	int delay() const;
+
+protected:
+	int mIndex;
+	QImage mImg;
+	int mDelay;		// ms
+};
+
+/**
+ * Plays animated images (gif, webp, mng).
+ * Other than QMovie, decoded frames are kept in a ring buffer
+ * around the current frame. Frames are decoded ahead in the
+ * background, so playback does not wait for the decoder and
+ * stepping forward/backward within the buffer is O(1).
+ * If all frames fit into maxMemory (most animations), frames
+ * are decoded just once.
+ **/ 
+class DllCoreExport DkMovie : public QObject {
+	Q_OBJECT
+
+public:
+	DkMovie(const QString& filePath, QObject* parent = 0);
+	virtual ~DkMovie();
+
+	bool isValid() const;
+	int frameCount() const;
+	int currentFrameNumber() const;
+	QImage currentImage() const;
+	QPixmap currentPixmap() const;
+	QRect frameRect() const;
+
+	static const int maxMemory = 256;	// MB
+	static const int batchSize = 4;		// frames decoded per job
+
+public slots:
+	void start();
+	void stop();
+	void setPaused(bool paused);
+	void jumpToNextFrame();
+	void jumpToPreviousFrame();
+
+signals:
+	void frameChanged(int frameNumber) const;
+
+protected slots:
+	void playNextFrame();
+	void framesDecoded();
+
+protected:
+	void jumpToFrame(int frameNumber);
+	void decodeAhead();
+	void evictFrames();
+	bool inWindow(int frameNumber) const;
+	int nextFrameNumber(int frameNumber) const;
+
+	QSharedPointer<DkFrameDecoder> mDecoder;
+	QFutureWatcher<QVector<DkMovieFrame> > mDecodeWatcher;
+
+	QVector<DkMovieFrame> mFrames;	// indexed by frame number - frames outside the window are null
+	int mFrameCount = 0;			// 0 if unknown
+	int mCapacity = 0;				// frames that fit into maxMemory
+	int mCurrent = -1;
+	int mRequested = 0;				// frame that is shown once it is decoded
+	int mDecodeFrom = 0;			// first frame of the running job
+	int mLoopCount = -1;			// -1 = forever
+	int mLoops = 0;
+
+	QPixmap mPixmap;
+	QTimer mTimer;
+	bool mPlaying = false;
+	bool mPaused = false;
+};
+
+};
@@ -0,0 +1,186 @@
+/*******************************************************************************************************
+ DkRawCache.cpp
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkRawCache.h"
+
+#include "DkSettings.h"
+#include "DkThreadPools.h"
+#include "DkTimer.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace nmc {
+
+// DkRawCache --------------------------------------------------------------------
+DkRawCache::DkRawCache() {
+
+	mCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QDir::separator() + "raw";
+	QDir().mkpath(mCacheDir);
+}
+
+DkRawCache& DkRawCache::instance() {
+
+	static DkRawCache inst;
+	return inst;
+}
+
+bool DkRawCache::isEnabled() const {
+	return DkSettingsManager::param().resources().rawCacheSize > 0;
+}
+
+/**
+ * Returns the half-size rendering of a RAW file.
+ * @param filePath the RAW file
+ * @return QImage the developed image or a null image if it is not cached
+ **/ 
+QImage DkRawCache::find(const QString& filePath) const {
+
+	if (!isEnabled())
+		return QImage();
+
+	QString path = entryPath(QFileInfo(filePath));
+	QFile file(path);
+
+	if (!file.exists())
+		return QImage();
+
+	DkTimer dt;
+	QImage img = QImageReader(path).read();
+
+	if (img.isNull()) {
+		qWarning() << "[DkRawCache] removing corrupt entry" << path;
+		file.remove();
+		return img;
+	}
+
+	// mark as recently used
+#if QT_VERSION >= 0x050A00
+	if (file.open(QIODevice::ReadWrite))
+		file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+#endif
+
+	qDebug() << "[DkRawCache]" << QFileInfo(filePath).fileName() << "loaded in" << dt;
+
+	return img;
+}
+
+/**
+ * Adds a half-size rendering to the cache.
+ * The image is written in the background.
+ * @param filePath the RAW file
+ * @param img the developed (binned) image
+ **/ 
+void DkRawCache::insert(const QString& filePath, const QImage& img) {
+
+	if (!isEnabled() || img.isNull())
+		return;
+
+	QString path = entryPath(QFileInfo(filePath));
+
+	DkThreadPools::instance().run(DkThreadPools::lane_background, [this, path, img]() {
+
+		// concurrent readers (and writers of the same entry) must not see partial files
+		QSaveFile file(path);
+
+		if (!file.open(QIODevice::WriteOnly)) {
+			qWarning() << "[DkRawCache] could not open" << path << file.errorString();
+			return;
+		}
+
+		QImageWriter writer(&file, "jpg");
+		writer.setQuality(95);
+
+		if (!writer.write(img)) {
+			qWarning() << "[DkRawCache] could not write" << path << writer.errorString();
+			file.cancelWriting();
+			return;
+		}
+
+		if (file.commit())
+			shrink();
+	});
+}
+
+/**
+ * Removes all cached images.
+ **/ 
+void DkRawCache::clear() {
+
+	QMutexLocker locker(&mMutex);
+	QDir dir(mCacheDir);
+
+	for (const QString& fileName : dir.entryList(QDir::Files))
+		dir.remove(fileName);
+}
+
+QString DkRawCache::entryPath(const QFileInfo& fileInfo) const {
+
+	// the development depends on the noise filter too
+	QString identity = QString("%1|%2|%3|half|%4")
+		.arg(fileInfo.absoluteFilePath())
+		.arg(fileInfo.size())
+		.arg(fileInfo.lastModified().toMSecsSinceEpoch())
+		.arg(DkSettingsManager::param().resources().filterRawImages);
+
+	QString hash = QCryptographicHash::hash(identity.toUtf8(), QCryptographicHash::Sha1).toHex();
+
+	return mCacheDir + QDir::separator() + hash + ".jpg";
+}
+
+/**
+ * Removes the least recently used entries if the cache exceeds its size.
+ **/ 
+void DkRawCache::shrink() {
+
+	QMutexLocker locker(&mMutex);
+
+	qint64 maxSize = (qint64)DkSettingsManager::param().resources().rawCacheSize * 1024 * 1024;
+	QFileInfoList entries = QDir(mCacheDir).entryInfoList(QDir::Files, QDir::Time);	// most recent first
+
+	qint64 size = 0;
+
+	for (const QFileInfo& fi : entries) {
+		size += fi.size();
+
+		if (size > maxSize)
+			QFile::remove(fi.absoluteFilePath());
+	}
+}
+
+};
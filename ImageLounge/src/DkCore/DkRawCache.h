@@ -0,0 +1,86 @@
+/*******************************************************************************************************
+ DkRawCache.h
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#pragma warning(pop)		// no warnings from includes - end
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+class QFileInfo;
+
+namespace nmc {
+
+/**
+ * Persistent cache of developed RAW images.
+ * Developing RAW data takes seconds - so the results are stored
+ * in the user's cache folder. Entries are keyed by the file's identity
+ * (path, size, modification date) and the development settings, hence 
+ * edited files are developed again. Only the half-size renderings that
+ * are displayed are cached. They are stored as high quality jpgs - full
+ * renderings are always developed since they are saved, edited and printed.
+ * If the cache exceeds resources().rawCacheSize, the least recently used
+ * entries are removed.
+ **/ 
+class DllCoreExport DkRawCache {
+
+public:
+	static DkRawCache& instance();
+
+	// singleton
+	DkRawCache(DkRawCache const&)			= delete;
+	void operator=(DkRawCache const&)		= delete;
+
+	QImage find(const QString& filePath) const;
+	void insert(const QString& filePath, const QImage& img);
+	void clear();
+
+	bool isEnabled() const;
+
+private:
+	DkRawCache();
+
+	QString entryPath(const QFileInfo& fileInfo) const;
+	void shrink();
+
+	QString mCacheDir;
+	mutable QMutex mMutex;	// guards shrinking
+};
+
+};
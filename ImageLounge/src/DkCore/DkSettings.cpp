@@ -27,6 +27,7 @@
 
 #include "DkSettings.h"
 #include "DkUtils.h"
+#include "DkThreadPools.h"
 
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <iostream>
@@ -456,6 +457,10 @@ void DkSettings::load(QSettings& settings, bool defaults) {
 	resources_p.historyMemory = settings.value("historyMemory", resources_p.historyMemory).toFloat();
 	resources_p.maxImagesCached = settings.value("maxImagesCached", resources_p.maxImagesCached).toInt();
 	resources_p.waitForLastImg = settings.value("waitForLastImg", resources_p.waitForLastImg).toBool();
+	resources_p.displayDecode = settings.value("displayDecode", resources_p.displayDecode).toBool();
+	resources_p.rawHalfSize = settings.value("rawHalfSize", resources_p.rawHalfSize).toBool();
+	resources_p.rawCacheSize = settings.value("rawCacheSize", resources_p.rawCacheSize).toInt();
+	resources_p.cacheThumbs = settings.value("cacheThumbs", resources_p.cacheThumbs).toBool();
 	resources_p.filterRawImages = settings.value("filterRawImages", resources_p.filterRawImages).toBool();	
 	resources_p.loadRawThumb = settings.value("loadRawThumb", resources_p.loadRawThumb).toInt();	
 	resources_p.filterDuplicats = settings.value("filterDuplicates", resources_p.filterDuplicats).toBool();
@@ -474,7 +479,7 @@ void DkSettings::load(QSettings& settings, bool defaults) {
 	settings.endGroup();
 
 	if (global_p.numThreads != -1)
-		QThreadPool::globalInstance()->setMaxThreadCount(global_p.numThreads);
+		DkThreadPools::instance().setNumThreads(global_p.numThreads);
 	else
 		global_p.numThreads = QThreadPool::globalInstance()->maxThreadCount();
 
@@ -730,6 +735,14 @@ void DkSettings::save(QSettings& settings, bool force) {
 		settings.setValue("maxImagesCached", resources_p.maxImagesCached);
 	if (force ||resources_p.waitForLastImg != resources_d.waitForLastImg)
 		settings.setValue("waitForLastImg", resources_p.waitForLastImg);
+	if (force ||resources_p.displayDecode != resources_d.displayDecode)
+		settings.setValue("displayDecode", resources_p.displayDecode);
+	if (force ||resources_p.rawHalfSize != resources_d.rawHalfSize)
+		settings.setValue("rawHalfSize", resources_p.rawHalfSize);
+	if (force ||resources_p.rawCacheSize != resources_d.rawCacheSize)
+		settings.setValue("rawCacheSize", resources_p.rawCacheSize);
+	if (force ||resources_p.cacheThumbs != resources_d.cacheThumbs)
+		settings.setValue("cacheThumbs", resources_p.cacheThumbs);
 	if (force ||resources_p.filterRawImages != resources_d.filterRawImages)
 		settings.setValue("filterRawImages", resources_p.filterRawImages);
 	if (force ||resources_p.loadRawThumb != resources_d.loadRawThumb)
@@ -880,6 +893,10 @@ void DkSettings::setToDefaultSettings() {
 	resources_p.maxThumbsLoading = 5;
 	resources_p.gammaCorrection = true;
 	resources_p.waitForLastImg = true;
+	resources_p.displayDecode = true;
+	resources_p.rawHalfSize = true;
+	resources_p.rawCacheSize = 2048;
+	resources_p.cacheThumbs = true;
 
 	qDebug() << "ok... default settings are set";
 }
@@ -888,7 +905,7 @@ void DkSettings::setNumThreads(int numThreads) {
 
 	if (numThreads != global_p.numThreads) {
 		global_p.numThreads = numThreads;
-		QThreadPool::globalInstance()->setMaxThreadCount(numThreads);
+		DkThreadPools::instance().setNumThreads(numThreads);
 	}
 
 }
@@ -272,6 +272,10 @@ public:
 		float historyMemory;
 		int maxImagesCached;
 		bool waitForLastImg;
+		bool displayDecode;
+		bool rawHalfSize;
+		int rawCacheSize;		// MB
+		bool cacheThumbs;
 		bool filterRawImages;
 		bool filterDuplicats;
 		int loadRawThumb;
@@ -0,0 +1,209 @@
+/*******************************************************************************************************
+ DkThreadPools.cpp
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkThreadPools.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QThread>
+#include <QStringList>
+#include <QDebug>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace nmc {
+
+// DkThreadPools --------------------------------------------------------------------
+DkThreadPools::DkThreadPools() {
+
+	mIoPool = new QThreadPool();
+	mIoPool->setMaxThreadCount(numIoThreads);
+
+	mDecodePool = new QThreadPool();
+	mDecodePool->setMaxThreadCount(QThreadPool::globalInstance()->maxThreadCount());
+}
+
+DkThreadPools::~DkThreadPools() {
+
+	waitForDone();
+
+	delete mIoPool;
+	delete mDecodePool;
+}
+
+DkThreadPools& DkThreadPools::instance() {
+
+	static DkThreadPools inst;
+	return inst;
+}
+
+QThreadPool* DkThreadPools::pool(Lane lane) const {
+
+	switch (lane) {
+	case lane_current_io:
+	case lane_prefetch_io:
+		return mIoPool;
+	case lane_current_decode:
+	case lane_prefetch_decode:
+		return mDecodePool;
+	default:
+		return QThreadPool::globalInstance();
+	}
+}
+
+int DkThreadPools::priority(Lane lane) const {
+
+	switch (lane) {
+	case lane_current_io:
+	case lane_current_decode:
+	case lane_thumbnail:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Sets the number of CPU threads (global().numThreads).
+ * The I/O pool keeps its size.
+ * @param numThreads the maximal number of threads per pool
+ **/ 
+void DkThreadPools::setNumThreads(int numThreads) {
+
+	if (numThreads <= 0)
+		numThreads = QThread::idealThreadCount();
+
+	QThreadPool::globalInstance()->setMaxThreadCount(numThreads);
+	mDecodePool->setMaxThreadCount(numThreads);
+}
+
+void DkThreadPools::waitForDone() {
+
+	mIoPool->waitForDone();
+	mDecodePool->waitForDone();
+}
+
+void DkThreadPools::enqueue(Lane lane, QRunnable* job) {
+
+	mQueued[lane].ref();
+	pool(lane)->start(job, priority(lane));
+}
+
+void DkThreadPools::jobStarted(Lane lane, qint64 latency) {
+
+	mQueued[lane].deref();
+	mRunning[lane].ref();
+	mStarted[lane].ref();
+	mLatency[lane].fetchAndAddRelaxed(latency);
+	mLastLatency[lane].store(latency);
+}
+
+void DkThreadPools::jobFinished(Lane lane) {
+
+	mRunning[lane].deref();
+}
+
+/**
+ * Returns the number of jobs waiting in the lane.
+ **/ 
+int DkThreadPools::queued(Lane lane) const {
+	return mQueued[lane].load();
+}
+
+int DkThreadPools::running(Lane lane) const {
+	return mRunning[lane].load();
+}
+
+/**
+ * Returns the mean time (in ms) jobs waited in the lane's queue.
+ **/ 
+double DkThreadPools::meanLatency(Lane lane) const {
+
+	int numStarted = mStarted[lane].load();
+
+	if (numStarted == 0)
+		return 0.0;
+
+	return (double)mLatency[lane].load() / numStarted;
+}
+
+double DkThreadPools::lastLatency(Lane lane) const {
+	return (double)mLastLatency[lane].load();
+}
+
+QString DkThreadPools::report() const {
+
+	QStringList lines;
+
+	for (int idx = 0; idx < lane_end; idx++) {
+		Lane lane = (Lane)idx;
+		lines << QString("%1: %2 queued, %3 running, latency %4 ms (last %5 ms)")
+			.arg(laneName(lane))
+			.arg(queued(lane))
+			.arg(running(lane))
+			.arg(meanLatency(lane), 0, 'f', 1)
+			.arg(lastLatency(lane), 0, 'f', 0);
+	}
+
+	return lines.join("\n");
+}
+
+QString DkThreadPools::laneName(Lane lane) {
+
+	switch (lane) {
+	case lane_current_io:		return "current io";
+	case lane_prefetch_io:		return "prefetch io";
+	case lane_current_decode:	return "current decode";
+	case lane_prefetch_decode:	return "prefetch decode";
+	case lane_thumbnail:		return "thumbnail";
+	case lane_background:		return "background";
+	default:					return "unknown";
+	}
+}
+
+// DkLaneJob --------------------------------------------------------------------
+DkLaneJob::DkLaneJob(DkThreadPools::Lane lane, QSharedPointer<DkLaneTicket> ticket) {
+
+	mLane = lane;
+	mTicket = ticket;
+	mQueueTimer.start();
+}
+
+void DkLaneJob::run() {
+
+	DkThreadPools::instance().jobStarted(mLane, mQueueTimer.elapsed());
+	execute();
+	DkThreadPools::instance().jobFinished(mLane);
+}
+
+/**
+ * Returns false if the job was moved to another lane.
+ **/ 
+bool DkLaneJob::claim() {
+
+	return !mTicket || mTicket->claim();
+}
+
+};
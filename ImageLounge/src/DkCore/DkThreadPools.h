@@ -0,0 +1,215 @@
+/*******************************************************************************************************
+ DkThreadPools.h
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QThreadPool>
+#include <QRunnable>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include <QSharedPointer>
+#pragma warning(pop)		// no warnings from includes - end
+
+#include <functional>
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+namespace nmc {
+
+/**
+ * A queued job runs just once - in the lane that claims its ticket first.
+ * Use it to move a queued job to another lane (e.g. if a prefetched
+ * image becomes the current image): claim() the ticket of the queued
+ * job and run it again with a new ticket. Jobs that started already
+ * cannot be claimed.
+ **/ 
+class DllCoreExport DkLaneTicket {
+
+public:
+	bool claim() {
+		return mClaimed.testAndSetOrdered(0, 1);
+	};
+
+protected:
+	QAtomicInt mClaimed;
+};
+
+/**
+ * Thread pools of nomacs.
+ * Blocking I/O and CPU bound decoding run in separate pools, hence
+ * slow disks (e.g. network shares) do not block the decoders.
+ * Jobs are started in lanes. A lane has a pool and a priority:
+ * queued jobs of the current image are started before prefetch jobs.
+ * Thumbnails and background jobs use the global pool - this is
+ * where QtConcurrent::map (batch processing) runs too.
+ **/ 
+class DllCoreExport DkThreadPools {
+
+public:
+	enum Lane {
+		lane_current_io,		// reads the file that is displayed
+		lane_prefetch_io,		// reads files of neighbouring images
+		lane_current_decode,	// decodes/manipulates the image that is displayed
+		lane_prefetch_decode,	// decodes neighbouring images
+		lane_thumbnail,			// computes thumbnails
+		lane_background,		// anything else
+
+		lane_end
+	};
+
+	static DkThreadPools& instance();
+	~DkThreadPools();
+
+	// singleton
+	DkThreadPools(DkThreadPools const&)		= delete;
+	void operator=(DkThreadPools const&)	= delete;
+
+	template <typename Function>
+	auto run(Lane lane, Function fn, QSharedPointer<DkLaneTicket> ticket = QSharedPointer<DkLaneTicket>()) -> QFuture<decltype(fn())>;
+
+	QThreadPool* pool(Lane lane) const;
+	void setNumThreads(int numThreads);
+	void waitForDone();
+
+	// diagnostics
+	int queued(Lane lane) const;
+	int running(Lane lane) const;
+	double meanLatency(Lane lane) const;
+	double lastLatency(Lane lane) const;
+	QString report() const;
+	static QString laneName(Lane lane);
+
+	static const int numIoThreads = 4;	// blocking reads - does not depend on the number of cores
+
+private:
+	DkThreadPools();
+
+	friend class DkLaneJob;
+
+	void enqueue(Lane lane, QRunnable* job);
+	void jobStarted(Lane lane, qint64 latency);
+	void jobFinished(Lane lane);
+	int priority(Lane lane) const;
+
+	QThreadPool* mIoPool = 0;
+	QThreadPool* mDecodePool = 0;
+
+	QAtomicInt mQueued[lane_end];
+	QAtomicInt mRunning[lane_end];
+	QAtomicInt mStarted[lane_end];
+	QAtomicInteger<qint64> mLatency[lane_end];		// ms summed over all started jobs
+	QAtomicInteger<qint64> mLastLatency[lane_end];	// ms
+};
+
+/**
+ * Job that is queued in a DkThreadPools lane.
+ * Measures the time it waits in the queue.
+ **/ 
+class DllCoreExport DkLaneJob : public QRunnable {
+
+public:
+	DkLaneJob(DkThreadPools::Lane lane, QSharedPointer<DkLaneTicket> ticket = QSharedPointer<DkLaneTicket>());
+
+	void run() override;
+
+protected:
+	virtual void execute() = 0;
+	bool claim();
+
+	DkThreadPools::Lane mLane;
+	QElapsedTimer mQueueTimer;
+	QSharedPointer<DkLaneTicket> mTicket;
+};
+
+template <typename T>
+class DkLaneTask : public DkLaneJob, public QFutureInterface<T> {
+
+public:
+	DkLaneTask(DkThreadPools::Lane lane, std::function<T()> fn, QSharedPointer<DkLaneTicket> ticket) : DkLaneJob(lane, ticket), mFn(fn) {};
+
+protected:
+	void execute() override {
+
+		if (!this->isCanceled() && claim())
+			this->reportResult(mFn());
+		this->reportFinished();
+	};
+
+	std::function<T()> mFn;
+};
+
+template <>
+class DkLaneTask<void> : public DkLaneJob, public QFutureInterface<void> {
+
+public:
+	DkLaneTask(DkThreadPools::Lane lane, std::function<void()> fn, QSharedPointer<DkLaneTicket> ticket) : DkLaneJob(lane, ticket), mFn(fn) {};
+
+protected:
+	void execute() override {
+
+		if (!isCanceled() && claim())
+			mFn();
+		reportFinished();
+	};
+
+	std::function<void()> mFn;
+};
+
+/**
+ * Runs fn in the lane's pool.
+ * Queued jobs of the future can be canceled (they are not started then).
+ * @param lane the lane (determines the pool and the priority)
+ * @param fn the function (called in the pool's thread)
+ * @param ticket if set, fn is not called if the ticket was claimed before (see DkLaneTicket)
+ * @return QFuture the result of fn
+ **/ 
+template <typename Function>
+auto DkThreadPools::run(Lane lane, Function fn, QSharedPointer<DkLaneTicket> ticket) -> QFuture<decltype(fn())> {
+
+	typedef decltype(fn()) ResultType;
+
+	DkLaneTask<ResultType>* task = new DkLaneTask<ResultType>(lane, fn, ticket);
+	task->reportStarted();
+	QFuture<ResultType> future = task->future();
+
+	enqueue(lane, task);	// the pool deletes the task
+
+	return future;
+}
+
+};
@@ -0,0 +1,220 @@
+/*******************************************************************************************************
+ DkThumbCache.cpp
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkThumbCache.h"
+
+#include "DkSettings.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrl>
+#pragma warning(pop)		// no warnings from includes - end
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace nmc {
+
+// DkThumbCache --------------------------------------------------------------------
+/**
+ * Returns a cached thumbnail.
+ * Just thumbnails that match the file's modification date and size are returned.
+ * @param filePath the image file
+ * @param size the thumbnail size needed
+ * @return QImage the thumbnail (its longer side is the tier size or less) or a null image
+ **/ 
+QImage DkThumbCache::find(const QString& filePath, int size) {
+
+	int ts = tierSize(size);
+	QFileInfo fi(filePath);
+
+	if (!isEnabled() || ts == -1 || !fi.exists())
+		return QImage();
+
+	// larger tiers serve smaller thumbnails too
+	for (int tier = 0; tier < tier_end; tier++) {
+
+		if ((128 << tier) < ts)
+			continue;
+
+		QString path = entryPath(fi.absoluteFilePath(), tier);
+
+		if (!QFileInfo(path).exists())
+			continue;
+
+		QImageReader reader(path, "png");
+		
+		// validate before decoding the pixels
+		if (reader.text("Thumb::MTime") != QString::number(fi.lastModified().toMSecsSinceEpoch() / 1000) ||
+			(!reader.text("Thumb::Size").isEmpty() && reader.text("Thumb::Size") != QString::number(fi.size())))
+			continue;
+
+		QImage thumb = reader.read();
+
+		if (!thumb.isNull())
+			return thumb;
+	}
+
+	return QImage();
+}
+
+/**
+ * Stores a thumbnail.
+ * The thumbnail is written to the tier that matches its size.
+ * @param filePath the image file
+ * @param thumb the thumbnail
+ * @return bool true if the thumbnail was written
+ **/ 
+bool DkThumbCache::insert(const QString& filePath, const QImage& thumb) {
+
+	QFileInfo fi(filePath);
+	int ts = tierSize(qMax(thumb.width(), thumb.height()));
+
+	if (!isEnabled() || ts == -1 || thumb.isNull() || !fi.exists())
+		return false;
+
+	int tier = 0;
+	while ((128 << tier) < ts)
+		tier++;
+
+	QString path = entryPath(fi.absoluteFilePath(), tier);
+
+	if (!makePrivateDir(cacheDir()) || !makePrivateDir(QFileInfo(path).absolutePath()))
+		return false;
+
+	QImage img = thumb;
+	img.setText("Thumb::URI", QUrl::fromLocalFile(fi.absoluteFilePath()).toEncoded());
+	img.setText("Thumb::MTime", QString::number(fi.lastModified().toMSecsSinceEpoch() / 1000));
+	img.setText("Thumb::Size", QString::number(fi.size()));
+	img.setText("Software", "nomacs");
+
+	// concurrent readers (and other processes writing the same entry) must not see partial files
+	QSaveFile file(path);
+
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+
+	// the thumbnail spec demands private entries - set them before any pixel is written
+	if (!file.setPermissions(QFile::ReadOwner | QFile::WriteOwner)) {
+		file.cancelWriting();
+		return false;
+	}
+
+	QImageWriter writer(&file, "png");
+
+	if (!writer.write(img)) {
+		file.cancelWriting();
+		return false;
+	}
+
+	return file.commit();
+}
+
+bool DkThumbCache::isEnabled() {
+	return DkSettingsManager::param().resources().cacheThumbs;
+}
+
+/**
+ * Returns the tier that covers a thumbnail size.
+ * @param size the thumbnail size
+ * @return int the tier's size (128, 256, 512, 1024) or -1 if the size is too large
+ **/ 
+int DkThumbCache::tierSize(int size) {
+
+	for (int tier = 0; tier < tier_end; tier++) {
+		if (size <= (128 << tier))
+			return 128 << tier;
+	}
+
+	return -1;
+}
+
+QString DkThumbCache::tierName(int tier) {
+
+	switch (tier) {
+	case tier_normal:	return "normal";
+	case tier_large:	return "large";
+	case tier_x_large:	return "x-large";
+	case tier_xx_large:	return "xx-large";
+	}
+
+	return QString();
+}
+
+QString DkThumbCache::cacheDir() {
+
+	// ~/.cache/thumbnails on linux
+	return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/thumbnails";
+}
+
+QString DkThumbCache::entryPath(const QString& filePath, int tier) {
+
+	QByteArray uri = QUrl::fromLocalFile(filePath).toEncoded();
+	QString hash = QCryptographicHash::hash(uri, QCryptographicHash::Md5).toHex();
+
+	return cacheDir() + "/" + tierName(tier) + "/" + hash + ".png";
+}
+
+/**
+ * Creates a directory that only the user can access (0700).
+ * Existing directories are not changed.
+ * @param dirPath the directory (its parent is created if needed)
+ * @return bool true if the directory exists
+ **/ 
+bool DkThumbCache::makePrivateDir(const QString& dirPath) {
+
+	if (QFileInfo(dirPath).isDir())
+		return true;
+
+	QDir().mkpath(QFileInfo(dirPath).absolutePath());
+
+#ifdef Q_OS_UNIX
+	// create it with the right mode - chmod would leave a window for other users
+	if (::mkdir(QFile::encodeName(dirPath).constData(), S_IRWXU) != 0)
+		return QFileInfo(dirPath).isDir();	// someone else was faster
+
+	return true;
+#else
+	if (!QDir().mkdir(dirPath))
+		return QFileInfo(dirPath).isDir();
+
+	QFile::setPermissions(dirPath, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+	return true;
+#endif
+}
+
+};
@@ -0,0 +1,80 @@
+/*******************************************************************************************************
+ DkThumbCache.h
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QImage>
+#include <QString>
+#pragma warning(pop)		// no warnings from includes - end
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+namespace nmc {
+
+/**
+ * Persistent thumbnail store.
+ * Thumbnails are stored according to the freedesktop.org thumbnail
+ * specification: <cache>/thumbnails/<tier>/<md5 of the file URI>.png
+ * The png's Thumb::URI, Thumb::MTime and Thumb::Size texts validate
+ * the entry. Hence, the thumbnails are shared with file managers
+ * (on linux) and never mutate the user's files.
+ **/ 
+class DllCoreExport DkThumbCache {
+
+public:
+	enum Tier {
+		tier_normal,		// 128 px
+		tier_large,			// 256 px
+		tier_x_large,		// 512 px
+		tier_xx_large,		// 1024 px
+
+		tier_end
+	};
+
+	static QImage find(const QString& filePath, int size);
+	static bool insert(const QString& filePath, const QImage& thumb);
+
+	static bool isEnabled();
+	static int tierSize(int size);
+	static QString tierName(int tier);
+	static QString cacheDir();
+	static QString entryPath(const QString& filePath, int tier);
+
+protected:
+	static bool makePrivateDir(const QString& dirPath);
+};
+
+};
@@ -32,6 +32,8 @@
 #include "DkBasicLoader.h"
 #include "DkMetaData.h"
 #include "DkUtils.h"
+#include "DkThreadPools.h"
+#include "DkThumbCache.h"
 
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QFileInfo>
@@ -41,8 +43,13 @@
 #include <QtConcurrentRun>
 #include <QTimer>
 #include <QBuffer>
+#include <QSet>
+#include <QDirIterator>
+#include <QQueue>
 #pragma warning(pop)		// no warnings from includes - end
 
+#include <algorithm>
+
 namespace nmc {
 
 /**
@@ -93,26 +100,66 @@ QImage DkThumbNail::computeIntern(const QString& filePath, const QSharedPointer<
 	QImage thumb;
 	DkMetaDataT metaData;
 
-	QSharedPointer<QByteArray> baZip = QSharedPointer<QByteArray>();
+	QFileInfo fInfo(filePath);
+	QString lFilePath = fInfo.isSymLink() ? fInfo.symLinkTarget() : filePath;
+	fInfo = lFilePath;
+
+	// thumbnails of the shared cache are computed from the full image
+	// thumbnails that are saved to the file need the file's metadata anyway
+	if (forceLoad != force_exif_thumb && forceLoad != force_save_thumb && forceLoad != save_thumb) {
+
+		thumb = DkThumbCache::find(lFilePath, maxThumbSize);
+
+		if (!thumb.isNull()) {
+
+			if (thumb.width() > maxThumbSize || thumb.height() > maxThumbSize)
+				thumb = thumb.scaled(QSize(maxThumbSize, maxThumbSize), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+			qInfoClean() << "[thumb] " << fInfo.fileName() << " (" << thumb.width() << " x " << thumb.height() << ") loaded in " << dt << " from cache";
+			return thumb;
+		}
+	}
+
+	// the file is read once - metadata, reader and loader share the buffer
+	QSharedPointer<QByteArray> fileBuffer = ba;
+
 #ifdef WITH_QUAZIP
 	if (QFileInfo(mFile).dir().path().contains(DkZipContainer::zipMarker())) 
-		baZip = DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath));
+		fileBuffer = DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath));
 #endif
-	try {
-		// [DIEM] READ  build crashed here 09.06.2016
-		if (baZip && !baZip->isEmpty())	
-			metaData.readMetaData(filePath, baZip);
-		else if (!ba || ba->isEmpty())
-			metaData.readMetaData(filePath);
-		else
-			metaData.readMetaData(filePath, ba);
-
-		// read the full image if we want to create new thumbnails
-		if (forceLoad != force_save_thumb)
-			thumb = metaData.getThumbnail();
+
+	// we need all pixels anyway
+	if ((!fileBuffer || fileBuffer->isEmpty()) && (forceLoad == force_full_thumb || forceLoad == force_save_thumb))
+		fileBuffer = DkFileBuffer::load(lFilePath);
+
+	// fast path: read the thumbnail without parsing all metadata (makernotes)
+	DkExifThumb exifReader;
+	
+	if (forceLoad != force_save_thumb) {
+		exifReader.read(lFilePath, fileBuffer);
+		thumb = exifReader.thumbnail();
 	}
-	catch(...) {
-		// do nothing - we'll load the full file
+
+	// exiv2 is needed if we save thumbnails
+	bool readExif = !exifReader.isValid() || forceLoad == force_save_thumb || (forceLoad == save_thumb && thumb.isNull());
+
+	if (readExif) {
+
+		try {
+			// [DIEM] READ  build crashed here 09.06.2016
+			// if there is no buffer, exiv2 just reads the header
+			if (!fileBuffer || fileBuffer->isEmpty())
+				metaData.readMetaData(filePath);
+			else
+				metaData.readMetaData(filePath, fileBuffer);
+
+			// read the full image if we want to create new thumbnails
+			if (forceLoad != force_save_thumb && thumb.isNull())
+				thumb = metaData.getThumbnail();
+		}
+		catch(...) {
+			// do nothing - we'll load the full file
+		}
 	}
 	removeBlackBorder(thumb);
 
@@ -121,83 +168,74 @@ QImage DkThumbNail::computeIntern(const QString& filePath, const QSharedPointer<
 
 	bool exifThumb = !thumb.isNull();
 
-	int orientation = metaData.getOrientationDegree();
+	int orientation = readExif ? metaData.getOrientationDegree() : exifReader.orientationDegree();
+	QString suffix = fInfo.suffix();
+	bool isTiff = suffix.contains(QRegExp("(tif|tiff)", Qt::CaseInsensitive));
+	bool isJpgOrRaw = suffix.contains(QRegExp("(jpg|jpeg|nef|crw|cr2|arw)", Qt::CaseInsensitive));
 	int imgW = thumb.width();
 	int imgH = thumb.height();
 	int tS = minThumbSize;
 
 	// as found at: http://olliwang.com/2010/01/30/creating-thumbnail-images-in-qt/
-	QFileInfo fInfo(filePath);
-	QString lFilePath = fInfo.isSymLink() ? fInfo.symLinkTarget() : filePath;
-	fInfo = lFilePath;
-
-	QImageReader* imageReader = 0;
-	
-	if (!ba || ba->isEmpty())
-		imageReader = new QImageReader(lFilePath);
-	else {
-		QBuffer buffer;
-		buffer.setData(ba->data());
-		buffer.open(QIODevice::ReadOnly);
-		imageReader = new QImageReader(&buffer, fInfo.suffix().toStdString().c_str());
-		buffer.close();
-	}
-
-	if (thumb.isNull() || (thumb.width() < tS && thumb.height() < tS)) {
-
-		imgW = imageReader->size().width();		// crash detected: unhandled exception at 0x66850E9A (msvcr110d.dll) in nomacs.exe: 0xC0000005: Access violation reading location 0x0000C788.
-		imgH = imageReader->size().height();	// locks the file!
+	bool smallThumb = thumb.isNull() || (thumb.width() < tS && thumb.height() < tS);
+	bool loadImage = forceLoad != force_exif_thumb && (smallThumb || forceLoad == force_full_thumb || forceLoad == force_save_thumb);
+
+	// decode at the cache's tier size if we need all pixels anyway
+	bool cacheThumb = loadImage && DkThumbCache::isEnabled() && DkThumbCache::tierSize(maxThumbSize) != -1 && fInfo.exists();
+	int thumbSize = cacheThumb ? DkThumbCache::tierSize(maxThumbSize) : maxThumbSize;
+
+	// the reader works on the buffer - so it does not lock the file
+	if (loadImage && (!fileBuffer || fileBuffer->isEmpty()))
+		fileBuffer = DkFileBuffer::load(lFilePath);
+
+	QBuffer buffer;
+	if (fileBuffer)
+		buffer.setData(*fileBuffer);	// fileBuffer->data() would copy mapped buffers
+	buffer.open(QIODevice::ReadOnly);
+	QImageReader imageReader(&buffer, fInfo.suffix().toStdString().c_str());
+
+	if (loadImage && smallThumb) {
+		imgW = imageReader.size().width();
+		imgH = imageReader.size().height();
 	}
 	
-	if (forceLoad != DkThumbNailT::force_exif_thumb && (imgW > maxThumbSize || imgH > maxThumbSize)) {
+	if (forceLoad != DkThumbNailT::force_exif_thumb && (imgW > thumbSize || imgH > thumbSize)) {
 		if (imgW > imgH) {
-			imgH = qRound((float)maxThumbSize / imgW * imgH);
-			imgW = maxThumbSize;
+			imgH = qRound((float)thumbSize / imgW * imgH);
+			imgW = thumbSize;
 		} 
 		else if (imgW < imgH) {
-			imgW = qRound((float)maxThumbSize / imgH * imgW);
-			imgH = maxThumbSize;
+			imgW = qRound((float)thumbSize / imgH * imgW);
+			imgH = thumbSize;
 		}
 		else {
-			imgW = maxThumbSize;
-			imgH = maxThumbSize;
+			imgW = thumbSize;
+			imgH = thumbSize;
 		}
 	}
 
 	// diem: do_not_force is the generic load - so also rescale these
 	bool rescale = forceLoad == force_save_thumb || forceLoad == do_not_force;
 
-	if (forceLoad != force_exif_thumb && 
-			(thumb.isNull() || 
-			thumb.width() < tS && thumb.height() < tS || 
-			forceLoad == force_full_thumb || 
-			forceLoad == force_save_thumb)) { // braces
+	if (loadImage) {
 		
 		// flip size if the image is rotated by 90
-		if (metaData.isTiff() && abs(orientation) == 90) {
+		if (isTiff && abs(orientation) == 90) {
 			int tmpW = imgW;
 			imgW = imgH;
 			imgH = tmpW;
 			qDebug() << "EXIF size is flipped...";
 		}
 
-		QSize initialSize = imageReader->size();
-
-		imageReader->setScaledSize(QSize(imgW, imgH));
-		thumb = imageReader->read();
+		imageReader.setScaledSize(QSize(imgW, imgH));
+		thumb = imageReader.read();
 
 		// try to read the image
 		if (thumb.isNull()) {
 			DkBasicLoader loader;
 			
-			if (baZip && !baZip->isEmpty())	{
-				if (loader.loadGeneral(lFilePath, baZip, true, true))
+			if (loader.loadGeneral(lFilePath, fileBuffer, true, true))
 				thumb = loader.image();
-			}
-			else {
-				if (loader.loadGeneral(lFilePath, ba, true, true))
-					thumb = loader.image();
-			}
 		}
 
 		// the image is not scaled correctly yet
@@ -205,41 +243,47 @@ QImage DkThumbNail::computeIntern(const QString& filePath, const QSharedPointer<
 			imgW = thumb.width();
 			imgH = thumb.height();
 
-			if (imgW > maxThumbSize || imgH > maxThumbSize) {
+			if (imgW > thumbSize || imgH > thumbSize) {
 				if (imgW > imgH) {
-					imgH = qRound((float)maxThumbSize / imgW * imgH);
-					imgW = maxThumbSize;
+					imgH = qRound((float)thumbSize / imgW * imgH);
+					imgW = thumbSize;
 				} 
 				else if (imgW < imgH) {
-					imgW = qRound((float)maxThumbSize / imgH * imgW);
-					imgH = maxThumbSize;
+					imgW = qRound((float)thumbSize / imgH * imgW);
+					imgH = thumbSize;
 				}
 				else {
-					imgW = maxThumbSize;
-					imgH = maxThumbSize;
+					imgW = thumbSize;
+					imgH = thumbSize;
 				}
 			}
 
 			thumb = thumb.scaled(QSize(imgW*2, imgH*2), Qt::KeepAspectRatio, Qt::FastTransformation);
 			thumb = thumb.scaled(QSize(imgW, imgH), Qt::KeepAspectRatio, Qt::SmoothTransformation);
 		}
-
-		// is there a nice solution to do so??
-		imageReader->setFileName("josef");	// image reader locks the file -> but there should not be one so we just set it to another file...
 	}
 	else if (rescale) {
 		thumb = thumb.scaled(QSize(imgW, imgH), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
 	}
 
-	if (imageReader)
-		delete imageReader;
-
-	if (orientation != -1 && orientation != 0 && (metaData.isJpg() || metaData.isRaw())) {
+	if (orientation != -1 && orientation != 0 && isJpgOrRaw) {
 		QTransform rotationMatrix;
 		rotationMatrix.rotate((double)orientation);
 		thumb = thumb.transformed(rotationMatrix);
 	}
 
+	if (cacheThumb && !thumb.isNull()) {
+
+		// the cache does not block the thumbnail
+		QImage cThumb = thumb;
+		DkThreadPools::instance().run(DkThreadPools::lane_background, [lFilePath, cThumb]() {
+			DkThumbCache::insert(lFilePath, cThumb);
+		});
+
+		if (thumb.width() > maxThumbSize || thumb.height() > maxThumbSize)
+			thumb = thumb.scaled(QSize(maxThumbSize, maxThumbSize), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+	}
+
 	// save the thumbnail if the caller either forces it, or the save thumb is requested and the image did not have any before
 	if (forceLoad == force_save_thumb || (forceLoad == save_thumb && !exifThumb)) {
 		
@@ -365,17 +409,31 @@ bool DkThumbNailT::fetchThumb(int forceLoad /* = false */,  QSharedPointer<QByte
 	if (forceLoad == force_full_thumb || forceLoad == force_save_thumb || forceLoad == save_thumb)
 		mImg = QImage();
 
-	if (!mImg.isNull() || !mImgExists || mFetching)
+	if (!mImg.isNull() || !mImgExists || (mFetching && !thumbWatcher.isCanceled()))
 		return false;
 
+	// a canceled job is replaced
+	if (mFetching && DkSettingsManager::param().resources().numThumbsLoading > 0)
+		DkSettingsManager::param().resources().numThumbsLoading--;
+
+	// do not read the file again if the image container has it
+	if (!ba || ba->isEmpty())
+		ba = mFileBuffer.toStrongRef();
+
 	// we have to do our own bool here
 	// watcher.isRunning() returns false if the thread is waiting in the pool
 	mFetching = true;
 	mForceLoad = forceLoad;
 
-	connect(&thumbWatcher, SIGNAL(finished()), this, SLOT(thumbLoaded()));
-	thumbWatcher.setFuture(QtConcurrent::run(this, 
-		&nmc::DkThumbNailT::computeCall, mFile, ba, forceLoad, mMaxThumbSize, mMinThumbSize));
+	connect(&thumbWatcher, SIGNAL(finished()), this, SLOT(thumbLoaded()), Qt::UniqueConnection);
+	QString filePath = mFile;
+	int maxThumbSize = mMaxThumbSize;
+	int minThumbSize = mMinThumbSize;
+
+	thumbWatcher.setFuture(DkThreadPools::instance().run(DkThreadPools::lane_thumbnail, 
+		[this, filePath, ba, forceLoad, maxThumbSize, minThumbSize]() {
+			return computeCall(filePath, ba, forceLoad, maxThumbSize, minThumbSize); 
+		}));
 
 	DkSettingsManager::param().resources().numThumbsLoading++;
 
@@ -388,10 +446,27 @@ QImage DkThumbNailT::computeCall(const QString& filePath, QSharedPointer<QByteAr
 	return DkThumbNail::computeIntern(filePath, ba, forceLoad, maxThumbSize, minThumbSize);
 }
 
+/**
+ * Cancels the thumbnail job.
+ * Queued jobs are not started and the result of running jobs is discarded.
+ **/ 
+void DkThumbNailT::cancel() {
+
+	if (mFetching)
+		thumbWatcher.cancel();
+}
+
 void DkThumbNailT::thumbLoaded() {
 	
 	QFuture<QImage> future = thumbWatcher.future();
 
+	// canceled jobs have no result
+	if (future.isCanceled()) {
+		mFetching = false;
+		DkSettingsManager::param().resources().numThumbsLoading--;
+		return;
+	}
+
 	mImg = future.result();
 	
 	if (mImg.isNull() && mForceLoad != force_exif_thumb)
@@ -402,6 +477,160 @@ void DkThumbNailT::thumbLoaded() {
 	emit thumbLoadedSignal(!mImg.isNull());
 }
 
+// DkThumbScheduler --------------------------------------------------------------------
+DkThumbScheduler::DkThumbScheduler(QObject* parent) : QObject(parent) {
+}
+
+/**
+ * Replaces the requested thumbnails.
+ * Running jobs that are not requested anymore are canceled.
+ * @param requests the thumbnails and their priority (lower values are loaded first)
+ **/ 
+void DkThumbScheduler::setRequests(QVector<QPair<double, QSharedPointer<DkThumbNailT> > > requests) {
+
+	std::stable_sort(requests.begin(), requests.end(), 
+		[](const QPair<double, QSharedPointer<DkThumbNailT> >& l, const QPair<double, QSharedPointer<DkThumbNailT> >& r) {
+		return l.first < r.first;
+	});
+
+	QSet<DkThumbNailT*> requested;
+	mPending.clear();
+
+	for (const QPair<double, QSharedPointer<DkThumbNailT> >& r : requests) {
+
+		if (!r.second)
+			continue;
+
+		requested.insert(r.second.data());
+
+		if (r.second->hasImage() == DkThumbNail::not_loaded)
+			mPending << r.second;
+	}
+
+	for (int idx = mRunning.size()-1; idx >= 0; idx--) {
+
+		if (!requested.contains(mRunning[idx].data())) {
+			mRunning[idx]->cancel();
+			mRunning.remove(idx);
+		}
+	}
+
+	schedule();
+}
+
+void DkThumbScheduler::cancelAll() {
+
+	for (QSharedPointer<DkThumbNailT> thumb : mRunning)
+		thumb->cancel();
+
+	mRunning.clear();
+	mPending.clear();
+}
+
+void DkThumbScheduler::schedule() {
+
+	int maxJobs = DkSettingsManager::param().resources().maxThumbsLoading*2;
+
+	while (mRunning.size() < maxJobs && !mPending.empty()) {
+
+		QSharedPointer<DkThumbNailT> thumb = mPending.takeFirst();
+
+		if (mRunning.contains(thumb))
+			continue;
+
+		connect(thumb.data(), SIGNAL(thumbLoadedSignal(bool)), this, SLOT(thumbLoaded()), Qt::UniqueConnection);
+
+		if (thumb->fetchThumb())
+			mRunning << thumb;
+	}
+}
+
+void DkThumbScheduler::thumbLoaded() {
+
+	DkThumbNailT* thumb = qobject_cast<DkThumbNailT*>(sender());
+
+	for (int idx = 0; idx < mRunning.size(); idx++) {
+
+		if (mRunning[idx].data() == thumb) {
+			mRunning.remove(idx);
+			break;
+		}
+	}
+
+	schedule();
+}
+
+// DkThumbsGenerator --------------------------------------------------------------------
+/**
+ * Computes the thumbnails of all images in dirPath and its sub folders.
+ * Thumbnails are written to the thumbnail cache. If saveExif is true,
+ * they are written to the Exif data of images that do not have one.
+ * @param dirPath the root directory
+ * @param saveExif if true, thumbnails are saved to the images' Exif data
+ **/ 
+void DkThumbsGenerator::computeThumbs(const QString& dirPath, bool saveExif) {
+
+	DkTimer dt;
+
+	if (!saveExif && !DkThumbCache::isEnabled()) {
+		qWarning() << "the thumbnail cache is disabled - enable it in the settings or use --thumbs-exif";
+		return;
+	}
+
+	QStringList files;
+	QDirIterator it(dirPath, QDir::Files, QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+
+	while (it.hasNext()) {
+
+		it.next();
+
+		if (DkUtils::isValid(it.fileInfo()))
+			files << it.filePath();
+	}
+
+	qInfo() << "computing thumbnails of" << files.size() << "images in" << dirPath << "- files indexed in" << dt;
+
+	int forceLoad = saveExif ? DkThumbNail::save_thumb : DkThumbNail::force_full_thumb;
+	
+	// feed the pool in small batches - queuing all files at once would
+	// allocate one job per file for huge collections
+	int maxJobs = qMax(1, QThreadPool::globalInstance()->maxThreadCount()) * 4;
+	QQueue<QFuture<bool> > jobs;
+	int numFailed = 0;
+	int numDone = 0;
+
+	auto finishJob = [&]() {
+
+		if (!jobs.dequeue().result())
+			numFailed++;
+
+		if (++numDone % 1000 == 0)
+			qInfo() << numDone << "/" << files.size() << "thumbnails computed in" << dt;
+	};
+
+	for (const QString& filePath : files) {
+
+		if (jobs.size() >= maxJobs)
+			finishJob();
+
+		jobs.enqueue(DkThreadPools::instance().run(DkThreadPools::lane_thumbnail, [filePath, forceLoad]() {
+			DkThumbNail thumb(filePath);
+			thumb.compute(forceLoad);
+			return !thumb.getImage().isNull();
+		}));
+	}
+
+	while (!jobs.empty())
+		finishJob();
+
+	// cache entries are written in the background
+	QThreadPool::globalInstance()->waitForDone();
+
+	double sec = dt.elapsed() / 1000.0;
+	qInfo() << files.size() << "thumbnails computed with" << numFailed << "errors in" << dt 
+		<< QString("(%1 images/s)").arg(sec > 0 ? files.size() / sec : 0.0, 0, 'f', 1);
+}
+
 /**
  * Default constructor of the thumbnail loader.
  * Note: currently the init calls the getFilteredFileList which might be slow.
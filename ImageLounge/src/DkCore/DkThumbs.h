@@ -34,6 +34,7 @@
 #include <QDir>
 #include <QThread>
 #include <QImage>
+#include <QVector>
 #pragma warning(pop)		// no warnings from includes - end
 
 #pragma warning(disable: 4251)	// TODO: remove
@@ -175,6 +176,16 @@ public:
 	~DkThumbNailT();
 
 	bool fetchThumb(int forceLoad = do_not_force, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+	void cancel();
+
+	/**
+	 * Sets the buffer of the image file (if it is loaded anyway).
+	 * The buffer is not kept alive by the thumbnail.
+	 * @param ba the file buffer
+	 **/ 
+	void setFileBuffer(QSharedPointer<QByteArray> ba) {
+		mFileBuffer = ba;
+	};
 
 	/**
 	 * Returns whether the thumbnail was loaded, or does not exist.
@@ -203,10 +214,49 @@ protected:
 	QImage computeCall(const QString& filePath, QSharedPointer<QByteArray> ba, int forceLoad, int maxThumbSize, int minThumbSize);
 
 	QFutureWatcher<QImage> thumbWatcher;
+	QWeakPointer<QByteArray> mFileBuffer;
 	bool mFetching;
 	int mForceLoad;
 };
 
+/**
+ * Schedules thumbnail jobs.
+ * Requests are started by priority and just a few jobs
+ * run at once. Running jobs that are not requested
+ * anymore (e.g. the thumbnails were scrolled out of view)
+ * are canceled. Hence, new requests are not queued behind
+ * thumbnails that nobody looks at.
+ **/ 
+class DllCoreExport DkThumbScheduler : public QObject {
+	Q_OBJECT
+
+public:
+	DkThumbScheduler(QObject* parent = 0);
+
+	void setRequests(QVector<QPair<double, QSharedPointer<DkThumbNailT> > > requests);
+	void cancelAll();
+
+protected slots:
+	void thumbLoaded();
+
+protected:
+	void schedule();
+
+	QList<QSharedPointer<DkThumbNailT> > mPending;		// sorted by priority
+	QVector<QSharedPointer<DkThumbNailT> > mRunning;
+};
+
+/**
+ * Computes the thumbnails of a directory tree.
+ * This is the headless counterpart of DkThumbsSaver (--thumbs).
+ * All cores are used and a throughput report is written to the log.
+ **/ 
+class DllCoreExport DkThumbsGenerator {
+
+public:
+	static void computeThumbs(const QString& dirPath, bool saveExif = false);
+};
+
 /**
  * This class provides a method for reading thumbnails.
  * If the a thumbnail is provided in the metadata,
@@ -0,0 +1,455 @@
+/*******************************************************************************************************
+ DkTiledImage.cpp
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkTiledImage.h"
+
+#include "DkBasicLoader.h"
+#include "DkThreadPools.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QtMath>
+#include <QVector>
+
+#ifdef WITH_OPENCV
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#endif
+
+#ifdef WITH_LIBTIFF
+#ifdef Q_OS_WIN
+#include "tif_config.h"	
+#endif
+
+// see DkBasicLoader.cpp
+#define uint64 uint64_hack_
+#define int64 int64_hack_
+
+#include "tiffio.h"
+
+#undef uint64
+#undef int64
+#endif
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace nmc {
+
+// DkImageTileSource --------------------------------------------------------------------
+DkImageTileSource::DkImageTileSource(const QImage& img) {
+	mImg = img;
+}
+
+QSize DkImageTileSource::size() const {
+	return mImg.size();
+}
+
+QString DkImageTileSource::key() const {
+	return QString::number(mImg.cacheKey());
+}
+
+QImage DkImageTileSource::region(const QRect& rect, const QSize& scaledSize) const {
+
+	QRect r = rect.intersected(mImg.rect());
+
+	if (r.isEmpty())
+		return QImage();
+
+	if (scaledSize == r.size())
+		return mImg.copy(r);
+
+#ifdef WITH_OPENCV
+	int cn = mImg.depth() / 8;
+
+	// area interpolation directly on the image's memory - no copy of the region
+	if (mImg.colorCount() == 0 && (cn == 1 || cn == 3 || cn == 4)) {
+
+		const uchar* ptr = mImg.constBits() + (size_t)r.y() * mImg.bytesPerLine() + (size_t)r.x() * cn;
+		cv::Mat src(r.height(), r.width(), CV_8UC(cn), (void*)ptr, mImg.bytesPerLine());
+
+		QImage tile(scaledSize, mImg.format());
+		cv::Mat dst(tile.height(), tile.width(), CV_8UC(cn), tile.bits(), tile.bytesPerLine());
+		cv::resize(src, dst, dst.size(), 0, 0, CV_INTER_AREA);
+
+		return tile;
+	}
+#endif
+
+	return mImg.copy(r).scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+// DkFileTileSource --------------------------------------------------------------------
+DkFileTileSource::DkFileTileSource(const QString& filePath, const QSize& size) {
+
+	mFilePath = filePath;
+	mSize = size;
+	mKey = filePath + "|" + QString::number(QFileInfo(filePath).lastModified().toMSecsSinceEpoch());
+}
+
+QSize DkFileTileSource::size() const {
+	return mSize;
+}
+
+QString DkFileTileSource::key() const {
+	return mKey;
+}
+
+#ifdef WITH_LIBTIFF
+static TIFF* openTiff(const QString& filePath) {
+
+#ifdef Q_OS_WIN
+	return TIFFOpenW((const wchar_t*)filePath.utf16(), "r");
+#else
+	return TIFFOpen(QFile::encodeName(filePath).constData(), "r");
+#endif
+}
+#endif
+
+/**
+ * Decodes a region of the file.
+ * Just the tiff tiles that intersect the region are read. Each of
+ * them is scaled to the region's resolution right away - so the
+ * preview (the whole image) needs a single tile in memory.
+ * @param rect the region in image pixels
+ * @param scaledSize the size of the returned image
+ * @return QImage the region or a null image if it could not be decoded
+ **/ 
+QImage DkFileTileSource::region(const QRect& rect, const QSize& scaledSize) const {
+
+#ifdef WITH_LIBTIFF
+	TIFF* tiff = openTiff(mFilePath);
+
+	if (!tiff) {
+		qWarning() << "[DkFileTileSource] could not open" << mFilePath;
+		return QImage();
+	}
+
+	uint32 tw = 0, th = 0;
+	TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &tw);
+	TIFFGetField(tiff, TIFFTAG_TILELENGTH, &th);
+
+	QImage img(scaledSize, QImage::Format_ARGB32);
+
+	if (tw == 0 || th == 0 || img.isNull() || rect.isEmpty()) {
+		TIFFClose(tiff);
+		return QImage();
+	}
+
+	img.fill(Qt::transparent);
+
+	double sx = (double)scaledSize.width() / rect.width();
+	double sy = (double)scaledSize.height() / rect.height();
+
+	QVector<uint32> raster(tw * th);
+	QImage tile(tw, th, QImage::Format_ARGB32);
+	QPainter painter(&img);
+	bool ok = true;
+
+	for (int y = rect.top() / th * th; y <= rect.bottom(); y += th) {
+		for (int x = rect.left() / tw * tw; x <= rect.right(); x += tw) {
+
+			// neighboring tiles share their edges (no seams)
+			QRect target(QPoint(qFloor((x - rect.left()) * sx), qFloor((y - rect.top()) * sy)), 
+						 QPoint(qFloor((x + (int)tw - rect.left()) * sx) - 1, qFloor((y + (int)th - rect.top()) * sy) - 1));
+
+			if (target.isEmpty())
+				continue;
+
+			if (!TIFFReadRGBATile(tiff, x, y, raster.data())) {
+				ok = false;
+				continue;
+			}
+
+			// the raster's origin is the lower left corner
+			for (int ty = 0; ty < (int)th; ty++) {
+
+				QRgb* dst = (QRgb*)tile.scanLine(ty);
+				const uint32* src = raster.constData() + (th - 1 - ty) * tw;
+
+				for (int tx = 0; tx < (int)tw; tx++)
+					dst[tx] = qRgba(TIFFGetR(src[tx]), TIFFGetG(src[tx]), TIFFGetB(src[tx]), TIFFGetA(src[tx]));
+			}
+
+			if (target.size() == tile.size())
+				painter.drawImage(target.topLeft(), tile);
+			else
+				painter.drawImage(target.topLeft(), tile.scaled(target.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+		}
+	}
+
+	painter.end();
+	TIFFClose(tiff);
+
+	if (!ok)
+		qWarning() << "[DkFileTileSource] could not decode all tiles of" << rect;
+
+	return img;
+#else
+	Q_UNUSED(rect);
+	Q_UNUSED(scaledSize);
+	return QImage();
+#endif
+}
+
+/**
+ * Returns true if regions of the file can be decoded.
+ * Just tiled tiffs can be read at random positions. Other decoders
+ * (e.g. jpg) decode all rows above a clip rect - hence, reading them
+ * tile by tile would decode the image over and over again.
+ * @param filePath the image file
+ * @return bool true if the file is a tiled tiff
+ **/ 
+bool DkFileTileSource::supports(const QString& filePath) {
+
+#ifdef WITH_LIBTIFF
+	QString suffix = QFileInfo(filePath).suffix().toLower();
+
+	if (suffix != "tif" && suffix != "tiff")
+		return false;
+
+	TIFF* tiff = openTiff(filePath);
+
+	if (!tiff)
+		return false;
+
+	bool tiled = TIFFIsTiled(tiff) != 0;
+	TIFFClose(tiff);
+
+	return tiled;
+#else
+	Q_UNUSED(filePath);
+	return false;
+#endif
+}
+
+// DkTileCache --------------------------------------------------------------------
+DkTileCache::DkTileCache() {
+
+	mTiles.setMaxCost(maxSize * 1024);	// KB
+}
+
+DkTileCache& DkTileCache::instance() {
+
+	static DkTileCache inst;
+	return inst;
+}
+
+QImage DkTileCache::find(const QString& key) {
+
+	QMutexLocker locker(&mMutex);
+	QImage* tile = mTiles.object(key);
+
+	return tile ? *tile : QImage();
+}
+
+/**
+ * Marks a tile as requested.
+ * @param key the tile's key
+ * @return bool false if the tile is decoded already
+ **/ 
+bool DkTileCache::request(const QString& key) {
+
+	QMutexLocker locker(&mMutex);
+
+	if (mPending.contains(key))
+		return false;
+
+	mPending.insert(key);
+	return true;
+}
+
+/**
+ * Adds a decoded tile.
+ * Null tiles (e.g. canceled) just clear the request.
+ * @param key the tile's key
+ * @param tile the decoded tile
+ **/ 
+void DkTileCache::insert(const QString& key, const QImage& tile) {
+
+	{
+		QMutexLocker locker(&mMutex);
+		mPending.remove(key);
+
+		if (tile.isNull())
+			return;
+
+		mTiles.insert(key, new QImage(tile), qMax(1, tile.byteCount() / 1024));
+	}
+
+	emit tileLoaded();
+}
+
+void DkTileCache::clear() {
+
+	QMutexLocker locker(&mMutex);
+	mTiles.clear();
+}
+
+// DkTilePyramid --------------------------------------------------------------------
+DkTilePyramid::DkTilePyramid(QSharedPointer<DkTileSource> source, const QImage& preview) {
+
+	mSource = source;
+	mPreview = preview;
+	mCancelToken = QSharedPointer<DkCancelToken>(new DkCancelToken());
+}
+
+DkTilePyramid::~DkTilePyramid() {
+
+	// queued tiles of this image are not needed anymore
+	mCancelToken->cancel();
+}
+
+QSize DkTilePyramid::size() const {
+	return mSource ? mSource->size() : QSize();
+}
+
+bool DkTilePyramid::needsTiles(const QSize& size) {
+	return qMax(size.width(), size.height()) > minSize;
+}
+
+/**
+ * Draws the visible tiles.
+ * The painter's world transform is considered to choose the level.
+ * @param painter the painter
+ * @param targetRect the rectangle the whole image is drawn to
+ * @param visibleRect the visible rectangle (in the same coordinates as targetRect)
+ **/ 
+void DkTilePyramid::draw(QPainter& painter, const QRectF& targetRect, const QRectF& visibleRect) {
+
+	QSize s = size();
+
+	if (s.isEmpty() || targetRect.isEmpty())
+		return;
+
+	// image pixels per target pixel
+	double sx = s.width() / targetRect.width();
+	double sy = s.height() / targetRect.height();
+
+	// device pixels per image pixel
+	double scale = painter.worldTransform().m11() / sx;
+
+	QImage pv = preview();
+
+	if (!pv.isNull()) {
+		painter.drawImage(targetRect, pv, pv.rect());
+
+		// the preview has enough pixels
+		if (scale <= (double)pv.width() / s.width())
+			return;
+	}
+
+	QRectF vis = visibleRect.intersected(targetRect);
+	QRect srcVis = QRectF(
+		(vis.x() - targetRect.x()) * sx, 
+		(vis.y() - targetRect.y()) * sy, 
+		vis.width() * sx, 
+		vis.height() * sy).toAlignedRect().intersected(QRect(QPoint(), s));
+
+	if (srcVis.isEmpty())
+		return;
+
+	int l = level(scale);
+	int ts = tileSize << l;		// tile size in image pixels
+
+	for (int ty = srcVis.top() / ts; ty <= srcVis.bottom() / ts; ty++) {
+		for (int tx = srcVis.left() / ts; tx <= srcVis.right() / ts; tx++) {
+
+			QRect r = QRect(tx * ts, ty * ts, ts, ts).intersected(QRect(QPoint(), s));
+			QSize scaledSize((r.width() + (1 << l) - 1) >> l, (r.height() + (1 << l) - 1) >> l);
+			QString key = QString("%1|%2|%3|%4").arg(mSource->key()).arg(l).arg(tx).arg(ty);
+
+			QImage t = tile(key, r, scaledSize);
+
+			if (t.isNull())
+				continue;
+
+			QRectF tr(targetRect.x() + r.x() / sx, targetRect.y() + r.y() / sy, r.width() / sx, r.height() / sy);
+			painter.drawImage(tr, t, t.rect());
+		}
+	}
+}
+
+QImage DkTilePyramid::preview() {
+
+	if (mPreview.isNull()) {
+		QSize s = size();
+		mPreview = tile(mSource->key() + "|preview", QRect(QPoint(), s), s.scaled(previewSize, previewSize, Qt::KeepAspectRatio));
+	}
+
+	return mPreview;
+}
+
+/**
+ * Returns a tile if it is cached - otherwise it is decoded in the background.
+ * @param key the tile's key
+ * @param rect the tile's region in image pixels
+ * @param scaledSize the tile's size
+ * @return QImage the tile or a null image if it is not decoded yet
+ **/ 
+QImage DkTilePyramid::tile(const QString& key, const QRect& rect, const QSize& scaledSize) {
+
+	QImage t = DkTileCache::instance().find(key);
+
+	if (!t.isNull() || !DkTileCache::instance().request(key))
+		return t;
+
+	QSharedPointer<DkTileSource> source = mSource;
+	QSharedPointer<DkCancelToken> token = mCancelToken;
+
+	DkThreadPools::instance().run(DkThreadPools::lane_current_decode, [source, token, key, rect, scaledSize]() {
+
+		QImage img;
+
+		if (!token->isCanceled())
+			img = source->region(rect, scaledSize);
+
+		DkTileCache::instance().insert(key, img);
+	});
+
+	return t;
+}
+
+/**
+ * Returns the coarsest level that has enough pixels.
+ * @param scale device pixels per image pixel
+ * @return int the level
+ **/ 
+int DkTilePyramid::level(double scale) const {
+
+	int l = 0;
+
+	while (l < 16 && scale * (1 << (l + 1)) <= 1.0)
+		l++;
+
+	return l;
+}
+
+};
@@ -0,0 +1,178 @@
+/*******************************************************************************************************
+ DkTiledImage.h
+ Created on:	18.10.2026
+ 
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+ 
+ Copyright (C) 2011-2016 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2016 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2016 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#pragma warning(pop)		// no warnings from includes - end
+
+#pragma warning(disable: 4251)	// TODO: remove
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+class QPainter;
+
+namespace nmc {
+
+// nomacs defines
+class DkCancelToken;
+
+/**
+ * Provides (scaled) regions of an image.
+ * region() is called from worker threads.
+ **/ 
+class DllCoreExport DkTileSource {
+
+public:
+	virtual ~DkTileSource() {};
+
+	virtual QSize size() const = 0;
+	virtual QString key() const = 0;
+	virtual QImage region(const QRect& rect, const QSize& scaledSize) const = 0;
+};
+
+/**
+ * Tiles of an image that is in memory.
+ **/ 
+class DllCoreExport DkImageTileSource : public DkTileSource {
+
+public:
+	DkImageTileSource(const QImage& img);
+
+	QSize size() const override;
+	QString key() const override;
+	QImage region(const QRect& rect, const QSize& scaledSize) const override;
+
+protected:
+	QImage mImg;
+};
+
+/**
+ * Tiles that are decoded from the file.
+ * Just the visible region is decoded, hence the image
+ * does not need to fit into memory. This works for tiled
+ * tiffs whose tiles can be read at random positions.
+ **/ 
+class DllCoreExport DkFileTileSource : public DkTileSource {
+
+public:
+	DkFileTileSource(const QString& filePath, const QSize& size);
+
+	QSize size() const override;
+	QString key() const override;
+	QImage region(const QRect& rect, const QSize& scaledSize) const override;
+
+	static bool supports(const QString& filePath);
+
+protected:
+	QString mFilePath;
+	QSize mSize;
+	QString mKey;
+};
+
+/**
+ * Least recently used cache of decoded tiles.
+ * The cache is shared by all viewports. tileLoaded is
+ * emitted if a tile, that was requested, arrives.
+ **/ 
+class DllCoreExport DkTileCache : public QObject {
+	Q_OBJECT
+
+public:
+	static DkTileCache& instance();
+
+	// singleton
+	DkTileCache(DkTileCache const&)			= delete;
+	void operator=(DkTileCache const&)		= delete;
+
+	QImage find(const QString& key);
+	bool request(const QString& key);
+	void insert(const QString& key, const QImage& tile);
+	void clear();
+
+	static const int maxSize = 256;	// MB
+
+signals:
+	void tileLoaded() const;
+
+private:
+	DkTileCache();
+
+	QMutex mMutex;
+	QCache<QString, QImage> mTiles;
+	QSet<QString> mPending;		// tiles that are decoded
+};
+
+/**
+ * Multi-resolution tile pyramid of an image.
+ * Level l has 1/2^l of the image's resolution and is split
+ * into tiles of tileSize x tileSize pixels. Tiles are decoded
+ * on demand (just the visible ones) and kept in the DkTileCache.
+ * A preview of the whole image is drawn beneath the tiles
+ * so that views never have holes while tiles are decoded.
+ **/ 
+class DllCoreExport DkTilePyramid {
+
+public:
+	DkTilePyramid(QSharedPointer<DkTileSource> source, const QImage& preview = QImage());
+	~DkTilePyramid();
+
+	void draw(QPainter& painter, const QRectF& targetRect, const QRectF& visibleRect);
+	QSize size() const;
+
+	static bool needsTiles(const QSize& size);
+
+	static const int tileSize = 512;
+	static const int previewSize = 2048;
+	static const int minSize = 16384;	// images with a larger side are tiled
+
+protected:
+	QImage preview();
+	QImage tile(const QString& key, const QRect& rect, const QSize& scaledSize);
+	int level(double scale) const;
+
+	QSharedPointer<DkTileSource> mSource;
+	QSharedPointer<DkCancelToken> mCancelToken;
+	QImage mPreview;
+};
+
+};
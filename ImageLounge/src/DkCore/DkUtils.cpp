@@ -40,6 +40,7 @@
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QString>
 #include <QFileInfo>
+#include <QFile>
 #include <QDate>
 #include <QRegExp>
 #include <QStringList>
@@ -182,9 +183,24 @@ double DkMemory::getFreeMemory() {
 
 #elif defined Q_OS_LINUX and not defined(Q_OS_OPENBSD)
 
+	// freeram does not count the page cache - MemAvailable does (kernel >= 3.14)
+	QFile memInfo("/proc/meminfo");
+
+	if (memInfo.open(QIODevice::ReadOnly)) {
+
+		QList<QByteArray> lines = memInfo.readAll().split('\n');
+
+		for (const QByteArray& line : lines) {
+			if (line.startsWith("MemAvailable:")) {
+				mem = line.simplified().split(' ').value(1).toDouble()*1024;	// kB
+				break;
+			}
+		}
+	}
+
 	struct sysinfo info;
 
-	if (!sysinfo(&info))
+	if (mem <= 0 && !sysinfo(&info))
 		mem = info.freeram;
 
 #elif defined Q_OS_MAC
@@ -805,7 +805,7 @@ void DkCentralWidget::showViewPort(bool show /* = true */) {
 	if (show) {
 		switchWidget(mWidgets[viewport_widget]);
 		if (getCurrentImage())
-			mViewport->setImage(getCurrentImage()->image());
+			mViewport->setImage(getCurrentImage()->displayImage());
 	}
 	else 
 		mViewport->deactivate();
@@ -816,7 +816,7 @@ void DkCentralWidget::showRecentFiles(bool show) {
 
 	// TODO: fix the missing recent files (e.g. after the thumbnails are loaded once)
 	if (show && currentViewMode() != DkTabInfo::tab_preferences) {
-		mRecentFilesWidget->setCustomStyle(!mViewport->getImage().isNull() || (getThumbScrollWidget() && getThumbScrollWidget()->isVisible()));
+		mRecentFilesWidget->setCustomStyle(!mViewport->getImageSize().isEmpty() || (getThumbScrollWidget() && getThumbScrollWidget()->isVisible()));
 		mRecentFilesWidget->raise();
 		mRecentFilesWidget->show();
 	}
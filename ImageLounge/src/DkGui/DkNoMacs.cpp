@@ -662,7 +662,7 @@ void DkNoMacs::moveEvent(QMoveEvent *event) {
 
 void DkNoMacs::mouseDoubleClickEvent(QMouseEvent* event) {
 
-	if (event->button() != Qt::LeftButton || (viewport() && viewport()->getImage().isNull()))
+	if (event->button() != Qt::LeftButton || (viewport() && viewport()->getImageSize().isEmpty()))
 		return;
 
 	if (isFullScreen())
@@ -1601,7 +1601,7 @@ void DkNoMacs::extractImagesFromArchive() {
 
 void DkNoMacs::resizeImage() {
 
-	if (!viewport() || viewport()->getImage().isNull())
+	if (!viewport() || viewport()->getImageSize().isEmpty())
 		return;
 
 	viewport()->getController()->applyPluginChanges(true);
@@ -1618,39 +1618,40 @@ void DkNoMacs::resizeImage() {
 		mResizeDialog->setExifDpi((float)res.x());
 	}
 
-	qDebug() << "resize image: " << viewport()->getImage().size();
+	// the dialog needs all pixels
+	viewport()->runWithFullImage([this, imgC, metaData]() {
 
+		mResizeDialog->setImage(viewport()->getImage());
 
-	mResizeDialog->setImage(viewport()->getImage());
-
-	if (!mResizeDialog->exec())
-		return;
+		if (!mResizeDialog->exec())
+			return;
 
-	if (mResizeDialog->resample()) {
+		if (mResizeDialog->resample()) {
 
-		QImage rImg = mResizeDialog->getResizedImage();
+			QImage rImg = mResizeDialog->getResizedImage();
 
-		if (!rImg.isNull()) {
+			if (!rImg.isNull()) {
 
-			// this reloads the image -> that's not what we want!
-			if (metaData)
-				metaData->setResolution(QVector2D(mResizeDialog->getExifDpi(), mResizeDialog->getExifDpi()));
+				// this reloads the image -> that's not what we want!
+				if (metaData)
+					metaData->setResolution(QVector2D(mResizeDialog->getExifDpi(), mResizeDialog->getExifDpi()));
 
-			imgC->setImage(rImg, tr("Resize"));
-			viewport()->setEditedImage(imgC);
+				imgC->setImage(rImg, tr("Resize"));
+				viewport()->setEditedImage(imgC);
+			}
 		}
-	}
-	else if (metaData) {
-		// ok, user just wants to change the resolution
-		metaData->setResolution(QVector2D(mResizeDialog->getExifDpi(), mResizeDialog->getExifDpi()));
-		qDebug() << "setting resolution to: " << mResizeDialog->getExifDpi();
-		//mViewport()->setEditedImage(mViewport()->getImage());
-	}
+		else if (metaData) {
+			// ok, user just wants to change the resolution
+			metaData->setResolution(QVector2D(mResizeDialog->getExifDpi(), mResizeDialog->getExifDpi()));
+			qDebug() << "setting resolution to: " << mResizeDialog->getExifDpi();
+			//mViewport()->setEditedImage(mViewport()->getImage());
+		}
+	});
 }
 
 void DkNoMacs::deleteFile() {
 
-	if (!viewport() || viewport()->getImage().isNull() || !getTabWidget()->getCurrentImageLoader())
+	if (!viewport() || viewport()->getImageSize().isEmpty() || !getTabWidget()->getCurrentImageLoader())
 		return;
 	
 	viewport()->getController()->applyPluginChanges(true);
@@ -1754,14 +1755,17 @@ void DkNoMacs::printDialog() {
 		res = imgC->getMetaData()->getResolution();
 
 	//QPrintPreviewDialog* previewDialog = new QPrintPreviewDialog();
-	QImage img = viewport()->getImage();
-	if (!mPrintPreviewDialog)
-		mPrintPreviewDialog = new DkPrintPreviewDialog(img, (float)res.x(), 0, this);
-	else
-		mPrintPreviewDialog->setImage(img, (float)res.x());
+	viewport()->runWithFullImage([this, res]() {
+
+		QImage img = viewport()->getImage();
+		if (!mPrintPreviewDialog)
+			mPrintPreviewDialog = new DkPrintPreviewDialog(img, (float)res.x(), 0, this);
+		else
+			mPrintPreviewDialog->setImage(img, (float)res.x());
 
-	mPrintPreviewDialog->show();
-	mPrintPreviewDialog->updateZoomFactor(); // otherwise the initial zoom factor is wrong
+		mPrintPreviewDialog->show();
+		mPrintPreviewDialog->updateZoomFactor(); // otherwise the initial zoom factor is wrong
+	});
 }
 
 void DkNoMacs::computeThumbsBatch() {
@@ -1769,6 +1773,13 @@ void DkNoMacs::computeThumbsBatch() {
 	if (!viewport())
 		return;
 
+	// we need all images of the folder
+	QSharedPointer<DkImageLoader> loader = getTabWidget()->getCurrentImageLoader();
+	if (loader && loader->isScanning()) {
+		viewport()->getController()->setInfo(tr("Please wait until the folder is indexed."));
+		return;
+	}
+
 	if (!mForceDialog)
 		mForceDialog = new DkForceThumbDialog(this);
 	mForceDialog->setWindowTitle(tr("Save Thumbnails"));
@@ -1780,8 +1791,8 @@ void DkNoMacs::computeThumbsBatch() {
 	if (!mThumbSaver)
 		mThumbSaver = new DkThumbsSaver(this);
 	
-	if (getTabWidget()->getCurrentImageLoader())
-		mThumbSaver->processDir(getTabWidget()->getCurrentImageLoader()->getImages(), mForceDialog->forceSave());
+	if (loader)
+		mThumbSaver->processDir(loader->getImages(), mForceDialog->forceSave());
 }
 
 void DkNoMacs::aboutDialog() {
@@ -2098,7 +2109,7 @@ void DkNoMacs::setWindowTitle(QSharedPointer<DkImageContainerT> imgC) {
 		return;
 	}
 
-	setWindowTitle(imgC->filePath(), imgC->image().size(), imgC->isEdited(), imgC->getTitleAttribute());
+	setWindowTitle(imgC->filePath(), imgC->imageSize(), imgC->isEdited(), imgC->getTitleAttribute());
 }
 
 void DkNoMacs::setWindowTitle(const QString& filePath, const QSize& size, bool edited, const QString& attr) {
@@ -2130,7 +2141,7 @@ void DkNoMacs::setWindowTitle(const QString& filePath, const QSize& size, bool e
 	if (!size.isEmpty())
 		attributes.sprintf(" - %i x %i", size.width(), size.height());
 	if (size.isEmpty() && viewport() && !viewport()->getImageSize().isEmpty())
-		attributes.sprintf(" - %i x %i", viewport()->getImage().width(), viewport()->getImage().height());
+		attributes.sprintf(" - %i x %i", viewport()->getImageSize().width(), viewport()->getImageSize().height());
 	if (DkSettingsManager::param().app().privateMode) 
 		attributes.append(tr(" [Private Mode]"));
 
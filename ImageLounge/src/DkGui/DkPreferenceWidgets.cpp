@@ -1221,12 +1221,18 @@ void DkAdvancedPreference::createLayout() {
 	cbFilterRaw->setToolTip(tr("If checked, a noise filter is applied which reduced color noise"));
 	cbFilterRaw->setChecked(DkSettingsManager::param().resources().filterRawImages);
 
+	QCheckBox* cbRawHalfSize = new QCheckBox(tr("Develop RAW Images at Half Size for Viewing"), this);
+	cbRawHalfSize->setObjectName("rawHalfSize");
+	cbRawHalfSize->setToolTip(tr("If checked, RAW data is binned rather than demosaiced. All pixels are developed if you zoom in or save the image."));
+	cbRawHalfSize->setChecked(DkSettingsManager::param().resources().rawHalfSize);
+
 	DkGroupWidget* loadRawGroup = new DkGroupWidget(tr("RAW Loader Settings"), this);
 	loadRawGroup->addWidget(loadRawButtons[DkSettings::raw_thumb_always]);
 	loadRawGroup->addWidget(loadRawButtons[DkSettings::raw_thumb_if_large]);
 	loadRawGroup->addWidget(loadRawButtons[DkSettings::raw_thumb_never]);
 	loadRawGroup->addSpace();
 	loadRawGroup->addWidget(cbFilterRaw);
+	loadRawGroup->addWidget(cbRawHalfSize);
 
 	// file loading
 	QCheckBox* cbSaveDeleted = new QCheckBox(tr("Ask to Save Deleted Files"), this);
@@ -1245,10 +1251,16 @@ void DkAdvancedPreference::createLayout() {
 		tr("NOTE: this allows for rotating JPGs without losing information."));
 	cbSaveExif->setChecked(DkSettingsManager::param().metaData().saveExifOrientation);
 
+	QCheckBox* cbCacheThumbs = new QCheckBox(tr("Cache Thumbnails"), this);
+	cbCacheThumbs->setObjectName("cacheThumbs");
+	cbCacheThumbs->setToolTip(tr("If checked, thumbnails are stored in the shared thumbnail folder so that they are not computed again."));
+	cbCacheThumbs->setChecked(DkSettingsManager::param().resources().cacheThumbs);
+
 	DkGroupWidget* loadFileGroup = new DkGroupWidget(tr("File Loading/Saving"), this);
 	loadFileGroup->addWidget(cbSaveDeleted);
 	loadFileGroup->addWidget(cbIgnoreExif);
 	loadFileGroup->addWidget(cbSaveExif);
+	loadFileGroup->addWidget(cbCacheThumbs);
 
 	// batch processing
 	QSpinBox* sbNumThreads = new QSpinBox(this);
@@ -1299,6 +1311,18 @@ void DkAdvancedPreference::on_filterRaw_toggled(bool checked) const {
 		DkSettingsManager::param().resources().filterRawImages = checked;
 }
 
+void DkAdvancedPreference::on_rawHalfSize_toggled(bool checked) const {
+
+	if (DkSettingsManager::param().resources().rawHalfSize != checked)
+		DkSettingsManager::param().resources().rawHalfSize = checked;
+}
+
+void DkAdvancedPreference::on_cacheThumbs_toggled(bool checked) const {
+
+	if (DkSettingsManager::param().resources().cacheThumbs != checked)
+		DkSettingsManager::param().resources().cacheThumbs = checked;
+}
+
 void DkAdvancedPreference::on_saveDeleted_toggled(bool checked) const {
 
 	if (DkSettingsManager::param().global().askToSaveDeletedFiles != checked)
@@ -257,6 +257,8 @@ public:
 public slots:
 	void on_loadRaw_buttonClicked(int buttonId) const;
 	void on_filterRaw_toggled(bool checked) const;
+	void on_rawHalfSize_toggled(bool checked) const;
+	void on_cacheThumbs_toggled(bool checked) const;
 	void on_saveDeleted_toggled(bool checked) const;
 	void on_ignoreExif_toggled(bool checked) const;
 	void on_saveExif_toggled(bool checked) const;
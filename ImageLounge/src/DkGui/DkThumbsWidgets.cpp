@@ -863,7 +863,6 @@ void DkFilePreview::setVisible(bool visible, bool saveSettings) {
 DkThumbLabel::DkThumbLabel(QSharedPointer<DkThumbNailT> thumb, QGraphicsItem* parent) : QGraphicsObject(parent), mText(this) {
 
 	mThumbInitialized = false;
-	mFetchingThumb = false;
 	mIsHovered = false;
 
 	//imgLabel = new QLabel(this);
@@ -889,7 +888,18 @@ DkThumbLabel::~DkThumbLabel() {}
 
 void DkThumbLabel::setThumb(QSharedPointer<DkThumbNailT> thumb) {
 
+	// recycled labels are bound to another thumbnail
+	if (mThumb)
+		disconnect(mThumb.data(), SIGNAL(thumbLoadedSignal()), this, SLOT(updateLabel()));
+
 	this->mThumb = thumb;
+	mThumbInitialized = false;
+	mIsHovered = false;
+	mIcon.setPixmap(QPixmap());
+	mIcon.setScale(1.0f);
+	mIcon.setPos(0,0);
+	mText.setPlainText("");
+	setFlag(ItemIsSelectable, true);
 
 	if (thumb.isNull())
 		return;
@@ -914,6 +924,23 @@ void DkThumbLabel::setThumb(QSharedPointer<DkThumbNailT> thumb) {
 	//selectPen.setWidth(2);
 }
 
+void DkThumbLabel::setIndex(int idx) {
+	mIdx = idx;
+}
+
+int DkThumbLabel::index() const {
+	return mIdx;
+}
+
+QVariant DkThumbLabel::itemChange(GraphicsItemChange change, const QVariant& value) {
+
+	// the scene keeps the selection of labels that are recycled
+	if (change == ItemSelectedChange && mIdx != -1)
+		emit selectedSignal(mIdx, value.toBool());
+
+	return QGraphicsObject::itemChange(change, value);
+}
+
 QPixmap DkThumbLabel::pixmap() const {
 
 	return mIcon.pixmap();
@@ -1041,12 +1068,8 @@ void DkThumbLabel::setVisible(bool visible) {
 
 void DkThumbLabel::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
 	
-	if (!mFetchingThumb && mThumb->hasImage() == DkThumbNail::not_loaded && 
-		DkSettingsManager::param().resources().numThumbsLoading < DkSettingsManager::param().resources().maxThumbsLoading*2) {
-			mThumb->fetchThumb();
-			mFetchingThumb = true;
-	}
-	else if (!mThumbInitialized && (mThumb->hasImage() == DkThumbNail::loaded || mThumb->hasImage() == DkThumbNail::exists_not)) {
+	// thumbnails are fetched by the scene's scheduler
+	if (!mThumbInitialized && (mThumb->hasImage() == DkThumbNail::loaded || mThumb->hasImage() == DkThumbNail::exists_not)) {
 		updateLabel();
 		mThumbInitialized = true;
 		return;		// exit - otherwise we get paint errors
@@ -1129,11 +1152,15 @@ DkThumbScene::DkThumbScene(QWidget* parent /* = 0 */) : QGraphicsScene(parent) {
 
 	setObjectName("DkThumbWidget");
 
+	// we just have a few labels that are moved around
+	setItemIndexMethod(QGraphicsScene::NoIndex);
+
+	mScheduler = new DkThumbScheduler(this);
 }
 
 void DkThumbScene::updateLayout() {
 
-	if (mThumbLabels.empty())
+	if (mThumbs.empty())
 		return;
 
 	QSize pSize;
@@ -1144,77 +1171,197 @@ void DkThumbScene::updateLayout() {
     int psz = DkSettingsManager::param().effectiveThumbPreviewSize();
 	mXOffset = qCeil(psz*0.1f);
 	mNumCols = qMax(qFloor(((float)pSize.width()-mXOffset)/(psz + mXOffset)), 1);
-	mNumCols = qMin(mThumbLabels.size(), mNumCols);
-	mNumRows = qCeil((float)mThumbLabels.size()/mNumCols);
+	mNumCols = qMin(mThumbs.size(), mNumCols);
+	mNumRows = qCeil((float)mThumbs.size()/mNumCols);
 
 	int tso = psz+mXOffset;
 	setSceneRect(0, 0, mNumCols*tso+mXOffset, mNumRows*tso+mXOffset);
-	//int fileIdx = thumbPool->getCurrentFileIdx();
 
-	DkTimer dt;
-	int cYOffset = mXOffset;
+	updateVisibleThumbs();
 
-	for (int rIdx = 0; rIdx < mNumRows; rIdx++) {
+	int selIdx = mSelected.lastIndexOf(true);
 
-		int cXOffset = mXOffset;
+	if (selIdx != -1 && !views().empty())
+		views().first()->ensureVisible(thumbRect(selIdx));
 
-		for (int cIdx = 0; cIdx < mNumCols; cIdx++) {
+	mFirstLayout = false;
+}
 
-			int tIdx = rIdx*mNumCols+cIdx;
+/**
+ * Binds labels to the thumbnails within (or close to) the viewport.
+ * Labels that left this region are recycled. Hence, just a few
+ * hundred labels exist - no matter how large the folder is.
+ **/ 
+void DkThumbScene::updateVisibleThumbs() {
 
-			if (tIdx < 0 || tIdx >= mThumbLabels.size())
-				break;
+	if (views().empty() || mNumCols <= 0)
+		return;
+
+	QGraphicsView* view = views().first();
+	QRectF vr = view->mapToScene(view->viewport()->rect()).boundingRect();
+
+	int tso = DkSettingsManager::param().effectiveThumbPreviewSize() + mXOffset;
+	int margin = qCeil(vr.height()/tso);	// one screen above & below - so scrolling does not flicker
+
+	int firstRow = qMax(qFloor((vr.top()-mXOffset)/tso) - margin, 0);
+	int lastRow = qMin(qFloor((vr.bottom()-mXOffset)/tso) + margin, mNumRows-1);
+	int first = firstRow*mNumCols;
+	int last = qMin((lastRow+1)*mNumCols, mThumbs.size())-1;
+
+	blockSignals(true);	// do not emit selection changed while recycling
+
+	for (auto it = mThumbLabels.begin(); it != mThumbLabels.end();) {
+
+		if (it.key() < first || it.key() > last) {
+			releaseLabel(it.value());
+			it = mThumbLabels.erase(it);
+		}
+		else
+			++it;
+	}
 
-			DkThumbLabel* cLabel = mThumbLabels.at(tIdx);
-			cLabel->setPos(cXOffset, cYOffset);
-			cLabel->updateSize();
+	for (int idx = first; idx <= last; idx++) {
 
-			cXOffset += psz + mXOffset;
+		DkThumbLabel* label = mThumbLabels.value(idx);
+
+		if (!label)
+			label = bindLabel(idx);
+
+		label->setPos(thumbRect(idx).topLeft());
+		label->updateSize();
+	}
+
+	blockSignals(false);
+
+	// remember the direction for speculative loading
+	if (vr.top() != mLastViewTop)
+		mScrollDir = vr.top() > mLastViewTop ? 1 : -1;
+	mLastViewTop = vr.top();
+
+	scheduleThumbs(vr);
+}
+
+/**
+ * Requests the thumbnails of the live labels.
+ * Thumbnails are loaded by their distance to the viewport's center.
+ * Labels outside the viewport are just requested if they are ahead
+ * in scroll direction - jobs of the others are canceled.
+ * @param vr the viewport in scene coordinates
+ **/ 
+void DkThumbScene::scheduleThumbs(const QRectF& vr) {
+
+	QVector<QPair<double, QSharedPointer<DkThumbNailT> > > requests;
+	QPointF vc = vr.center();
+
+	for (auto it = mThumbLabels.constBegin(); it != mThumbLabels.constEnd(); ++it) {
+
+		QRectF r = thumbRect(it.key());
+		double dist = QLineF(r.center(), vc).length();
+
+		if (!vr.intersects(r)) {
+
+			if (mScrollDir != 0 && (r.center().y() - vc.y()) * mScrollDir < 0)
+				continue;
+
+			dist += vr.height();	// visible thumbs first
 		}
 
-		// update ypos
-		cYOffset += psz + mXOffset;	// 20 for label 
+		requests << qMakePair(dist, it.value()->getThumb());
 	}
 
-	for (int idx = 0; idx < mThumbLabels.size(); idx++) {
+	mScheduler->setRequests(requests);
+}
+
+QRectF DkThumbScene::thumbRect(int idx) const {
+
+	int psz = DkSettingsManager::param().effectiveThumbPreviewSize();
+	int tso = psz + mXOffset;
+	int numCols = qMax(mNumCols, 1);
+
+	return QRectF(mXOffset + (idx % numCols)*tso, mXOffset + (idx / numCols)*tso, psz, psz);
+}
+
+DkThumbLabel* DkThumbScene::bindLabel(int idx) {
+
+	DkThumbLabel* label = 0;
 
-		if (mThumbLabels.at(idx)->isSelected())
-			mThumbLabels.at(idx)->ensureVisible();
+	if (!mLabelPool.empty()) {
+		label = mLabelPool.takeLast();
+		label->show();
+	}
+	else {
+		label = new DkThumbLabel();
+		connect(label, SIGNAL(loadFileSignal(const QString&)), this, SLOT(loadFile(const QString&)));
+		connect(label, SIGNAL(showFileSignal(const QString&)), this, SLOT(showFile(const QString&)));
+		connect(label, SIGNAL(selectedSignal(int, bool)), this, SLOT(thumbSelected(int, bool)));
+		addItem(label);
 	}
 
-	//update();
+	QSharedPointer<DkImageContainerT> imgC = mThumbs.at(idx);
+	connect(imgC.data(), SIGNAL(thumbLoadedSignal()), this, SIGNAL(thumbLoadedSignal()), Qt::UniqueConnection);
 
-	//if (verticalScrollBar()->isVisible())
-	//	verticalScrollBar()->update();
+	label->setThumb(imgC->getThumb());
+	label->setSelected(mSelected.at(idx));
+	label->setIndex(idx);
+	mThumbLabels.insert(idx, label);
 
-	mFirstLayout = false;
+	return label;
+}
+
+void DkThumbScene::releaseLabel(DkThumbLabel* label) {
+
+	int idx = label->index();
+
+	if (idx >= 0 && idx < mThumbs.size())
+		disconnect(mThumbs.at(idx).data(), SIGNAL(thumbLoadedSignal()), this, SIGNAL(thumbLoadedSignal()));
+
+	label->setIndex(-1);	// keeps the selection if the label is hidden
+	label->hide();
+	label->setThumb(QSharedPointer<DkThumbNailT>());
+	mLabelPool << label;
+}
+
+bool DkThumbScene::isSelectable(int idx) const {
+
+	// thumbnails that cannot be loaded are not selectable
+	return mThumbs.at(idx)->getThumb()->hasImage() != DkThumbNail::exists_not;
+}
+
+void DkThumbScene::thumbSelected(int idx, bool selected) {
+
+	if (idx >= 0 && idx < mSelected.size())
+		mSelected[idx] = selected;
 }
 
 void DkThumbScene::updateThumbs(QVector<QSharedPointer<DkImageContainerT> > thumbs) {
 
+	// release the labels while they still match the old thumbs
+	mScheduler->cancelAll();
+	blockSignals(true);
+	for (DkThumbLabel* label : mThumbLabels)
+		releaseLabel(label);
+	mThumbLabels.clear();
+	blockSignals(false);
+
 	this->mThumbs = thumbs;
 	updateThumbLabels();
 }
 
 void DkThumbScene::updateThumbLabels() {
 
+	mScheduler->cancelAll();
+
 	blockSignals(true);	// do not emit selection changed while clearing!
+	for (DkThumbLabel* label : mThumbLabels)
+		releaseLabel(label);
 	clear();	// deletes the thumbLabels
 	blockSignals(false);
 
 	mThumbLabels.clear();
-
-	for (int idx = 0; idx < mThumbs.size(); idx++) {
-		DkThumbLabel* thumb = new DkThumbLabel(mThumbs.at(idx)->getThumb());
-		connect(thumb, SIGNAL(loadFileSignal(const QString&)), this, SLOT(loadFile(const QString&)));
-		connect(thumb, SIGNAL(showFileSignal(const QString&)), this, SLOT(showFile(const QString&)));
-		connect(mThumbs.at(idx).data(), SIGNAL(thumbLoadedSignal()), this, SIGNAL(thumbLoadedSignal()));
-
-		//thumb->show();
-		addItem(thumb);
-		mThumbLabels.append(thumb);
-		//thumbsNotLoaded.append(thumb);
-	}
+	mLabelPool.clear();
+	mSelected = QVector<bool>(mThumbs.size(), false);
+	mNumCols = 0;
+	mNumRows = 0;
 
 	showFile();
 
@@ -1252,7 +1399,7 @@ void DkThumbScene::showFile(const QString& filePath) {
 		if (sf > 1)
 			DkStatusBarManager::instance().setMessage(tr("%1 selected").arg(QString::number(sf)));
 		else
-			DkStatusBarManager::instance().setMessage(tr("%1 images").arg(QString::number(mThumbLabels.size())));
+			DkStatusBarManager::instance().setMessage(tr("%1 images").arg(QString::number(mThumbs.size())));
 	}
 	else
 		DkStatusBarManager::instance().setMessage(QFileInfo(filePath).fileName());
@@ -1261,13 +1408,13 @@ void DkThumbScene::showFile(const QString& filePath) {
 
 void DkThumbScene::ensureVisible(QSharedPointer<DkImageContainerT> img) const {
 
-	if (!img)
+	if (!img || views().empty())
 		return;
 
-	for (DkThumbLabel* label : mThumbLabels) {
+	for (int idx = 0; idx < mThumbs.size(); idx++) {
 
-		if (label->getThumb()->getFilePath() == img->filePath()) {
-			label->ensureVisible();
+		if (mThumbs.at(idx)->filePath() == img->filePath()) {
+			views().first()->ensureVisible(thumbRect(idx));
 			break;
 		}
 	}
@@ -1278,8 +1425,8 @@ void DkThumbScene::toggleThumbLabels(bool show) {
 
 	DkSettingsManager::param().display().showThumbLabel = show;
 
-	for (int idx = 0; idx < mThumbLabels.size(); idx++)
-		mThumbLabels.at(idx)->updateLabel();
+	for (DkThumbLabel* label : mThumbLabels)
+		label->updateLabel();
 
 	//// well, that's not too beautiful
 	//if (DkSettingsManager::param().display().displaySquaredThumbs)
@@ -1290,8 +1437,8 @@ void DkThumbScene::toggleSquaredThumbs(bool squares) {
 
 	DkSettingsManager::param().display().displaySquaredThumbs = squares;
 
-	for (int idx = 0; idx < mThumbLabels.size(); idx++)
-		mThumbLabels.at(idx)->updateLabel();
+	for (DkThumbLabel* label : mThumbLabels)
+		label->updateLabel();
 
 	// well, that's not too beautiful
 	if (DkSettingsManager::param().display().displaySquaredThumbs)
@@ -1335,11 +1482,11 @@ void DkThumbScene::selectAllThumbs(bool selected) {
 
 void DkThumbScene::selectThumbs(bool selected /* = true */, int from /* = 0 */, int to /* = -1 */) {
 
-	if (mThumbLabels.empty())
+	if (mThumbs.empty())
 		return;
 
 	if (to == -1)
-		to = mThumbLabels.size()-1;
+		to = mThumbs.size()-1;
 
 	if (from > to) {
 		int tmp = to;
@@ -1348,8 +1495,13 @@ void DkThumbScene::selectThumbs(bool selected /* = true */, int from /* = 0 */,
 	}
 
 	blockSignals(true);
-	for (int idx = from; idx <= to && idx < mThumbLabels.size(); idx++) {
-		mThumbLabels.at(idx)->setSelected(selected);
+	for (int idx = from; idx <= to && idx < mThumbs.size(); idx++) {
+		
+		mSelected[idx] = selected && isSelectable(idx);
+		
+		DkThumbLabel* label = mThumbLabels.value(idx);
+		if (label)
+			label->setSelected(mSelected[idx]);
 	}
 	blockSignals(false);
 	emit selectionChanged();
@@ -1512,23 +1664,22 @@ QStringList DkThumbScene::getSelectedFiles() const {
 
 	QStringList fileList;
 
-	for (int idx = 0; idx < mThumbLabels.size(); idx++) {
+	for (int idx = 0; idx < mSelected.size(); idx++) {
 
-		if (mThumbLabels.at(idx) && mThumbLabels.at(idx)->isSelected()) {
-			fileList.append(mThumbLabels.at(idx)->getThumb()->getFilePath());
-		}
+		if (mSelected.at(idx))
+			fileList.append(mThumbs.at(idx)->filePath());
 	}
 
 	return fileList;
 }
 
-QVector<DkThumbLabel*> DkThumbScene::getSelectedThumbs() const {
+QVector<QSharedPointer<DkImageContainerT> > DkThumbScene::getSelectedThumbs() const {
 
-	QVector<DkThumbLabel*> selected;
+	QVector<QSharedPointer<DkImageContainerT> > selected;
 
-	for (DkThumbLabel* label : mThumbLabels) {
-		if (label->isSelected())
-			selected << label;
+	for (int idx = 0; idx < mSelected.size(); idx++) {
+		if (mSelected.at(idx))
+			selected << mThumbs.at(idx);
 	}
 
 	return selected;
@@ -1536,22 +1687,13 @@ QVector<DkThumbLabel*> DkThumbScene::getSelectedThumbs() const {
 
 int DkThumbScene::findThumb(DkThumbLabel* thumb) const {
 
-	int thumbIdx = -1;
-
-	for (int idx = 0; idx < mThumbLabels.size(); idx++) {
-		if (thumb == mThumbLabels.at(idx)) {
-			thumbIdx = idx;
-			break;
-		}
-	}
-
-	return thumbIdx;
+	return thumb ? thumb->index() : -1;
 }
 
 bool DkThumbScene::allThumbsSelected() const {
 
-	for (DkThumbLabel* label : mThumbLabels)
-		if (label->flags() & QGraphicsItem::ItemIsSelectable && !label->isSelected())
+	for (int idx = 0; idx < mSelected.size(); idx++)
+		if (!mSelected.at(idx) && isSelectable(idx))
 			return false;
 
 	return true;
@@ -1562,7 +1704,7 @@ DkThumbsView::DkThumbsView(DkThumbScene* scene, QWidget* parent /* = 0 */) : QGr
 
 	setObjectName("DkThumbsView");
 	this->scene = scene;
-	connect(scene, SIGNAL(thumbLoadedSignal()), this, SLOT(fetchThumbs()));
+	connect(verticalScrollBar(), SIGNAL(valueChanged(int)), scene, SLOT(updateVisibleThumbs()));
 
 	//setDragMode(QGraphicsView::RubberBandDrag);
 
@@ -1608,8 +1750,14 @@ void DkThumbsView::mousePressEvent(QMouseEvent *event) {
 	// what we want to achieve: if the user is selecting with e.g. shift or ctrl 
 	// and he clicks (unintentionally) into the background - the selection would be lost
 	// otherwise so we just don't propagate this event
-	if (itemClicked || event->modifiers() == Qt::NoModifier)	
+	if (itemClicked || event->modifiers() == Qt::NoModifier) {
+
+		// the scene does not know about selected thumbs that have no label
+		if (event->modifiers() == Qt::NoModifier && (!itemClicked || !itemClicked->isSelected()))
+			scene->selectThumbs(false);
+
 		QGraphicsView::mousePressEvent(event);
+	}
 }
 
 void DkThumbsView::mouseMoveEvent(QMouseEvent *event) {
@@ -1633,7 +1781,7 @@ void DkThumbsView::mouseMoveEvent(QMouseEvent *event) {
 				mimeData->setUrls(urls);
 
 				// create thumb image
-				QVector<DkThumbLabel*> tl = scene->getSelectedThumbs();
+				QVector<QSharedPointer<DkImageContainerT> > tl = scene->getSelectedThumbs();
 				QVector<QImage> imgs;
 
 				for (int idx = 0; idx < tl.size() && idx < 3; idx++) {
@@ -1669,6 +1817,12 @@ void DkThumbsView::mouseReleaseEvent(QMouseEvent *event) {
 	}
 	else if (itemClicked != 0) {
 		lastShiftIdx = scene->findThumb(itemClicked);
+
+		// a plain click selects just this thumb (even if others are not in view)
+		if (event->modifiers() == Qt::NoModifier && QPointF(event->pos()-mousePos).manhattanLength() < QApplication::startDragDistance()) {
+			scene->selectThumbs(false);
+			scene->selectThumbs(true, lastShiftIdx, lastShiftIdx);
+		}
 		qDebug() << "starting shift: " << lastShiftIdx;
 	}
 	else
@@ -1802,39 +1956,6 @@ void DkThumbsView::dropEvent(QDropEvent *event) {
 	qDebug() << "drop event...";
 }
 
-void DkThumbsView::fetchThumbs() {
-
-	int maxThreads = DkSettingsManager::param().resources().maxThumbsLoading*2;
-
-	// don't do anything if it is loading anyway
-	if (DkSettingsManager::param().resources().numThumbsLoading/* > maxThreads*/) {
-		return;
-	}
-
-	QList<QGraphicsItem*> items = scene->items(mapToScene(viewport()->rect()).boundingRect(), Qt::IntersectsItemShape);
-
-	for (int idx = 0; idx < items.size(); idx++) {
-
-		if (!maxThreads)
-			break;
-
-		DkThumbLabel* th = dynamic_cast<DkThumbLabel*>(items.at(idx));
-
-		if (!th) {
-			qDebug() << "not a thumb label...";
-			continue;
-		}
-
-		if (th->pixmap().isNull()) {
-			th->update();
-			maxThreads--;
-		}
-		//else if (!thumbLabels.at(idx)->pixmap().isNull())
-		//	firstReached = true;
-	}
-
-}
-
 // DkThumbScrollWidget --------------------------------------------------------------------
 DkThumbScrollWidget::DkThumbScrollWidget(QWidget* parent /* = 0 */, Qt::WindowFlags flags /* = 0 */) : DkWidget(parent, flags) {
 
@@ -2020,6 +2141,8 @@ void DkThumbScrollWidget::resizeEvent(QResizeEvent *event) {
 
 	if (event->oldSize().width() != event->size().width() && isVisible())
 		mThumbsScene->updateLayout();
+	else if (isVisible())
+		mThumbsScene->updateVisibleThumbs();
 
 	DkWidget::resizeEvent(event);
 
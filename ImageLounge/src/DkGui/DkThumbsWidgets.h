@@ -36,6 +36,7 @@
 #include <QPen>
 #include <QGraphicsScene>
 #include <QGraphicsView>
+#include <QMap>
 #pragma warning(pop)		// no warnings from includes - end
 
 #include "DkBaseWidgets.h"
@@ -191,6 +192,8 @@ public:
 
 	void setThumb(QSharedPointer<DkThumbNailT> thumb);
 	QSharedPointer<DkThumbNailT> getThumb() {return mThumb;};
+	void setIndex(int idx);
+	int index() const;
 	QRectF boundingRect() const;
 	QPainterPath shape() const;
 	void updateSize();
@@ -203,8 +206,10 @@ public slots:
 signals:
 	void loadFileSignal(const QString& filePath) const;
 	void showFileSignal(const QString& filePath = QString()) const;
+	void selectedSignal(int idx, bool selected) const;
 
 protected:
+	QVariant itemChange(GraphicsItemChange change, const QVariant& value) override;
 	void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event);
 	void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget * widget = 0);
 	void hoverEnterEvent(QGraphicsSceneHoverEvent *event);
@@ -214,13 +219,13 @@ protected:
 	QGraphicsPixmapItem mIcon;
 	QGraphicsTextItem mText;
 	bool mThumbInitialized = false;
-	bool mFetchingThumb = false;
 	QPen mNoImagePen;
 	QBrush mNoImageBrush;
 	QPen mSelectPen;
 	QBrush mSelectBrush;
 	bool mIsHovered = false;
 	QPointF mLastMove;
+	int mIdx = -1;		// index in the thumb scene (-1 if the label is recycled)
 };
 
 class DllCoreExport DkThumbScene : public QGraphicsScene {
@@ -231,7 +236,7 @@ public:
 
 	void updateLayout();
 	QStringList getSelectedFiles() const;
-	QVector<DkThumbLabel*> getSelectedThumbs() const;
+	QVector<QSharedPointer<DkImageContainerT> > getSelectedThumbs() const;
 	void setImageLoader(QSharedPointer<DkImageLoader> loader);
 	void copyImages(const QMimeData* mimeData) const;
 	int findThumb(DkThumbLabel* thumb) const;
@@ -254,21 +259,37 @@ public slots:
 	void copySelected() const;
 	void pasteImages() const;
 	void renameSelected() const;
+	void updateVisibleThumbs();
 
 signals:
 	void loadFileSignal(const QString& filePath) const;
 	void statusInfoSignal(const QString& msg, int pos = 0) const;
 	void thumbLoadedSignal() const;
 
+protected slots:
+	void thumbSelected(int idx, bool selected);
+
 protected:
 	void connectLoader(QSharedPointer<DkImageLoader> loader, bool connectSignals = true);
+	QRectF thumbRect(int idx) const;
+	void scheduleThumbs(const QRectF& vr);
+	DkThumbLabel* bindLabel(int idx);
+	void releaseLabel(DkThumbLabel* label);
+	bool isSelectable(int idx) const;
 	
 	int mXOffset = 0;
 	int mNumRows = 0;
 	int mNumCols = 0;
 	bool mFirstLayout = true;
 
-	QVector<DkThumbLabel* > mThumbLabels;
+	// just labels within (or close to) the viewport exist
+	QMap<int, DkThumbLabel*> mThumbLabels;
+	QVector<DkThumbLabel*> mLabelPool;		// recycled labels
+	QVector<bool> mSelected;
+
+	DkThumbScheduler* mScheduler = 0;
+	qreal mLastViewTop = 0;
+	int mScrollDir = 0;
 	QSharedPointer<DkImageLoader> mLoader;
 	QVector<QSharedPointer<DkImageContainerT> > mThumbs;
 };
@@ -282,9 +303,6 @@ public:
 signals:
 	void updateDirSignal(const QString& dir) const;
 
-public slots:
-	void fetchThumbs();
-
 protected:
 	void wheelEvent(QWheelEvent *event);
 	void dragEnterEvent(QDragEnterEvent *event);
@@ -41,10 +41,12 @@
 #include "DkStatusBar.h"
 #include "DkUtils.h"
 #include "DkBasicLoader.h"
+#include "DkThreadPools.h"
+#include "DkTiledImage.h"
+#include "DkMovie.h"
 
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QClipboard>
-#include <QMovie>
 #include <QMimeData>
 #include <QAction>
 #include <QApplication>
@@ -224,7 +226,34 @@ void DkViewPort::updateImage(QSharedPointer<DkImageContainerT> image, bool loade
 		return;
 
 	if (mLoader->hasImage()) {
-		setImage(mLoader->getImage());
+
+		QSharedPointer<DkImageContainerT> imgC = mLoader->getCurrentImage();
+
+		// the full resolution of the image shown arrived - keep the view
+		bool keepView = !mDownscaledFile.isEmpty() && mDownscaledFile == imgC->filePath() && !imgC->isDownscaled();
+		QTransform worldMatrix = mWorldMatrix;
+
+		setImage(imgC->displayImage());
+
+		if (keepView) {
+			mWorldMatrix = worldMatrix;
+			mAnimationTimer->stop();
+			mAnimationValue = 0.0f;
+			controlImagePosition();
+			update();
+			emit zoomSignal((float)(mWorldMatrix.m11()*mImgMatrix.m11()*100));
+		}
+
+		mDownscaledFile = imgC->isDownscaled() ? imgC->filePath() : QString();
+
+		// run the action that waited for all pixels (see runWithFullImage)
+		if (mFullImageAction && mFullImageFile != imgC->filePath())
+			mFullImageAction = std::function<void()>();
+		else if (mFullImageAction && !imgC->isDownscaled()) {
+			std::function<void()> fn = mFullImageAction;
+			mFullImageAction = std::function<void()>();
+			fn();
+		}
 	}
 }
 
@@ -252,7 +281,7 @@ void DkViewPort::loadImage(QSharedPointer<DkImageContainerT> img) {
 
 		if (img->hasImage()) {
 			mLoader->setCurrentImage(img);
-			setImage(img->image());
+			setImage(img->displayImage());
 		}
 		mLoader->load(img);
 	}
@@ -321,8 +350,11 @@ void DkViewPort::setImage(QImage newImg) {
 		mAnimationValue = 0.0f;
 
 	// set/clear crop rect
-	if (mLoader->getCurrentImage())
+	if (mLoader->getCurrentImage()) {
 		mCropRect = mLoader->getCurrentImage()->cropRect();
+		QPolygonF poly = displayToImage().inverted().map(mCropRect.getPoly());
+		mCropRect.setPoly(poly);
+	}
 	else
 		mCropRect = DkRotatingRect();
 
@@ -390,6 +422,10 @@ void DkViewPort::zoom(float factor, QPointF center) {
 	if (mWorldMatrix.m11()*factor < mMinZoom && factor < 1)
 		return;
 
+	// we need all pixels if we zoom past 'fit to screen'
+	if (factor > 1 && mWorldMatrix.m11()*factor > 1)
+		loadFullImage();
+
 	// reset view & block if we pass the 'image fit to screen' on zoom out
 	if (mWorldMatrix.m11() > 1 && mWorldMatrix.m11()*factor < 1) {
 
@@ -505,6 +541,111 @@ void DkViewPort::fullView() {
 	if (this->visibleRegion().isEmpty()) qDebug() << "empty region...";
 }
 
+/**
+ * Decodes the current image in full resolution
+ * if it was decoded for display.
+ **/ 
+void DkViewPort::loadFullImage() {
+
+	QSharedPointer<DkImageContainerT> imgC = imageContainer();
+
+	if (!imgC || !imgC->isDownscaled())
+		return;
+
+	// images that do not fit into memory are decoded tile by tile (visible region only)
+	QSize size = imgC->imageSize();
+
+	if (DkTilePyramid::needsTiles(size) && !isRotated(imgC) && DkFileTileSource::supports(imgC->filePath())) {
+
+		if (!mImgStorage.tiles())
+			mImgStorage.setTileSource(QSharedPointer<DkTileSource>(new DkFileTileSource(imgC->filePath(), size)));
+		return;
+	}
+
+	imgC->loadFullImageThreaded();
+}
+
+/**
+ * Calls fn once all pixels of the current image are decoded.
+ * If the image was decoded for display, the full resolution is
+ * loaded in the background and fn is called when it arrives.
+ * Hence, the GUI thread is never blocked by a full decode.
+ * fn is dropped if the full resolution cannot be loaded.
+ * @param fn the action that needs all pixels (e.g. saving)
+ **/ 
+void DkViewPort::runWithFullImage(const std::function<void()>& fn) {
+
+	QSharedPointer<DkImageContainerT> imgC = imageContainer();
+
+	if (!imgC || !imgC->isDownscaled() || (mMovie && mMovie->isValid())) {
+		fn();
+		return;
+	}
+
+	connect(imgC.data(), SIGNAL(fullImageLoadedSignal(bool)), this, SLOT(fullImageLoaded(bool)), Qt::UniqueConnection);
+
+	if (!imgC->loadFullImageThreaded()) {
+		mController->setInfo(tr("Please wait until the image is loaded."));
+		return;
+	}
+
+	mFullImageAction = fn;
+	mFullImageFile = imgC->filePath();
+	mController->setInfo(tr("Loading all pixels..."));
+}
+
+/**
+ * Drops the action of runWithFullImage if all pixels could not be loaded
+ * (the container tells the user). Otherwise, updateImage calls the action.
+ * @param loaded false if the full resolution could not be decoded
+ **/ 
+void DkViewPort::fullImageLoaded(bool loaded) {
+
+	DkImageContainerT* imgC = qobject_cast<DkImageContainerT*>(QObject::sender());
+
+	if (loaded || !imgC || imgC->filePath() != mFullImageFile)
+		return;
+
+	mFullImageAction = std::function<void()>();
+}
+
+/**
+ * Maps pixels of the image shown to the full resolution image.
+ * This is not the identity if the image was decoded for display.
+ * @return QTransform the scaling from display to image pixels
+ **/ 
+QTransform DkViewPort::displayToImage() const {
+
+	QSharedPointer<DkImageContainerT> imgC = imageContainer();
+	QSize displaySize = getImageSize();
+
+	if (!imgC || !imgC->isDownscaled() || displaySize.isEmpty())
+		return QTransform();
+
+	QSize size = imgC->imageSize();
+
+	return QTransform::fromScale((double)size.width()/displaySize.width(), (double)size.height()/displaySize.height());
+}
+
+/**
+ * Returns true if the image is rotated after decoding (EXIF orientation).
+ * @param imgC the image container
+ * @return bool true if the decoded pixels are rotated
+ **/ 
+bool DkViewPort::isRotated(QSharedPointer<DkImageContainerT> imgC) const {
+
+	if (DkSettingsManager::param().metaData().ignoreExifOrientation)
+		return false;
+
+	try {
+		int orientation = imgC->getMetaData()->getOrientationDegree();
+		return orientation != -1 && orientation != 0;
+	}
+	catch (...) {}
+
+	return false;
+}
+
 void DkViewPort::showZoom() {
 
 	QString zoomStr;
@@ -691,14 +832,14 @@ void DkViewPort::saveFileAs(bool silent) {
 
 	if (mLoader) {
 		mController->closePlugin(false);
-		mLoader->saveUserFileAs(getImage(), silent);
+		runWithFullImage([this, silent]() { mLoader->saveUserFileAs(getImage(), silent); });
 	}
 }
 
 void DkViewPort::saveFileWeb() {
 	if (mLoader) {
 		mController->closePlugin(false);
-		mLoader->saveFileWeb(getImage());
+		runWithFullImage([this]() { mLoader->saveFileWeb(getImage()); });
 	}
 }
 
@@ -733,6 +874,14 @@ void DkViewPort::applyManipulator() {
 		return;
 	}
 
+	runWithFullImage([this, mpl]() { applyManipulatorIntern(mpl); });
+}
+
+void DkViewPort::applyManipulatorIntern(QSharedPointer<DkBaseManipulator> mpl) {
+
+	QSharedPointer<DkBaseManipulatorExt> mplExt = qSharedPointerDynamicCast<DkBaseManipulatorExt>(mpl);
+	DkActionManager& am = DkActionManager::instance();
+
 	// show the dock (in case it's not shown yet)
 	if (mplExt) {
 		am.action(DkActionManager::menu_edit_image)->setChecked(true);
@@ -754,10 +903,9 @@ void DkViewPort::applyManipulator() {
 		img = getImage();
 
 	mManipulatorWatcher.setFuture(
-		QtConcurrent::run(
-			mpl.data(), 
-			&nmc::DkBaseManipulator::apply,
-			img));
+		DkThreadPools::instance().run(
+			DkThreadPools::lane_current_decode,
+			[mpl, img]() { return mpl->apply(img); }));
 
 	mActiveManipulator = mpl;
 
@@ -920,7 +1068,15 @@ void DkViewPort::loadMovie() {
 	if (mMovie)
 		mMovie->stop();
 
-	mMovie = QSharedPointer<QMovie>(new QMovie(mLoader->filePath()));
+	QSharedPointer<DkMovie> movie(new DkMovie(mLoader->filePath()));
+
+	// still images (e.g. most webps) are not played
+	if (movie->frameCount() == 1) {
+		mMovie.clear();
+		return;
+	}
+
+	mMovie = movie;
 	connect(mMovie.data(), SIGNAL(frameChanged(int)), this, SLOT(update()));
 	mMovie->start();
 
@@ -960,17 +1116,7 @@ void DkViewPort::previousMovieFrame() {
 	if (!mMovie)
 		return;
 
-	
-	int fn = mMovie->currentFrameNumber()-1;
-	if (fn == -1)
-		fn = mMovie->frameCount()-1;
-	//qDebug() << "retrieving frame: " << fn;
-	
-	while(mMovie->currentFrameNumber() != fn)
-		mMovie->jumpToNextFrame();
-
-	//// the subsequent thing is not working if the movie is paused
-	//bool success = movie->jumpToFrame(movie->currentFrameNumber()-1);
+	mMovie->jumpToPreviousFrame();
 	update();
 }
 
@@ -980,7 +1126,7 @@ void DkViewPort::stopMovie() {
 		return;		
 	
 	mMovie->stop();
-	mMovie = QSharedPointer<QMovie>();
+	mMovie = QSharedPointer<DkMovie>();
 }
 
 void DkViewPort::drawPolygon(QPainter & painter, const QPolygon & polygon) {
@@ -1002,6 +1148,9 @@ void DkViewPort::resizeEvent(QResizeEvent *event) {
 
 	mViewportRect = QRect(0, 0, width(), height());
 
+	if (mLoader)
+		mLoader->setDisplaySize(size()*devicePixelRatio());
+
 	// >DIR: diem - bug if zoom factor is large and window becomes small
 	updateImageMatrix();
 	centerImage();
@@ -1261,8 +1410,31 @@ void DkViewPort::setFullScreen(bool fullScreen) {
 	toggleLena(fullScreen);
 }
 
+/**
+ * Maps a window position to the full resolution image.
+ * @param windowPos the position in window coordinates
+ * @return QPoint the image coordinates or (-1,-1) if windowPos is not on the image
+ **/ 
 QPoint DkViewPort::mapToImage(const QPoint& windowPos) const {
 
+	QPoint xy = mapToDisplayImage(windowPos);
+
+	if (xy.x() == -1 || xy.y() == -1)
+		return xy;
+
+	QPointF imgPos = displayToImage().map(QPointF(xy));
+
+	return QPoint(qFloor(imgPos.x()), qFloor(imgPos.y()));
+}
+
+/**
+ * Maps a window position to the image shown.
+ * This differs from mapToImage if the image was decoded for display.
+ * @param windowPos the position in window coordinates
+ * @return QPoint the pixel coordinates or (-1,-1) if windowPos is not on the image
+ **/ 
+QPoint DkViewPort::mapToDisplayImage(const QPoint& windowPos) const {
+
 	QPointF imgPos = mWorldMatrix.inverted().map(QPointF(windowPos));
 	imgPos = mImgMatrix.inverted().map(imgPos);
 
@@ -1279,12 +1451,14 @@ void DkViewPort::getPixelInfo(const QPoint& pos) {
 	if (mImgStorage.getImage().isNull())
 		return;
 
-	QPoint xy = mapToImage(pos);
+	QPoint dxy = mapToDisplayImage(pos);
 
-	if (xy.x() == -1 || xy.y() == -1)
+	if (dxy.x() == -1 || dxy.y() == -1)
 		return;
 
-	QColor col = mImgStorage.getImage().pixel(xy);
+	// report full resolution coordinates - the color is read from the pixels shown
+	QPoint xy = mapToImage(pos);
+	QColor col = mImgStorage.getImage().pixel(dxy);
 	
 	QString msg = "<font color=#555555>x: " + QString::number(xy.x()) + " y: " + QString::number(xy.y()) + "</font>"
 		" | r: " + QString::number(col.red()) + " g: " + QString::number(col.green()) + " b: " + QString::number(col.blue());
@@ -1367,13 +1541,16 @@ void DkViewPort::copyImageBuffer() {
 	if (getImage().isNull())
 		return;
 
-	QMimeData* mimeData = new QMimeData;
+	runWithFullImage([this]() {
 
-	if (!getImage().isNull())
-		mimeData->setImageData(getImage());
+		QMimeData* mimeData = new QMimeData;
 
-	QClipboard* clipboard = QApplication::clipboard();
-	clipboard->setMimeData(mimeData);
+		if (!getImage().isNull())
+			mimeData->setImageData(getImage());
+
+		QClipboard* clipboard = QApplication::clipboard();
+		clipboard->setMimeData(mimeData);
+	});
 }
 
 void DkViewPort::animateFade() {
@@ -1414,7 +1591,7 @@ void DkViewPort::rotateCW() {
 
 
 	if (mLoader != 0)
-		mLoader->rotateImage(90);
+		runWithFullImage([this]() { mLoader->rotateImage(90); });
 
 }
 
@@ -1424,7 +1601,7 @@ void DkViewPort::rotateCCW() {
 		return;
 
 	if (mLoader != 0)
-		mLoader->rotateImage(-90);
+		runWithFullImage([this]() { mLoader->rotateImage(-90); });
 
 }
 
@@ -1434,7 +1611,7 @@ void DkViewPort::rotate180() {
 		return;
 
 	if (mLoader != 0)
-		mLoader->rotateImage(180);
+		runWithFullImage([this]() { mLoader->rotateImage(180); });
 
 }
 
@@ -1562,7 +1739,7 @@ bool DkViewPort::unloadImage(bool fileChange) {
 
 	if (mMovie && success) {
 		mMovie->stop();
-		mMovie = QSharedPointer<QMovie>();
+		mMovie = QSharedPointer<DkMovie>();
 	}
 
 	if (mSvg && success)
@@ -1643,7 +1820,11 @@ void DkViewPort::loadFileFast(int skipIdx) {
 		int sIdx = skipIdx;
 		QSharedPointer<DkImageContainerT> lastImg;
 
-		for (int idx = 0; idx < mLoader->getImages().size(); idx++) {
+		// the folder is listed - the loader navigates once it knows the neighbors
+		if (mLoader->isScanning())
+			mLoader->changeFile(skipIdx);
+
+		for (int idx = 0; !mLoader->isScanning() && idx < mLoader->getImages().size(); idx++) {
 
 			QSharedPointer<DkImageContainerT> imgC = mLoader->getSkippedImage(sIdx);
 
@@ -1778,8 +1959,10 @@ void DkViewPort::setImageLoader(QSharedPointer<DkImageLoader> newLoader) {
 	mLoader = newLoader;
 	connectLoader(newLoader);
 
-	if (mLoader)
+	if (mLoader) {
+		mLoader->setDisplaySize(size()*devicePixelRatio());
 		mLoader->activate();
+	}
 }
 
 void DkViewPort::connectLoader(QSharedPointer<DkImageLoader> loader, bool connectSignals) {
@@ -1843,8 +2026,20 @@ void DkViewPort::cropImage(const DkRotatingRect& rect, const QColor& bgCol, bool
 		return;
 	}
 	
-	imgC->cropImage(rect, bgCol, cropToMetaData);
-	setEditedImage(imgC);
+	// the crop rect is defined on the pixels shown
+	DkRotatingRect r = rect;
+	QPolygonF poly = displayToImage().map(rect.getPoly());
+	r.setPoly(poly);
+
+	auto crop = [this, imgC, r, bgCol, cropToMetaData]() {
+		imgC->cropImage(r, bgCol, cropToMetaData);
+		setEditedImage(imgC);
+	};
+
+	if (cropToMetaData)
+		crop();
+	else
+		runWithFullImage(crop);
 }
 
 // DkViewPortFrameless --------------------------------------------------------------------
@@ -1994,7 +2189,7 @@ void DkViewPortFrameless::draw(QPainter & painter, double) {
 			painter.drawRect(mImgViewRect);
 		}
 
-		painter.drawImage(mImgViewRect, imgQt, QRect(QPoint(), imgQt.size()));
+		drawImage(painter, imgQt);
 	}
 
 }
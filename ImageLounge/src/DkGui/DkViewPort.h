@@ -34,6 +34,7 @@
 
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QTimer>	// needed to construct mTimers
+#include <functional>
 #pragma warning(pop)		// no warnings from includes - end
 
 #ifndef DllCoreExport
@@ -107,6 +108,8 @@ public:
 	
 	QString getCurrentPixelHexValue();
 	QPoint mapToImage(const QPoint& windowPos) const;
+	QPoint mapToDisplayImage(const QPoint& windowPos) const;
+	void runWithFullImage(const std::function<void()>& fn);
 	
 	void connectLoader(QSharedPointer<DkImageLoader> loader, bool connectSignals = true);
 
@@ -181,6 +184,7 @@ public slots:
 	void manipulatorApplied();
 
 	virtual void updateImage(QSharedPointer<DkImageContainerT> image, bool loaded = true);
+	void fullImageLoaded(bool loaded);
 	virtual void loadImage(const QImage& newImg);
 	virtual void loadImage(QSharedPointer<DkImageContainerT> img);
 	virtual void setEditedImage(const QImage& newImg, const QString& editName);
@@ -214,6 +218,9 @@ protected:
 	bool mGestureStarted = false;
 
 	QRectF mOldImgRect;
+	QString mDownscaledFile;	// the file that is shown downscaled (see DkImageContainer::setDisplaySize)
+	QString mFullImageFile;
+	std::function<void()> mFullImageAction;	// waits for all pixels of mFullImageFile (see runWithFullImage)
 
 	QTimer* mRepeatZoomTimer;// = new QTimer(this);
 	
@@ -252,6 +259,10 @@ protected:
 	virtual void drawBackground(QPainter & painter);
 	virtual void updateImageMatrix();
 	void showZoom();
+	void loadFullImage();
+	QTransform displayToImage() const;
+	void applyManipulatorIntern(QSharedPointer<DkBaseManipulator> mpl);
+	bool isRotated(QSharedPointer<DkImageContainerT> imgC) const;
 	void toggleLena(bool fullscreen);
 	void getPixelInfo(const QPoint& pos);
 
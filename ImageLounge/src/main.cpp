@@ -62,6 +62,8 @@
 #include "DkPong.h"
 #include "DkUtils.h"
 #include "DkProcess.h"
+#include "DkThumbs.h"
+#include "DkBenchmark.h"
 #include "DkPluginManager.h"
 
 #include "DkDependencyResolver.h"
@@ -143,6 +145,25 @@ int main(int argc, char *argv[]) {
 		QObject::tr("log-path.txt"));
 	parser.addOption(batchLogOpt);
 
+	QCommandLineOption thumbsOpt(QStringList() << "thumbs",
+		QObject::tr("Computes the thumbnails of all images in <directory> and its sub folders."),
+		QObject::tr("directory"));
+	parser.addOption(thumbsOpt);
+
+	QCommandLineOption thumbsExifOpt(QStringList() << "thumbs-exif",
+		QObject::tr("Saves the thumbnails of --thumbs to the images' Exif data rather than to the thumbnail cache."));
+	parser.addOption(thumbsExifOpt);
+
+	QCommandLineOption benchmarkOpt(QStringList() << "benchmark",
+		QObject::tr("Runs the <suite> benchmark (%1) and writes the results to the log.").arg(nmc::DkBenchmark::suites().join(", ")),
+		QObject::tr("suite"));
+	parser.addOption(benchmarkOpt);
+
+	QCommandLineOption benchmarkDirOpt(QStringList() << "benchmark-dir",
+		QObject::tr("Sample images of --benchmark are read from <directory>."),
+		QObject::tr("directory"));
+	parser.addOption(benchmarkDirOpt);
+
 	QCommandLineOption importSettingsOpt(QStringList() << "import-settings",
 		QObject::tr("Imports the settings from <settings-path.nfo> and saves them."),
 		QObject::tr("settings-path.nfo"));
@@ -166,6 +187,18 @@ int main(int argc, char *argv[]) {
 		return 0;
 	}
 
+	// compute thumbnails
+	if (!parser.value(thumbsOpt).isEmpty()) {
+		nmc::DkThumbsGenerator::computeThumbs(parser.value(thumbsOpt), parser.isSet(thumbsExifOpt));
+		return 0;
+	}
+
+	// run benchmarks
+	if (!parser.value(benchmarkOpt).isEmpty()) {
+		bool ok = nmc::DkBenchmark::run(parser.value(benchmarkOpt), parser.value(benchmarkDirOpt));
+		return ok ? 0 : 1;
+	}
+
 	// apply default settings
 	if (!parser.value(importSettingsOpt).isEmpty()) {
 		QString settingsPath = parser.value(importSettingsOpt);